@@ -2,9 +2,24 @@
 
 namespace Config
 {
+	const unsigned asyncSysMemBlts = 0;
+	// 0 keeps the OS CPU affinity. The default pins the process to CPU 0 for old games that break on
+	// multiple cores. That also leaves the blit worker pool and the DDBLT_ASYNC queue without threads,
+	// so banded and asynchronous blits only take effect when this is changed.
+	const unsigned cpuAffinityMask = 1;
 	const unsigned delayedFlipModeTimeout = 200;
+	const unsigned dynamicBufferSegments = 4;
 	const unsigned evictionTimeout = 200;
+	const unsigned maxAsyncBltQueueSize = 16;
+	const unsigned maxBltBatchSize = 0;
+	const unsigned maxBltWorkerThreads = 3;
 	const unsigned maxPaletteUpdatesPerMs = 5;
 	const unsigned maxUserModeDisplayDrivers = 3;
+	// Batches that can be reordered are built in system memory rather than directly in the mapped
+	// dynamic vertex buffer, which costs an extra copy of their vertices.
+	const unsigned maxVertexCacheOptimizedIndices = 0;
+	const unsigned minParallelBltBandHeight = 32;
+	const unsigned minParallelBltSize = 1024 * 1024;
+	const unsigned minStreamingBltSize = 4 * 1024 * 1024;
 	const unsigned threadSwitchCycleTime = 3 * 1000 * 1000;
 }
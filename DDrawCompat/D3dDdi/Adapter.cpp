@@ -1,12 +1,26 @@
 #include "D3dDdi/Adapter.h"
 #include "D3dDdi/AdapterFuncs.h"
 
+namespace
+{
+	// Layout of D3DCAPS9 from d3d9caps.h, which conflicts with d3dtypes.h
+	struct D3dCaps9
+	{
+		DWORD unused1[45];
+		DWORD MaxPrimitiveCount;
+		DWORD MaxVertexIndex;
+		DWORD unused2[29];
+	};
+}
+
 namespace D3dDdi
 {
 	Adapter::Adapter(HANDLE adapter, HMODULE module)
 		: m_adapter(adapter)
 		, m_module(module)
 		, m_d3dExtendedCaps{}
+		, m_maxPrimitiveCount(D3DMAXNUMPRIMITIVES)
+		, m_maxVertexIndex(D3DMAXNUMVERTICES)
 	{
 		if (m_adapter)
 		{
@@ -15,6 +29,17 @@ namespace D3dDdi
 			getCaps.pData = &m_d3dExtendedCaps;
 			getCaps.DataSize = sizeof(m_d3dExtendedCaps);
 			D3dDdi::AdapterFuncs::s_origVtablePtr->pfnGetCaps(adapter, &getCaps);
+
+			D3dCaps9 d3dCaps9 = {};
+			getCaps.Type = D3DDDICAPS_GETD3D9CAPS;
+			getCaps.pData = &d3dCaps9;
+			getCaps.DataSize = sizeof(d3dCaps9);
+			if (SUCCEEDED(D3dDdi::AdapterFuncs::s_origVtablePtr->pfnGetCaps(adapter, &getCaps)) &&
+				0 != d3dCaps9.MaxPrimitiveCount && 0 != d3dCaps9.MaxVertexIndex)
+			{
+				m_maxPrimitiveCount = d3dCaps9.MaxPrimitiveCount;
+				m_maxVertexIndex = d3dCaps9.MaxVertexIndex;
+			}
 		}
 	}
 
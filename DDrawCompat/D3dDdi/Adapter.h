@@ -16,6 +16,8 @@ namespace D3dDdi
 		operator HANDLE() const { return m_adapter; }
 
 		const D3DNTHAL_D3DEXTENDEDCAPS& getD3dExtendedCaps() const { return m_d3dExtendedCaps; }
+		UINT getMaxPrimitiveCount() const { return m_maxPrimitiveCount; }
+		UINT getMaxVertexIndex() const { return m_maxVertexIndex; }
 		HMODULE getModule() const { return m_module; }
 
 		static void add(HANDLE adapter, HMODULE module);
@@ -26,6 +28,8 @@ namespace D3dDdi
 		HANDLE m_adapter;
 		HMODULE m_module;
 		D3DNTHAL_D3DEXTENDEDCAPS m_d3dExtendedCaps;
+		UINT m_maxPrimitiveCount;
+		UINT m_maxVertexIndex;
 
 		static std::map<HANDLE, Adapter> s_adapters;
 	};
@@ -0,0 +1,315 @@
+#include <algorithm>
+
+#include <Common/Log.h>
+#include <Config/Config.h>
+#include <D3dDdi/BltBatch.h>
+#include <D3dDdi/Device.h>
+#include <D3dDdi/Resource.h>
+
+namespace
+{
+	// D3DDECLTYPE, D3DDECLMETHOD and D3DDECLUSAGE values from d3d9types.h, which conflicts with d3dtypes.h
+	const BYTE DECLTYPE_FLOAT2 = 1;
+	const BYTE DECLTYPE_FLOAT4 = 3;
+	const BYTE DECLMETHOD_DEFAULT = 0;
+	const BYTE DECLUSAGE_TEXCOORD = 5;
+	const BYTE DECLUSAGE_POSITIONT = 9;
+
+	// The states overridden by BltBatch::draw, which must be tracked to be restored afterwards
+	bool areOverriddenStatesKnown(const D3dDdi::DeviceState& state, bool isColorKeyed)
+	{
+		const D3DDDIRENDERSTATETYPE renderStates[] = {
+			D3DDDIRS_ZENABLE, D3DDDIRS_FILLMODE, D3DDDIRS_CULLMODE, D3DDDIRS_ALPHABLENDENABLE, D3DDDIRS_FOGENABLE,
+			D3DDDIRS_STENCILENABLE, D3DDDIRS_CLIPPING, D3DDDIRS_SCISSORTESTENABLE, D3DDDIRS_COLORWRITEENABLE,
+			D3DDDIRS_SRGBWRITEENABLE, D3DDDIRS_COLORKEYENABLE, D3DDDIRS_ALPHATESTENABLE,
+			D3DDDIRS_ALPHAFUNC, D3DDDIRS_ALPHAREF };
+		const D3DDDITEXTURESTAGESTATETYPE textureStageStates[] = {
+			D3DDDITSS_COLOROP, D3DDDITSS_COLORARG1, D3DDDITSS_ALPHAOP, D3DDDITSS_ALPHAARG1, D3DDDITSS_TEXCOORDINDEX,
+			D3DDDITSS_TEXTURETRANSFORMFLAGS, D3DDDITSS_ADDRESSU, D3DDDITSS_ADDRESSV, D3DDDITSS_MAGFILTER,
+			D3DDDITSS_MINFILTER, D3DDDITSS_DISABLETEXTURECOLORKEY, D3DDDITSS_TEXTURECOLORKEYVAL };
+		// The last states of each list are only overridden for colour keyed blits
+		const UINT colorKeyOnlyCount = 2;
+
+		const UINT renderStateCount =
+			sizeof(renderStates) / sizeof(renderStates[0]) - (isColorKeyed ? 0 : colorKeyOnlyCount);
+		for (UINT i = 0; i < renderStateCount; ++i)
+		{
+			if (!state.isRenderStateKnown(renderStates[i]))
+			{
+				return false;
+			}
+		}
+
+		const UINT textureStageStateCount =
+			sizeof(textureStageStates) / sizeof(textureStageStates[0]) - (isColorKeyed ? 0 : colorKeyOnlyCount);
+		for (UINT i = 0; i < textureStageStateCount; ++i)
+		{
+			if (!state.isTextureStageStateKnown(0, textureStageStates[i]))
+			{
+				return false;
+			}
+		}
+
+		return state.isTextureStageStateKnown(1, D3DDDITSS_COLOROP) &&
+			state.isTextureStageStateKnown(1, D3DDDITSS_ALPHAOP);
+	}
+
+	void setRenderState(D3dDdi::DeviceState& state, D3DDDIRENDERSTATETYPE renderState, UINT value)
+	{
+		D3DDDIARG_RENDERSTATE data = {};
+		data.State = renderState;
+		data.Value = value;
+		state.setTempRenderState(data);
+	}
+
+	void setTextureStageState(D3dDdi::DeviceState& state, UINT stage, D3DDDITEXTURESTAGESTATETYPE textureStageState,
+		UINT value)
+	{
+		D3DDDIARG_TEXTURESTAGESTATE data = {};
+		data.Stage = stage;
+		data.State = textureStageState;
+		data.Value = value;
+		state.setTempTextureStageState(data);
+	}
+}
+
+namespace D3dDdi
+{
+	BltBatch::BltBatch(Device& device)
+		: m_device(device)
+		, m_vertexShaderDecl(nullptr)
+		, m_dstWidth(0)
+		, m_dstHeight(0)
+		, m_srcWidth(0)
+		, m_srcHeight(0)
+	{
+	}
+
+	BltBatch::~BltBatch()
+	{
+		if (m_vertexShaderDecl)
+		{
+			m_device.getOrigVtable().pfnDeleteVertexShaderDecl(m_device, m_vertexShaderDecl);
+		}
+	}
+
+	bool BltBatch::add(const D3DDDIARG_BLT& data, const Resource& dstResource, const Resource& srcResource)
+	{
+		if (!isBatchable(data, dstResource, srcResource))
+		{
+			flush();
+			return false;
+		}
+
+		if (!isAppendable(data) ||
+			m_blts.size() >= Config::maxBltBatchSize ||
+			m_blts.size() >= D3DMAXNUMVERTICES / 4)
+		{
+			flush();
+			const auto& dstSurface = dstResource.getFixedDesc().pSurfList[data.DstSubResourceIndex];
+			const auto& srcSurface = srcResource.getFixedDesc().pSurfList[data.SrcSubResourceIndex];
+			m_dstWidth = dstSurface.Width;
+			m_dstHeight = dstSurface.Height;
+			m_srcWidth = static_cast<float>(srcSurface.Width);
+			m_srcHeight = static_cast<float>(srcSurface.Height);
+		}
+
+		m_blts.push_back(data);
+		return true;
+	}
+
+	void BltBatch::appendQuad(const D3DDDIARG_BLT& data)
+	{
+		const float left = data.DstRect.left - 0.5f;
+		const float top = data.DstRect.top - 0.5f;
+		const float right = data.DstRect.right - 0.5f;
+		const float bottom = data.DstRect.bottom - 0.5f;
+
+		float tuLeft = data.SrcRect.left / m_srcWidth;
+		float tvTop = data.SrcRect.top / m_srcHeight;
+		float tuRight = data.SrcRect.right / m_srcWidth;
+		float tvBottom = data.SrcRect.bottom / m_srcHeight;
+		if (data.Flags.MirrorLeftRight)
+		{
+			std::swap(tuLeft, tuRight);
+		}
+		if (data.Flags.MirrorUpDown)
+		{
+			std::swap(tvTop, tvBottom);
+		}
+
+		const UINT16 baseIndex = static_cast<UINT16>(m_vertices.size());
+		m_vertices.push_back({ left, top, 0.0f, 1.0f, tuLeft, tvTop });
+		m_vertices.push_back({ right, top, 0.0f, 1.0f, tuRight, tvTop });
+		m_vertices.push_back({ left, bottom, 0.0f, 1.0f, tuLeft, tvBottom });
+		m_vertices.push_back({ right, bottom, 0.0f, 1.0f, tuRight, tvBottom });
+
+		const UINT16 quadIndices[] = { 0, 1, 2, 2, 1, 3 };
+		for (UINT16 index : quadIndices)
+		{
+			m_indices.push_back(baseIndex + index);
+		}
+	}
+
+	HRESULT BltBatch::draw()
+	{
+		if (!m_vertexShaderDecl)
+		{
+			const D3DDDIVERTEXELEMENT vertexElements[] = {
+				{ 0, 0, DECLTYPE_FLOAT4, DECLMETHOD_DEFAULT, DECLUSAGE_POSITIONT, 0 },
+				{ 0, 16, DECLTYPE_FLOAT2, DECLMETHOD_DEFAULT, DECLUSAGE_TEXCOORD, 0 }
+			};
+
+			D3DDDIARG_CREATEVERTEXSHADERDECL data = {};
+			data.NumVertexElements = sizeof(vertexElements) / sizeof(vertexElements[0]);
+			HRESULT result = m_device.getOrigVtable().pfnCreateVertexShaderDecl(m_device, &data, vertexElements);
+			if (FAILED(result))
+			{
+				return result;
+			}
+			m_vertexShaderDecl = data.ShaderHandle;
+		}
+
+		m_vertices.clear();
+		m_indices.clear();
+		for (const auto& blt : m_blts)
+		{
+			appendQuad(blt);
+		}
+
+		const auto& blt = m_blts.front();
+		HRESULT result = m_device.setTempRenderTarget(blt.hDstResource, blt.DstSubResourceIndex);
+		if (FAILED(result))
+		{
+			return result;
+		}
+
+		auto& state = m_device.getState();
+		D3DDDIARG_VIEWPORTINFO viewport = {};
+		viewport.Width = m_dstWidth;
+		viewport.Height = m_dstHeight;
+		state.setTempViewport(viewport);
+		state.setTempDepthStencil(nullptr);
+		state.setTempVertexShaderDecl(m_vertexShaderDecl);
+		state.setTempVertexShaderFunc(nullptr);
+		state.setTempPixelShader(nullptr);
+		state.setTempTexture(0, blt.hSrcResource);
+
+		setRenderState(state, D3DDDIRS_ZENABLE, D3DZB_FALSE);
+		setRenderState(state, D3DDDIRS_FILLMODE, D3DFILL_SOLID);
+		setRenderState(state, D3DDDIRS_CULLMODE, D3DCULL_NONE);
+		setRenderState(state, D3DDDIRS_ALPHABLENDENABLE, FALSE);
+		setRenderState(state, D3DDDIRS_FOGENABLE, FALSE);
+		setRenderState(state, D3DDDIRS_STENCILENABLE, FALSE);
+		setRenderState(state, D3DDDIRS_CLIPPING, FALSE);
+		setRenderState(state, D3DDDIRS_SCISSORTESTENABLE, FALSE);
+		setRenderState(state, D3DDDIRS_COLORWRITEENABLE, 0xF);
+		setRenderState(state, D3DDDIRS_SRGBWRITEENABLE, FALSE);
+
+		// Colour keyed texels get zero alpha, which the alpha test then discards
+		setRenderState(state, D3DDDIRS_COLORKEYENABLE, blt.Flags.SrcColorKey);
+		setRenderState(state, D3DDDIRS_ALPHATESTENABLE, blt.Flags.SrcColorKey);
+		if (blt.Flags.SrcColorKey)
+		{
+			setRenderState(state, D3DDDIRS_ALPHAFUNC, D3DCMP_GREATER);
+			setRenderState(state, D3DDDIRS_ALPHAREF, 0);
+			setTextureStageState(state, 0, D3DDDITSS_DISABLETEXTURECOLORKEY, FALSE);
+			setTextureStageState(state, 0, D3DDDITSS_TEXTURECOLORKEYVAL, blt.ColorKey);
+		}
+
+		setTextureStageState(state, 0, D3DDDITSS_COLOROP, D3DTOP_SELECTARG1);
+		setTextureStageState(state, 0, D3DDDITSS_COLORARG1, D3DTA_TEXTURE);
+		setTextureStageState(state, 0, D3DDDITSS_ALPHAOP, D3DTOP_SELECTARG1);
+		setTextureStageState(state, 0, D3DDDITSS_ALPHAARG1, D3DTA_TEXTURE);
+		setTextureStageState(state, 0, D3DDDITSS_TEXCOORDINDEX, 0);
+		setTextureStageState(state, 0, D3DDDITSS_TEXTURETRANSFORMFLAGS, D3DTTFF_DISABLE);
+		setTextureStageState(state, 0, D3DDDITSS_ADDRESSU, D3DTADDRESS_CLAMP);
+		setTextureStageState(state, 0, D3DDDITSS_ADDRESSV, D3DTADDRESS_CLAMP);
+		setTextureStageState(state, 0, D3DDDITSS_MAGFILTER, blt.Flags.Linear ? D3DTFG_LINEAR : D3DTFG_POINT);
+		setTextureStageState(state, 0, D3DDDITSS_MINFILTER, blt.Flags.Linear ? D3DTFN_LINEAR : D3DTFN_POINT);
+		setTextureStageState(state, 1, D3DDDITSS_COLOROP, D3DTOP_DISABLE);
+		setTextureStageState(state, 1, D3DDDITSS_ALPHAOP, D3DTOP_DISABLE);
+
+		result = m_device.getDrawPrimitive().drawIndexedUm(D3DPT_TRIANGLELIST, static_cast<UINT>(m_blts.size() * 2),
+			m_vertices.data(), sizeof(Vertex), m_indices.data());
+
+		state.restoreTempState();
+		m_device.restoreRenderTarget();
+		return result;
+	}
+
+	HRESULT BltBatch::flush()
+	{
+		if (m_blts.empty())
+		{
+			return S_OK;
+		}
+
+		LOG_DEBUG << "Flushing " << m_blts.size() << " batched blits";
+		HRESULT result = draw();
+		if (FAILED(result))
+		{
+			LOG_ONCE("WARN: Drawing batched blits failed: " << Compat::hex(result));
+			result = replay();
+		}
+
+		m_blts.clear();
+		return result;
+	}
+
+	bool BltBatch::isAppendable(const D3DDDIARG_BLT& data) const
+	{
+		if (m_blts.empty())
+		{
+			return false;
+		}
+
+		const auto& blt = m_blts.front();
+		return data.hDstResource == blt.hDstResource &&
+			data.DstSubResourceIndex == blt.DstSubResourceIndex &&
+			data.hSrcResource == blt.hSrcResource &&
+			data.SrcSubResourceIndex == blt.SrcSubResourceIndex &&
+			data.Flags.Value == blt.Flags.Value &&
+			(!data.Flags.SrcColorKey || data.ColorKey == blt.ColorKey);
+	}
+
+	bool BltBatch::isBatchable(const D3DDDIARG_BLT& data, const Resource& dstResource, const Resource& srcResource) const
+	{
+		// Without an app render target there is nothing valid to rebind after drawing the batch
+		if (0 == Config::maxBltBatchSize || !m_device.getRenderTarget())
+		{
+			return false;
+		}
+
+		D3DDDI_BLTFLAGS unsupportedFlags = data.Flags;
+		unsupportedFlags.Point = 0;
+		unsupportedFlags.Linear = 0;
+		unsupportedFlags.SrcColorKey = 0;
+		unsupportedFlags.MirrorLeftRight = 0;
+		unsupportedFlags.MirrorUpDown = 0;
+
+		const auto& dstDesc = dstResource.getFixedDesc();
+		const auto& srcDesc = srcResource.getFixedDesc();
+		return 0 == unsupportedFlags.Value &&
+			areOverriddenStatesKnown(m_device.getState(), data.Flags.SrcColorKey) &&
+			data.hDstResource != data.hSrcResource &&
+			dstDesc.Flags.RenderTarget && !dstDesc.Flags.Primary &&
+			srcDesc.Flags.Texture && !srcDesc.Flags.CubeMap &&
+			0 == data.SrcSubResourceIndex &&
+			(!data.Flags.SrcColorKey || 0 == srcResource.getFormatInfo().alphaBitCount);
+	}
+
+	HRESULT BltBatch::replay()
+	{
+		HRESULT result = S_OK;
+		for (const auto& blt : m_blts)
+		{
+			HRESULT bltResult = m_device.getOrigVtable().pfnBlt(m_device, &blt);
+			if (FAILED(bltResult))
+			{
+				result = bltResult;
+			}
+		}
+		return result;
+	}
+}
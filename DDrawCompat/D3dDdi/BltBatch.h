@@ -0,0 +1,52 @@
+#pragma once
+
+#include <vector>
+
+#include <d3d.h>
+#include <d3dumddi.h>
+
+namespace D3dDdi
+{
+	class Device;
+	class Resource;
+
+	class BltBatch
+	{
+	public:
+		BltBatch(Device& device);
+		~BltBatch();
+
+		BltBatch(const BltBatch&) = delete;
+		BltBatch& operator=(const BltBatch&) = delete;
+
+		bool add(const D3DDDIARG_BLT& data, const Resource& dstResource, const Resource& srcResource);
+		HRESULT flush();
+		bool isAppendable(const D3DDDIARG_BLT& data) const;
+
+	private:
+		struct Vertex
+		{
+			float x;
+			float y;
+			float z;
+			float rhw;
+			float tu;
+			float tv;
+		};
+
+		void appendQuad(const D3DDDIARG_BLT& data);
+		HRESULT draw();
+		bool isBatchable(const D3DDDIARG_BLT& data, const Resource& dstResource, const Resource& srcResource) const;
+		HRESULT replay();
+
+		Device& m_device;
+		HANDLE m_vertexShaderDecl;
+		std::vector<D3DDDIARG_BLT> m_blts;
+		std::vector<Vertex> m_vertices;
+		std::vector<UINT16> m_indices;
+		UINT m_dstWidth;
+		UINT m_dstHeight;
+		float m_srcWidth;
+		float m_srcHeight;
+	};
+}
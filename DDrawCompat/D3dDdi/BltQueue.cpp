@@ -0,0 +1,97 @@
+#include <deque>
+
+#include <Common/ScopedCriticalSection.h>
+#include <Config/Config.h>
+#include <D3dDdi/BltQueue.h>
+#include <Win32/Thread.h>
+
+namespace
+{
+	Compat::CriticalSection g_queueCs;
+	CONDITION_VARIABLE g_queueChanged = CONDITION_VARIABLE_INIT;
+	std::deque<std::function<void()>> g_queue;
+	UINT64 g_queuedFence = 0;
+	UINT64 g_completedFence = 0;
+	bool g_isWorkerThreadInitialized = false;
+	bool g_isWorkerThreadRunning = false;
+
+	DWORD WINAPI workerThreadProc(LPVOID /*lpParameter*/)
+	{
+		Compat::ScopedCriticalSection lock(g_queueCs);
+		while (true)
+		{
+			while (g_queue.empty())
+			{
+				SleepConditionVariableCS(&g_queueChanged, &g_queueCs, INFINITE);
+			}
+
+			auto blt = std::move(g_queue.front());
+			g_queue.pop_front();
+
+			LeaveCriticalSection(&g_queueCs);
+			blt();
+			EnterCriticalSection(&g_queueCs);
+
+			++g_completedFence;
+			WakeAllConditionVariable(&g_queueChanged);
+		}
+	}
+
+	void initWorkerThread()
+	{
+		g_isWorkerThreadInitialized = true;
+		if (Win32::Thread::getAvailableProcessorCount() < 2)
+		{
+			// Without a second CPU the worker only adds thread switches to every blt
+			return;
+		}
+
+		HANDLE thread = CreateThread(nullptr, 0, &workerThreadProc, nullptr, 0, nullptr);
+		if (thread)
+		{
+			CloseHandle(thread);
+			g_isWorkerThreadRunning = true;
+		}
+	}
+}
+
+namespace D3dDdi
+{
+	namespace BltQueue
+	{
+		UINT64 enqueue(std::function<void()> blt)
+		{
+			{
+				Compat::ScopedCriticalSection lock(g_queueCs);
+				if (!g_isWorkerThreadInitialized)
+				{
+					initWorkerThread();
+				}
+
+				if (g_isWorkerThreadRunning)
+				{
+					while (g_queuedFence - g_completedFence >= Config::maxAsyncBltQueueSize)
+					{
+						SleepConditionVariableCS(&g_queueChanged, &g_queueCs, INFINITE);
+					}
+
+					g_queue.push_back(std::move(blt));
+					WakeAllConditionVariable(&g_queueChanged);
+					return ++g_queuedFence;
+				}
+			}
+
+			blt();
+			return 0;
+		}
+
+		void wait(UINT64 fence)
+		{
+			Compat::ScopedCriticalSection lock(g_queueCs);
+			while (g_completedFence < fence)
+			{
+				SleepConditionVariableCS(&g_queueChanged, &g_queueCs, INFINITE);
+			}
+		}
+	}
+}
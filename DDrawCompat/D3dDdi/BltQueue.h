@@ -0,0 +1,14 @@
+#pragma once
+
+#include <functional>
+
+#include <Windows.h>
+
+namespace D3dDdi
+{
+	namespace BltQueue
+	{
+		UINT64 enqueue(std::function<void()> blt);
+		void wait(UINT64 fence);
+	}
+}
@@ -13,6 +13,7 @@ namespace
 	HANDLE g_gdiResourceHandle = nullptr;
 	D3dDdi::Resource* g_gdiResource = nullptr;
 	bool g_isReadOnlyGdiLockEnabled = false;
+	thread_local HANDLE g_asyncBltResource = nullptr;
 }
 
 namespace D3dDdi
@@ -22,16 +23,23 @@ namespace D3dDdi
 		, m_adapter(Adapter::get(adapter))
 		, m_device(device)
 		, m_renderTarget(nullptr)
+		, m_renderTargetHandle(nullptr)
 		, m_renderTargetSubResourceIndex(0)
+		, m_isTempRenderTarget(false)
 		, m_sharedPrimary(nullptr)
 		, m_drawPrimitive(*this)
 		, m_state(*this)
+		, m_bltBatch(*this)
 	{
 	}
 
 	HRESULT Device::blt(const D3DDDIARG_BLT* data)
 	{
-		flushPrimitives();
+		m_drawPrimitive.flushPrimitives();
+		if (!m_bltBatch.isAppendable(*data))
+		{
+			m_bltBatch.flush();
+		}
 		auto it = m_resources.find(data->hDstResource);
 		if (it != m_resources.end())
 		{
@@ -108,6 +116,12 @@ namespace D3dDdi
 			g_gdiResource->unlock(unlock);
 		}
 
+		auto it = m_resources.find(resource);
+		if (it != m_resources.end())
+		{
+			it->second.waitForAsyncBlts();
+		}
+
 		if (resource == m_sharedPrimary)
 		{
 			D3DKMTReleaseProcessVidPnSourceOwners(GetCurrentProcess());
@@ -121,6 +135,11 @@ namespace D3dDdi
 			{
 				m_sharedPrimary = nullptr;
 			}
+			if (resource == m_renderTargetHandle)
+			{
+				m_renderTarget = nullptr;
+				m_renderTargetHandle = nullptr;
+			}
 			if (resource == g_gdiResourceHandle)
 			{
 				g_gdiResourceHandle = nullptr;
@@ -135,12 +154,14 @@ namespace D3dDdi
 	HRESULT Device::drawIndexedPrimitive2(const D3DDDIARG_DRAWINDEXEDPRIMITIVE2* data,
 		UINT /*indicesSize*/, const void* indexBuffer, const UINT* flagBuffer)
 	{
+		m_bltBatch.flush();
 		prepareForRendering();
 		return m_drawPrimitive.drawIndexed(*data, static_cast<const UINT16*>(indexBuffer), flagBuffer);
 	}
 
 	HRESULT Device::drawPrimitive(const D3DDDIARG_DRAWPRIMITIVE* data, const UINT* flagBuffer)
 	{
+		m_bltBatch.flush();
 		prepareForRendering();
 		return m_drawPrimitive.draw(*data, flagBuffer);
 	}
@@ -210,6 +231,7 @@ namespace D3dDdi
 		if (SUCCEEDED(result) && 0 == data->RenderTargetIndex)
 		{
 			m_renderTarget = getResource(data->hRenderTarget);
+			m_renderTargetHandle = data->hRenderTarget;
 			m_renderTargetSubResourceIndex = data->SubResourceIndex;
 		}
 		return result;
@@ -236,6 +258,12 @@ namespace D3dDdi
 		return m_origVtable.pfnUnlock(m_device, data);
 	}
 
+	void Device::flushPrimitives()
+	{
+		m_bltBatch.flush();
+		m_drawPrimitive.flushPrimitives();
+	}
+
 	Resource* Device::getGdiResource()
 	{
 		return g_gdiResource;
@@ -258,6 +286,44 @@ namespace D3dDdi
 		}
 	}
 
+	void Device::restoreRenderTarget()
+	{
+		if (!m_isTempRenderTarget)
+		{
+			return;
+		}
+
+		m_isTempRenderTarget = false;
+		D3DDDIARG_SETRENDERTARGET data = {};
+		data.hRenderTarget = m_renderTargetHandle;
+		data.SubResourceIndex = m_renderTargetSubResourceIndex;
+		m_origVtable.pfnSetRenderTarget(m_device, &data);
+	}
+
+	HRESULT Device::setTempRenderTarget(HANDLE resource, UINT subResourceIndex)
+	{
+		if (resource == m_renderTargetHandle && subResourceIndex == m_renderTargetSubResourceIndex)
+		{
+			return S_OK;
+		}
+
+		if (!m_renderTargetHandle)
+		{
+			// There would be no app render target to switch back to afterwards
+			return E_FAIL;
+		}
+
+		D3DDDIARG_SETRENDERTARGET data = {};
+		data.hRenderTarget = resource;
+		data.SubResourceIndex = subResourceIndex;
+		HRESULT result = m_origVtable.pfnSetRenderTarget(m_device, &data);
+		if (SUCCEEDED(result))
+		{
+			m_isTempRenderTarget = true;
+		}
+		return result;
+	}
+
 	void Device::add(HANDLE adapter, HANDLE device)
 	{
 		s_devices.try_emplace(device, adapter, device);
@@ -276,7 +342,15 @@ namespace D3dDdi
 
 	void Device::remove(HANDLE device)
 	{
-		s_devices.erase(device);
+		auto it = s_devices.find(device);
+		if (it != s_devices.end())
+		{
+			for (auto& resource : it->second.m_resources)
+			{
+				resource.second.waitForAsyncBlts();
+			}
+			s_devices.erase(it);
+		}
 	}
 
 	Resource* Device::getResource(HANDLE resource)
@@ -298,6 +372,16 @@ namespace D3dDdi
 		return nullptr;
 	}
 
+	bool Device::isAsyncBltEnabled(HANDLE resource)
+	{
+		return resource && resource == g_asyncBltResource;
+	}
+
+	void Device::setAsyncBltResource(HANDLE resource)
+	{
+		g_asyncBltResource = resource;
+	}
+
 	void Device::setGdiResourceHandle(HANDLE resource)
 	{
 		ScopedCriticalSection lock;
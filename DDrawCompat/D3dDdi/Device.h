@@ -7,6 +7,7 @@
 #include <d3dnthal.h>
 #include <d3dumddi.h>
 
+#include <D3dDdi/BltBatch.h>
 #include <D3dDdi/DeviceState.h>
 #include <D3dDdi/DrawPrimitive.h>
 
@@ -48,21 +49,29 @@ namespace D3dDdi
 		HRESULT unlock(const D3DDDIARG_UNLOCK* data);
 
 		Adapter& getAdapter() const { return m_adapter; }
+		BltBatch& getBltBatch() { return m_bltBatch; }
+		DrawPrimitive& getDrawPrimitive() { return m_drawPrimitive; }
 		const D3DDDI_DEVICEFUNCS& getOrigVtable() const { return m_origVtable; }
+		Resource* getRenderTarget() const { return m_renderTarget; }
+		UINT getRenderTargetSubResourceIndex() const { return m_renderTargetSubResourceIndex; }
 		Resource* getResource(HANDLE resource);
 		DeviceState& getState() { return m_state; }
 
-		void flushPrimitives() { m_drawPrimitive.flushPrimitives(); }
+		void flushPrimitives();
 		void prepareForRendering(HANDLE resource, UINT subResourceIndex, bool isReadOnly);
 		void prepareForRendering();
+		void restoreRenderTarget();
+		HRESULT setTempRenderTarget(HANDLE resource, UINT subResourceIndex);
 
 		static void add(HANDLE adapter, HANDLE device);
 		static Device& get(HANDLE device);
 		static void remove(HANDLE device);
 
 		static void enableFlush(bool enable) { s_isFlushEnabled = enable; }
+		static bool isAsyncBltEnabled(HANDLE resource);
 		static Resource* findResource(HANDLE resource);
 		static Resource* getGdiResource();
+		static void setAsyncBltResource(HANDLE resource);
 		static void setGdiResourceHandle(HANDLE resource);
 		static void setReadOnlyGdiLock(bool enable);
 
@@ -75,10 +84,13 @@ namespace D3dDdi
 		HANDLE m_device;
 		std::unordered_map<HANDLE, Resource> m_resources;
 		Resource* m_renderTarget;
+		HANDLE m_renderTargetHandle;
 		UINT m_renderTargetSubResourceIndex;
+		bool m_isTempRenderTarget;
 		HANDLE m_sharedPrimary;
 		DrawPrimitive m_drawPrimitive;
 		DeviceState m_state;
+		BltBatch m_bltBatch;
 
 		static std::map<HANDLE, Device> s_devices;
 		static bool s_isFlushEnabled;
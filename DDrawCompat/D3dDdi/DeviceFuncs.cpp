@@ -61,9 +61,11 @@ namespace D3dDdi
 		vtable.pfnSetStreamSourceUm = &DEVICE_FUNC(setStreamSourceUm);
 		vtable.pfnUnlock = &DEVICE_FUNC(unlock);
 
+		// DeviceState tracks these for temporary state overrides and flushes batched primitives on every change
 		SET_DEVICE_STATE_FUNC(pfnDeletePixelShader);
 		SET_DEVICE_STATE_FUNC(pfnDeleteVertexShaderDecl);
 		SET_DEVICE_STATE_FUNC(pfnDeleteVertexShaderFunc);
+		SET_DEVICE_STATE_FUNC(pfnSetDepthStencil);
 		SET_DEVICE_STATE_FUNC(pfnSetPixelShader);
 		SET_DEVICE_STATE_FUNC(pfnSetPixelShaderConst);
 		SET_DEVICE_STATE_FUNC(pfnSetPixelShaderConstB);
@@ -76,6 +78,7 @@ namespace D3dDdi
 		SET_DEVICE_STATE_FUNC(pfnSetVertexShaderConstI);
 		SET_DEVICE_STATE_FUNC(pfnSetVertexShaderDecl);
 		SET_DEVICE_STATE_FUNC(pfnSetVertexShaderFunc);
+		SET_DEVICE_STATE_FUNC(pfnSetViewport);
 		SET_DEVICE_STATE_FUNC(pfnSetZRange);
 		SET_DEVICE_STATE_FUNC(pfnUpdateWInfo);
 
@@ -86,10 +89,8 @@ namespace D3dDdi
 		FLUSH_PRIMITIVES(pfnDiscard);
 		FLUSH_PRIMITIVES(pfnGenerateMipSubLevels);
 		FLUSH_PRIMITIVES(pfnSetClipPlane);
-		FLUSH_PRIMITIVES(pfnSetDepthStencil);
 		FLUSH_PRIMITIVES(pfnSetPalette);
 		FLUSH_PRIMITIVES(pfnSetScissorRect);
-		FLUSH_PRIMITIVES(pfnSetViewport);
 		FLUSH_PRIMITIVES(pfnStateSet);
 		FLUSH_PRIMITIVES(pfnTexBlt);
 		FLUSH_PRIMITIVES(pfnTexBlt1);
@@ -1,8 +1,21 @@
 #include <D3dDdi/Device.h>
 #include <D3dDdi/DeviceState.h>
+#include <D3dDdi/Resource.h>
 
 namespace
 {
+	const UINT UNKNOWN_STATE = 0xBAADBAAD;
+
+	bool operator==(const D3DDDIARG_SETDEPTHSTENCIL& lhs, const D3DDDIARG_SETDEPTHSTENCIL& rhs)
+	{
+		return lhs.hZBuffer == rhs.hZBuffer;
+	}
+
+	bool operator==(const D3DDDIARG_VIEWPORTINFO& lhs, const D3DDDIARG_VIEWPORTINFO& rhs)
+	{
+		return lhs.X == rhs.X && lhs.Y == rhs.Y && lhs.Width == rhs.Width && lhs.Height == rhs.Height;
+	}
+
 	bool operator==(const D3DDDIARG_ZRANGE& lhs, const D3DDDIARG_ZRANGE& rhs)
 	{
 		return lhs.MinZ == rhs.MinZ && lhs.MaxZ == rhs.MaxZ;
@@ -18,17 +31,24 @@ namespace D3dDdi
 {
 	DeviceState::DeviceState(Device& device)
 		: m_device(device)
+		, m_depthStencil{}
 		, m_pixelShader(nullptr)
 		, m_textures{}
 		, m_vertexShaderDecl(nullptr)
 		, m_vertexShaderFunc(nullptr)
+		, m_viewport{}
 		, m_wInfo{ NAN, NAN }
 		, m_zRange{ NAN, NAN }
+		, m_isTempDepthStencil(false)
+		, m_isTempPixelShader(false)
+		, m_isTempVertexShaderDecl(false)
+		, m_isTempVertexShaderFunc(false)
+		, m_isTempViewport(false)
 	{
-		m_renderState.fill(0xBAADBAAD);
+		m_renderState.fill(UNKNOWN_STATE);
 		for (UINT i = 0; i < m_textureStageState.size(); ++i)
 		{
-			m_textureStageState[i].fill(0xBAADBAAD);
+			m_textureStageState[i].fill(UNKNOWN_STATE);
 		}
 	}
 
@@ -47,6 +67,11 @@ namespace D3dDdi
 		return deleteShader(shader, m_vertexShaderFunc, m_device.getOrigVtable().pfnDeleteVertexShaderFunc);
 	}
 
+	HRESULT DeviceState::pfnSetDepthStencil(const D3DDDIARG_SETDEPTHSTENCIL* data)
+	{
+		return setState(data, m_depthStencil, m_device.getOrigVtable().pfnSetDepthStencil);
+	}
+
 	HRESULT DeviceState::pfnSetPixelShader(HANDLE shader)
 	{
 		return setShader(shader, m_pixelShader, m_device.getOrigVtable().pfnSetPixelShader);
@@ -124,6 +149,11 @@ namespace D3dDdi
 		return setShader(shader, m_vertexShaderFunc, m_device.getOrigVtable().pfnSetVertexShaderFunc);
 	}
 
+	HRESULT DeviceState::pfnSetViewport(const D3DDDIARG_VIEWPORTINFO* data)
+	{
+		return setState(data, m_viewport, m_device.getOrigVtable().pfnSetViewport);
+	}
+
 	HRESULT DeviceState::pfnSetZRange(const D3DDDIARG_ZRANGE* data)
 	{
 		return setState(data, m_zRange, m_device.getOrigVtable().pfnSetZRange);
@@ -139,6 +169,177 @@ namespace D3dDdi
 		return setState(&wInfo, m_wInfo, m_device.getOrigVtable().pfnUpdateWInfo);
 	}
 
+	UINT DeviceState::getRenderState(D3DDDIRENDERSTATETYPE state) const
+	{
+		return isRenderStateKnown(state) ? m_renderState[state] : UNKNOWN_STATE;
+	}
+
+	bool DeviceState::isRenderStateKnown(D3DDDIRENDERSTATETYPE state) const
+	{
+		return state < static_cast<INT>(m_renderState.size()) && UNKNOWN_STATE != m_renderState[state];
+	}
+
+	bool DeviceState::isTextureStageStateKnown(UINT stage, D3DDDITEXTURESTAGESTATETYPE state) const
+	{
+		return stage < m_textureStageState.size() && state < static_cast<INT>(m_textureStageState[stage].size()) &&
+			UNKNOWN_STATE != m_textureStageState[stage][state];
+	}
+
+	void DeviceState::restoreTempState()
+	{
+		auto& vtable = m_device.getOrigVtable();
+
+		if (m_isTempDepthStencil)
+		{
+			vtable.pfnSetDepthStencil(m_device, &m_depthStencil);
+			m_isTempDepthStencil = false;
+		}
+
+		if (m_isTempPixelShader)
+		{
+			vtable.pfnSetPixelShader(m_device, m_pixelShader);
+			m_isTempPixelShader = false;
+		}
+
+		// Only tracked states can be restored, BltBatch doesn't override unknown ones
+		for (auto state : m_tempRenderStates)
+		{
+			if (isRenderStateKnown(state))
+			{
+				D3DDDIARG_RENDERSTATE data = {};
+				data.State = state;
+				data.Value = m_renderState[state];
+				vtable.pfnSetRenderState(m_device, &data);
+			}
+		}
+		m_tempRenderStates.clear();
+
+		for (auto stage : m_tempTextures)
+		{
+			vtable.pfnSetTexture(m_device, stage, m_textures[stage]);
+		}
+		m_tempTextures.clear();
+
+		for (const auto& stageState : m_tempTextureStageStates)
+		{
+			if (isTextureStageStateKnown(stageState.first, stageState.second))
+			{
+				D3DDDIARG_TEXTURESTAGESTATE data = {};
+				data.Stage = stageState.first;
+				data.State = stageState.second;
+				data.Value = m_textureStageState[stageState.first][stageState.second];
+				vtable.pfnSetTextureStageState(m_device, &data);
+			}
+		}
+		m_tempTextureStageStates.clear();
+
+		if (m_isTempVertexShaderDecl)
+		{
+			vtable.pfnSetVertexShaderDecl(m_device, m_vertexShaderDecl);
+			m_isTempVertexShaderDecl = false;
+		}
+
+		if (m_isTempVertexShaderFunc)
+		{
+			vtable.pfnSetVertexShaderFunc(m_device, m_vertexShaderFunc);
+			m_isTempVertexShaderFunc = false;
+		}
+
+		if (m_isTempViewport)
+		{
+			if (0 != m_viewport.Width)
+			{
+				vtable.pfnSetViewport(m_device, &m_viewport);
+			}
+			else if (m_device.getRenderTarget())
+			{
+				// The app never set a viewport, so restore the runtime default covering the whole render target
+				const auto& surface = m_device.getRenderTarget()->getFixedDesc().pSurfList[
+					m_device.getRenderTargetSubResourceIndex()];
+				D3DDDIARG_VIEWPORTINFO viewport = {};
+				viewport.Width = surface.Width;
+				viewport.Height = surface.Height;
+				vtable.pfnSetViewport(m_device, &viewport);
+			}
+			m_isTempViewport = false;
+		}
+	}
+
+	void DeviceState::setTempDepthStencil(HANDLE depthStencil)
+	{
+		if (depthStencil != m_depthStencil.hZBuffer)
+		{
+			D3DDDIARG_SETDEPTHSTENCIL data = {};
+			data.hZBuffer = depthStencil;
+			m_device.getOrigVtable().pfnSetDepthStencil(m_device, &data);
+			m_isTempDepthStencil = true;
+		}
+	}
+
+	void DeviceState::setTempPixelShader(HANDLE shader)
+	{
+		if (shader != m_pixelShader)
+		{
+			m_device.getOrigVtable().pfnSetPixelShader(m_device, shader);
+			m_isTempPixelShader = true;
+		}
+	}
+
+	void DeviceState::setTempRenderState(const D3DDDIARG_RENDERSTATE& data)
+	{
+		if (!isRenderStateKnown(data.State) || data.Value != m_renderState[data.State])
+		{
+			m_device.getOrigVtable().pfnSetRenderState(m_device, &data);
+			m_tempRenderStates.push_back(data.State);
+		}
+	}
+
+	void DeviceState::setTempTexture(UINT stage, HANDLE texture)
+	{
+		if (stage < m_textures.size() && texture != m_textures[stage])
+		{
+			m_device.getOrigVtable().pfnSetTexture(m_device, stage, texture);
+			m_tempTextures.push_back(stage);
+		}
+	}
+
+	void DeviceState::setTempTextureStageState(const D3DDDIARG_TEXTURESTAGESTATE& data)
+	{
+		if (!isTextureStageStateKnown(data.Stage, data.State) ||
+			data.Value != m_textureStageState[data.Stage][data.State])
+		{
+			m_device.getOrigVtable().pfnSetTextureStageState(m_device, &data);
+			m_tempTextureStageStates.push_back({ data.Stage, data.State });
+		}
+	}
+
+	void DeviceState::setTempVertexShaderDecl(HANDLE shader)
+	{
+		if (shader != m_vertexShaderDecl)
+		{
+			m_device.getOrigVtable().pfnSetVertexShaderDecl(m_device, shader);
+			m_isTempVertexShaderDecl = true;
+		}
+	}
+
+	void DeviceState::setTempVertexShaderFunc(HANDLE shader)
+	{
+		if (shader != m_vertexShaderFunc)
+		{
+			m_device.getOrigVtable().pfnSetVertexShaderFunc(m_device, shader);
+			m_isTempVertexShaderFunc = true;
+		}
+	}
+
+	void DeviceState::setTempViewport(const D3DDDIARG_VIEWPORTINFO& data)
+	{
+		if (!(data == m_viewport))
+		{
+			m_device.getOrigVtable().pfnSetViewport(m_device, &data);
+			m_isTempViewport = true;
+		}
+	}
+
 	HRESULT DeviceState::deleteShader(HANDLE shader, HANDLE& currentShader,
 		HRESULT(APIENTRY* origDeleteShaderFunc)(HANDLE, HANDLE))
 	{
@@ -15,6 +15,7 @@ namespace D3dDdi
 		HRESULT pfnDeletePixelShader(HANDLE shader);
 		HRESULT pfnDeleteVertexShaderDecl(HANDLE shader);
 		HRESULT pfnDeleteVertexShaderFunc(HANDLE shader);
+		HRESULT pfnSetDepthStencil(const D3DDDIARG_SETDEPTHSTENCIL* data);
 		HRESULT pfnSetPixelShader(HANDLE shader);
 		HRESULT pfnSetPixelShaderConst(const D3DDDIARG_SETPIXELSHADERCONST* data, const FLOAT* registers);
 		HRESULT pfnSetPixelShaderConstB(const D3DDDIARG_SETPIXELSHADERCONSTB* data, const BOOL* registers);
@@ -27,9 +28,24 @@ namespace D3dDdi
 		HRESULT pfnSetVertexShaderConstI(const D3DDDIARG_SETVERTEXSHADERCONSTI* data, const INT* registers);
 		HRESULT pfnSetVertexShaderDecl(HANDLE shader);
 		HRESULT pfnSetVertexShaderFunc(HANDLE shader);
+		HRESULT pfnSetViewport(const D3DDDIARG_VIEWPORTINFO* data);
 		HRESULT pfnSetZRange(const D3DDDIARG_ZRANGE* data);
 		HRESULT pfnUpdateWInfo(const D3DDDIARG_WINFO* data);
 
+		UINT getRenderState(D3DDDIRENDERSTATETYPE state) const;
+		bool isRenderStateKnown(D3DDDIRENDERSTATETYPE state) const;
+		bool isTextureStageStateKnown(UINT stage, D3DDDITEXTURESTAGESTATETYPE state) const;
+
+		void setTempDepthStencil(HANDLE depthStencil);
+		void setTempPixelShader(HANDLE shader);
+		void setTempRenderState(const D3DDDIARG_RENDERSTATE& data);
+		void setTempTexture(UINT stage, HANDLE texture);
+		void setTempTextureStageState(const D3DDDIARG_TEXTURESTAGESTATE& data);
+		void setTempVertexShaderDecl(HANDLE shader);
+		void setTempVertexShaderFunc(HANDLE shader);
+		void setTempViewport(const D3DDDIARG_VIEWPORTINFO& data);
+		void restoreTempState();
+
 	private:
 		typedef std::tuple<FLOAT, FLOAT, FLOAT, FLOAT> ShaderConstF;
 		typedef std::tuple<INT, INT, INT, INT> ShaderConstI;
@@ -53,19 +69,30 @@ namespace D3dDdi
 			HRESULT(APIENTRY* origSetState)(HANDLE, const StateData*));
 
 		Device& m_device;
+		D3DDDIARG_SETDEPTHSTENCIL m_depthStencil;
 		HANDLE m_pixelShader;
 		std::vector<ShaderConstF> m_pixelShaderConst;
 		std::vector<BOOL> m_pixelShaderConstB;
 		std::vector<ShaderConstI> m_pixelShaderConstI;
 		std::array<UINT, D3DDDIRS_BLENDOPALPHA + 1> m_renderState;
 		std::array<HANDLE, 8> m_textures;
-		std::array<std::array<UINT, D3DDDITSS_CONSTANT + 1>, 8> m_textureStageState;
+		std::array<std::array<UINT, D3DDDITSS_TEXTURECOLORKEYVAL + 1>, 8> m_textureStageState;
 		std::vector<ShaderConstF> m_vertexShaderConst;
 		std::vector<BOOL> m_vertexShaderConstB;
 		std::vector<ShaderConstI> m_vertexShaderConstI;
 		HANDLE m_vertexShaderDecl;
 		HANDLE m_vertexShaderFunc;
+		D3DDDIARG_VIEWPORTINFO m_viewport;
 		D3DDDIARG_WINFO m_wInfo;
 		D3DDDIARG_ZRANGE m_zRange;
+
+		bool m_isTempDepthStencil;
+		bool m_isTempPixelShader;
+		bool m_isTempVertexShaderDecl;
+		bool m_isTempVertexShaderFunc;
+		bool m_isTempViewport;
+		std::vector<D3DDDIRENDERSTATETYPE> m_tempRenderStates;
+		std::vector<UINT> m_tempTextures;
+		std::vector<std::pair<UINT, D3DDDITEXTURESTAGESTATETYPE>> m_tempTextureStageStates;
 	};
 }
@@ -1,4 +1,6 @@
 #include <Common/Log.h>
+#include <Config/Config.h>
+#include <D3dDdi/Adapter.h>
 #include <D3dDdi/DrawPrimitive.h>
 #include <D3dDdi/Device.h>
 #include <D3dDdi/Resource.h>
@@ -6,6 +8,7 @@
 namespace
 {
 	const UINT INDEX_BUFFER_SIZE = 256 * 1024;
+	const UINT INDEX32_BUFFER_SIZE = 2 * 1024 * 1024;
 	const UINT VERTEX_BUFFER_SIZE = 1024 * 1024;
 
 	UINT getVertexCount(D3DPRIMITIVETYPE primitiveType, UINT primitiveCount)
@@ -27,6 +30,11 @@ namespace
 		return 0;
 	}
 
+	bool is32BitIndexSupported(const D3dDdi::Device& device)
+	{
+		return device.getAdapter().getMaxVertexIndex() > 0xFFFF;
+	}
+
 	void updateMax(UINT& max, UINT value)
 	{
 		if (value > max)
@@ -50,9 +58,14 @@ namespace D3dDdi
 		: m_device(device)
 		, m_origVtable(device.getOrigVtable())
 		, m_vertexBuffer(device, VERTEX_BUFFER_SIZE)
-		, m_indexBuffer(device, m_vertexBuffer ? INDEX_BUFFER_SIZE : 0)
+		, m_indexBuffer(device,
+			m_vertexBuffer ? (is32BitIndexSupported(device) ? INDEX32_BUFFER_SIZE : INDEX_BUFFER_SIZE) : 0,
+			is32BitIndexSupported(device))
 		, m_streamSource{}
 		, m_batched{}
+		, m_maxBatchedIndexCount(D3DMAXNUMVERTICES)
+		, m_indexRemapEpoch(0)
+		, m_vertexCacheStats{}
 	{
 		LOG_ONCE("Dynamic vertex buffers are " << (m_vertexBuffer ? "" : "not ") << "available");
 		LOG_ONCE("Dynamic index buffers are " << (m_indexBuffer ? "" : "not ") << "available");
@@ -61,9 +74,31 @@ namespace D3dDdi
 		{
 			D3DDDIARG_SETINDICES si = {};
 			si.hIndexBuffer = m_indexBuffer;
-			si.Stride = 2;
+			si.Stride = m_indexBuffer.getStride();
 			m_origVtable.pfnSetIndices(m_device, &si);
 		}
+
+		if (4 == m_indexBuffer.getStride())
+		{
+			// Batched vertex count is bounded by the index count
+			const auto& adapter = device.getAdapter();
+			m_maxBatchedIndexCount = static_cast<UINT>(std::min<UINT64>(
+				std::min<UINT64>(adapter.getMaxPrimitiveCount() * 3ull, adapter.getMaxVertexIndex()),
+				(m_indexBuffer ? m_indexBuffer.getSize() : INDEX32_BUFFER_SIZE) / 4));
+		}
+		LOG_ONCE("Batched index lists are " << m_indexBuffer.getStride() * 8 << "-bit, up to " <<
+			m_maxBatchedIndexCount << " indices");
+	}
+
+	DrawPrimitive::~DrawPrimitive()
+	{
+		if (0 != m_vertexCacheStats.triangleCount)
+		{
+			Compat::Log() << "Vertex cache ACMR of optimized batches: " <<
+				static_cast<double>(m_vertexCacheStats.missCountBefore) / m_vertexCacheStats.triangleCount << " -> " <<
+				static_cast<double>(m_vertexCacheStats.missCountAfter) / m_vertexCacheStats.triangleCount <<
+				" over " << m_vertexCacheStats.triangleCount << " triangles";
+		}
 	}
 
 	void DrawPrimitive::addSysMemVertexBuffer(HANDLE resource, BYTE* vertices, UINT fvf)
@@ -87,44 +122,39 @@ namespace D3dDdi
 			INT delta = getBatchedVertexCount() - minIndex;
 			for (UINT i = 0; i < count; ++i)
 			{
-				m_batched.indices.push_back(static_cast<UINT16>(indices[i] + delta));
+				m_batched.indices.push_back(static_cast<UINT>(indices[i] + delta));
 			}
 			appendVertices(baseVertexIndex + minIndex, vertexCount);
 			return;
 		}
 
-		static UINT16 indexMap[D3DMAXNUMVERTICES] = {};
-		static BYTE indexCycles[D3DMAXNUMVERTICES] = {};
-		static BYTE currentCycle = 0;
-		static UINT maxVertexCount = 0;
-
-		++currentCycle;
-		if (0 == currentCycle)
+		// Entries stamped with an older epoch are stale, so the table only needs clearing when the epoch wraps
+		++m_indexRemapEpoch;
+		if (0 == m_indexRemapEpoch)
 		{
-			memset(indexCycles, 0, maxVertexCount);
-			maxVertexCount = vertexCount;
-			++currentCycle;
+			std::fill(m_indexRemap.begin(), m_indexRemap.end(), IndexRemap{});
+			m_indexRemapEpoch = 1;
 		}
-		else
+		if (m_indexRemap.size() < vertexCount)
 		{
-			updateMax(maxVertexCount, vertexCount);
+			m_indexRemap.resize(vertexCount);
 		}
 
-		UINT16 newIndex = static_cast<UINT16>(getBatchedVertexCount());
+		UINT newIndex = getBatchedVertexCount();
 		for (UINT i = 0; i < count; ++i)
 		{
-			const UINT16 zeroBasedIndex = static_cast<UINT16>(indices[i] - minIndex);
-			if (currentCycle != indexCycles[zeroBasedIndex])
+			auto& remap = m_indexRemap[indices[i] - minIndex];
+			if (m_indexRemapEpoch != remap.epoch)
 			{
 				appendVertices(baseVertexIndex + indices[i], 1);
-				indexMap[zeroBasedIndex] = newIndex;
-				indexCycles[zeroBasedIndex] = currentCycle;
+				remap.index = newIndex;
+				remap.epoch = m_indexRemapEpoch;
 				m_batched.indices.push_back(newIndex);
 				++newIndex;
 			}
 			else
 			{
-				m_batched.indices.push_back(indexMap[zeroBasedIndex]);
+				m_batched.indices.push_back(remap.index);
 			}
 		}
 	}
@@ -139,7 +169,7 @@ namespace D3dDdi
 	{
 		for (UINT i = base; i < base + count; ++i)
 		{
-			m_batched.indices.push_back(static_cast<UINT16>(i));
+			m_batched.indices.push_back(i);
 		}
 		updateMin(m_batched.minIndex, base);
 		updateMax(m_batched.maxIndex, base + count - 1);
@@ -151,7 +181,7 @@ namespace D3dDdi
 		rebaseIndices();
 		for (UINT i = 0; i < count; ++i)
 		{
-			m_batched.indices.push_back(static_cast<UINT16>(baseVertexIndex + indices[i]));
+			m_batched.indices.push_back(static_cast<UINT>(baseVertexIndex + indices[i]));
 		}
 		updateMin(m_batched.minIndex, baseVertexIndex + minIndex);
 		updateMax(m_batched.maxIndex, baseVertexIndex + maxIndex);
@@ -200,7 +230,12 @@ namespace D3dDdi
 	bool DrawPrimitive::appendPrimitives(D3DPRIMITIVETYPE primitiveType, INT baseVertexIndex, UINT primitiveCount,
 		const UINT16* indices, UINT minIndex, UINT maxIndex)
 	{
-		if ((m_batched.primitiveCount + primitiveCount) * 3 > D3DMAXNUMVERTICES)
+		if ((m_batched.primitiveCount + primitiveCount) * 3 > m_maxBatchedIndexCount)
+		{
+			return false;
+		}
+
+		if (!hasMappedVertexCapacity(primitiveType, primitiveCount))
 		{
 			return false;
 		}
@@ -301,15 +336,15 @@ namespace D3dDdi
 		{
 			if (m_streamSource.vertices)
 			{
-				m_batched.indices.push_back(static_cast<UINT16>(getBatchedVertexCount()));
+				m_batched.indices.push_back(getBatchedVertexCount());
 			}
 			else if (indices)
 			{
-				m_batched.indices.push_back(static_cast<UINT16>(baseVertexIndex + indices[0]));
+				m_batched.indices.push_back(static_cast<UINT>(baseVertexIndex + indices[0]));
 			}
 			else
 			{
-				m_batched.indices.push_back(static_cast<UINT16>(baseVertexIndex));
+				m_batched.indices.push_back(static_cast<UINT>(baseVertexIndex));
 			}
 		}
 		m_batched.primitiveCount += 3;
@@ -319,13 +354,36 @@ namespace D3dDdi
 
 	void DrawPrimitive::appendVertices(UINT base, UINT count)
 	{
-		auto vertices = m_streamSource.vertices + base * m_streamSource.stride;
-		m_batched.vertices.insert(m_batched.vertices.end(), vertices, vertices + count * m_streamSource.stride);
+		appendBatchedVertices(m_streamSource.vertices + base * m_streamSource.stride, count);
+	}
+
+	void DrawPrimitive::appendBatchedVertices(const BYTE* vertices, UINT count)
+	{
+		if (0 == count)
+		{
+			return;
+		}
+
+		const UINT stride = m_streamSource.stride;
+		const bool isFirstVertex = 0 == getBatchedVertexCount();
+		BYTE* dst = reserveBatchedVertices(count);
+		memcpy(dst, vertices, count * stride);
+		if (isFirstVertex)
+		{
+			m_batched.firstVertexRhw = reinterpret_cast<const D3DTLVERTEX*>(vertices)->rhw;
+			fixFirstVertexRhw(dst, vertices);
+		}
+		if (m_batched.indices.empty())
+		{
+			const BYTE* lastVertex = vertices + (count - 1) * stride;
+			m_batched.lastVertex.assign(lastVertex, lastVertex + stride);
+		}
 	}
 
 	void DrawPrimitive::clearBatchedPrimitives()
 	{
 		m_batched.primitiveCount = 0;
+		m_batched.vertexCount = 0;
 		m_batched.vertices.clear();
 		m_batched.indices.clear();
 	}
@@ -338,7 +396,7 @@ namespace D3dDdi
 		INT startIndexPos = startPrimitive * 3;
 		INT oldIndexPos = startIndexPos + primitiveCount - 1;
 		INT newIndexPos = (totalPrimitiveCount - 1) * 3;
-		const UINT16 startIndex = m_batched.indices[startIndexPos];
+		const UINT startIndex = m_batched.indices[startIndexPos];
 
 		while (newIndexPos > startIndexPos)
 		{
@@ -405,18 +463,18 @@ namespace D3dDdi
 				UINT i = baseVertexIndex;
 				for (; i < baseVertexIndex + m_batched.primitiveCount - 1; i += 2)
 				{
-					m_batched.indices.push_back(static_cast<UINT16>(i));
-					m_batched.indices.push_back(static_cast<UINT16>(i + 1));
-					m_batched.indices.push_back(static_cast<UINT16>(i + 2));
-					m_batched.indices.push_back(static_cast<UINT16>(i + 1));
-					m_batched.indices.push_back(static_cast<UINT16>(i + 3));
-					m_batched.indices.push_back(static_cast<UINT16>(i + 2));
+					m_batched.indices.push_back(i);
+					m_batched.indices.push_back(i + 1);
+					m_batched.indices.push_back(i + 2);
+					m_batched.indices.push_back(i + 1);
+					m_batched.indices.push_back(i + 3);
+					m_batched.indices.push_back(i + 2);
 				}
 				if (i < baseVertexIndex + m_batched.primitiveCount)
 				{
-					m_batched.indices.push_back(static_cast<UINT16>(i));
-					m_batched.indices.push_back(static_cast<UINT16>(i + 1));
-					m_batched.indices.push_back(static_cast<UINT16>(i + 2));
+					m_batched.indices.push_back(i);
+					m_batched.indices.push_back(i + 1);
+					m_batched.indices.push_back(i + 2);
 				}
 			}
 			break;
@@ -431,9 +489,9 @@ namespace D3dDdi
 			{
 				for (UINT i = m_batched.baseVertexIndex; i < m_batched.baseVertexIndex + m_batched.primitiveCount; ++i)
 				{
-					m_batched.indices.push_back(static_cast<UINT16>(i + 1));
-					m_batched.indices.push_back(static_cast<UINT16>(i + 2));
-					m_batched.indices.push_back(static_cast<UINT16>(m_batched.baseVertexIndex));
+					m_batched.indices.push_back(i + 1);
+					m_batched.indices.push_back(i + 2);
+					m_batched.indices.push_back(static_cast<UINT>(m_batched.baseVertexIndex));
 				}
 			}
 			break;
@@ -494,6 +552,7 @@ namespace D3dDdi
 			m_batched.baseVertexIndex = data.BaseVertexOffset / static_cast<INT>(m_streamSource.stride);
 			if (m_streamSource.vertices)
 			{
+				mapBatchedVertices(data.NumVertices, indexCount);
 				appendIndexedVerticesWithoutRebase(indices, indexCount, m_batched.baseVertexIndex, *min, *max);
 				m_batched.baseVertexIndex = 0;
 			}
@@ -515,12 +574,49 @@ namespace D3dDdi
 		return S_OK;
 	}
 
-	void DrawPrimitive::fixFirstVertexRhw()
+	HRESULT DrawPrimitive::drawIndexedUm(D3DPRIMITIVETYPE primitiveType, UINT primitiveCount,
+		const void* vertices, UINT stride, const UINT16* indices)
 	{
-		auto firstVertex = reinterpret_cast<D3DTLVERTEX*>(m_batched.vertices.data());
-		if ((m_streamSource.fvf & D3DFVF_XYZRHW) && 0.0f == firstVertex->rhw)
+		HRESULT result = flushPrimitives();
+		if (FAILED(result))
+		{
+			return result;
+		}
+
+		const StreamSource streamSource = m_streamSource;
+		result = setSysMemStreamSource(static_cast<const BYTE*>(vertices), stride, 0);
+		if (SUCCEEDED(result))
 		{
-			firstVertex->rhw = 1.0f;
+			D3DDDIARG_DRAWINDEXEDPRIMITIVE2 data = {};
+			data.PrimitiveType = primitiveType;
+			data.PrimitiveCount = primitiveCount;
+			drawIndexed(data, indices, nullptr);
+			result = flushPrimitives();
+		}
+
+		if (streamSource.vertices)
+		{
+			setSysMemStreamSource(streamSource.vertices, streamSource.stride, streamSource.fvf);
+		}
+		else
+		{
+			if (streamSource.vertexBuffer)
+			{
+				D3DDDIARG_SETSTREAMSOURCE ss = {};
+				ss.hVertexBuffer = streamSource.vertexBuffer;
+				ss.Stride = streamSource.stride;
+				m_origVtable.pfnSetStreamSource(m_device, &ss);
+			}
+			m_streamSource = streamSource;
+		}
+		return result;
+	}
+
+	void DrawPrimitive::fixFirstVertexRhw(BYTE* dst, const BYTE* src)
+	{
+		if ((m_streamSource.fvf & D3DFVF_XYZRHW) && 0.0f == reinterpret_cast<const D3DTLVERTEX*>(src)->rhw)
+		{
+			reinterpret_cast<D3DTLVERTEX*>(dst)->rhw = 1.0f;
 		}
 	}
 
@@ -533,8 +629,7 @@ namespace D3dDdi
 
 		if (m_streamSource.vertices)
 		{
-			fixFirstVertexRhw();
-			data.VStart = loadVertices(m_batched.vertices.data(), getBatchedVertexCount());
+			data.VStart = loadBatchedVertices();
 		}
 
 		clearBatchedPrimitives();
@@ -543,6 +638,11 @@ namespace D3dDdi
 
 	HRESULT DrawPrimitive::flushIndexed(const UINT* flagBuffer)
 	{
+		if (D3DPT_TRIANGLELIST == m_batched.primitiveType && !flagBuffer)
+		{
+			optimizeVertexCache();
+		}
+
 		D3DDDIARG_DRAWINDEXEDPRIMITIVE2 data = {};
 		data.PrimitiveType = m_batched.primitiveType;
 		data.BaseVertexOffset = m_batched.baseVertexIndex * static_cast<INT>(m_streamSource.stride);
@@ -560,8 +660,7 @@ namespace D3dDdi
 
 		if (m_streamSource.vertices)
 		{
-			fixFirstVertexRhw();
-			INT baseVertexIndex = loadVertices(m_batched.vertices.data(), data.NumVertices) - data.MinIndex;
+			INT baseVertexIndex = loadBatchedVertices() - data.MinIndex;
 			data.BaseVertexOffset = baseVertexIndex * static_cast<INT>(m_streamSource.stride);
 		}
 
@@ -583,9 +682,18 @@ namespace D3dDdi
 			dp.PrimitiveCount = data.PrimitiveCount;
 			result = m_origVtable.pfnDrawIndexedPrimitive(m_device, &dp);
 		}
+		else if (4 == m_indexBuffer.getStride())
+		{
+			result = m_origVtable.pfnDrawIndexedPrimitive2(m_device, &data, 4, m_batched.indices.data(), flagBuffer);
+		}
 		else
 		{
-			result = m_origVtable.pfnDrawIndexedPrimitive2(m_device, &data, 2, m_batched.indices.data(), flagBuffer);
+			m_narrowedIndices.resize(m_batched.indices.size());
+			for (UINT i = 0; i < m_batched.indices.size(); ++i)
+			{
+				m_narrowedIndices[i] = static_cast<UINT16>(m_batched.indices[i]);
+			}
+			result = m_origVtable.pfnDrawIndexedPrimitive2(m_device, &data, 2, m_narrowedIndices.data(), flagBuffer);
 		}
 
 		clearBatchedPrimitives();
@@ -605,10 +713,20 @@ namespace D3dDdi
 
 	UINT DrawPrimitive::getBatchedVertexCount() const
 	{
-		return m_batched.vertices.size() / m_streamSource.stride;
+		return m_batched.vertexCount;
+	}
+
+	INT DrawPrimitive::loadBatchedVertices()
+	{
+		if (m_batched.mappedVertices)
+		{
+			m_batched.mappedVertices = nullptr;
+			return m_vertexBuffer.unmap(getBatchedVertexCount() * m_streamSource.stride);
+		}
+		return loadVertices(m_batched.vertices.data(), getBatchedVertexCount());
 	}
 
-	INT DrawPrimitive::loadIndices(const void* indices, UINT count)
+	INT DrawPrimitive::loadIndices(const UINT* indices, UINT count)
 	{
 		INT startIndex = m_indexBuffer.load(indices, count);
 		if (startIndex >= 0)
@@ -625,24 +743,7 @@ namespace D3dDdi
 	{
 		if (m_vertexBuffer)
 		{
-			UINT size = count * m_streamSource.stride;
-			if (size > m_vertexBuffer.getSize())
-			{
-				m_vertexBuffer.resize((size + VERTEX_BUFFER_SIZE - 1) / VERTEX_BUFFER_SIZE * VERTEX_BUFFER_SIZE);
-				if (m_vertexBuffer)
-				{
-					D3DDDIARG_SETSTREAMSOURCE ss = {};
-					ss.hVertexBuffer = m_vertexBuffer;
-					ss.Stride = m_streamSource.stride;
-					m_origVtable.pfnSetStreamSource(m_device, &ss);
-				}
-				else
-				{
-					LOG_ONCE("WARN: Dynamic vertex buffer resize failed");
-				}
-			}
-
-			if (m_vertexBuffer)
+			if (reserveVertexBuffer(count * m_streamSource.stride))
 			{
 				INT baseVertexIndex = m_vertexBuffer.load(vertices, count);
 				if (baseVertexIndex >= 0)
@@ -662,6 +763,102 @@ namespace D3dDdi
 		return 0;
 	}
 
+	bool DrawPrimitive::isTriangleOrderIndependent()
+	{
+		// Without strict depth testing and depth writes, overlapping triangles resolve in draw order
+		const auto& state = m_device.getState();
+		const D3DDDIRENDERSTATETYPE orderStates[] = {
+			D3DDDIRS_ZENABLE, D3DDDIRS_ZWRITEENABLE, D3DDDIRS_ZFUNC, D3DDDIRS_ALPHABLENDENABLE, D3DDDIRS_STENCILENABLE };
+		for (auto orderState : orderStates)
+		{
+			if (!state.isRenderStateKnown(orderState))
+			{
+				return false;
+			}
+		}
+
+		const UINT zFunc = state.getRenderState(D3DDDIRS_ZFUNC);
+		return D3DZB_FALSE != state.getRenderState(D3DDDIRS_ZENABLE) &&
+			state.getRenderState(D3DDDIRS_ZWRITEENABLE) &&
+			(D3DCMP_LESS == zFunc || D3DCMP_GREATER == zFunc) &&
+			!state.getRenderState(D3DDDIRS_ALPHABLENDENABLE) &&
+			!state.getRenderState(D3DDDIRS_STENCILENABLE);
+	}
+
+	bool DrawPrimitive::hasMappedVertexCapacity(D3DPRIMITIVETYPE primitiveType, UINT primitiveCount) const
+	{
+		if (!m_batched.mappedVertices)
+		{
+			return true;
+		}
+
+		// Each appended index or vertex adds at most one batched vertex, and strip joins repeat up to 3 more
+		UINT vertexCount = getVertexCount(primitiveType, primitiveCount);
+		if (D3DPT_TRIANGLESTRIP == primitiveType)
+		{
+			vertexCount += 3;
+		}
+		return (getBatchedVertexCount() + vertexCount) * m_streamSource.stride <= m_batched.mappedSize;
+	}
+
+	void DrawPrimitive::mapBatchedVertices(UINT count, UINT indexCount)
+	{
+		// Vertex fetch reordering needs the batched vertices in system memory. The batch only grows from here,
+		// so a first draw over the index budget can't be reordered and keeps the mapping.
+		if (!m_vertexBuffer || m_batched.mappedVertices || 0 != getBatchedVertexCount() ||
+			(indexCount <= Config::maxVertexCacheOptimizedIndices && isTriangleOrderIndependent()))
+		{
+			return;
+		}
+
+		const UINT size = count * m_streamSource.stride;
+		if (reserveVertexBuffer(size))
+		{
+			m_batched.mappedVertices = static_cast<BYTE*>(m_vertexBuffer.map(size, m_batched.mappedSize));
+			if (m_batched.mappedVertices)
+			{
+				return;
+			}
+			LOG_ONCE("WARN: Dynamic vertex buffer lock failed");
+		}
+
+		m_vertexBuffer.resize(0);
+		m_indexBuffer.resize(0);
+	}
+
+	void DrawPrimitive::optimizeVertexCache()
+	{
+		const UINT indexCount = m_batched.indices.size();
+		if (indexCount < 6 || indexCount > Config::maxVertexCacheOptimizedIndices || !isTriangleOrderIndependent())
+		{
+			return;
+		}
+
+		auto indices = m_batched.indices.data();
+		const UINT missCountBefore = VertexCacheOptimizer::getCacheMissCount(indices, indexCount);
+		m_vertexCacheOptimizer.optimizeTriangleOrder(indices, indexCount);
+
+		if (m_streamSource.vertices && !m_batched.mappedVertices && 0 == m_batched.baseVertexIndex &&
+			*std::max_element(indices, indices + indexCount) < getBatchedVertexCount())
+		{
+			// The first referenced vertex becomes the first batched vertex, so move the rhw fix over to it
+			if (m_streamSource.fvf & D3DFVF_XYZRHW)
+			{
+				reinterpret_cast<D3DTLVERTEX*>(m_batched.vertices.data())->rhw = m_batched.firstVertexRhw;
+				auto newFirstVertex = m_batched.vertices.data() + indices[0] * m_streamSource.stride;
+				fixFirstVertexRhw(newFirstVertex, newFirstVertex);
+			}
+			m_vertexCacheOptimizer.optimizeVertexOrder(indices, indexCount, m_batched.vertices, m_streamSource.stride);
+		}
+
+		const UINT missCountAfter = VertexCacheOptimizer::getCacheMissCount(indices, indexCount);
+		m_vertexCacheStats.triangleCount += indexCount / 3;
+		m_vertexCacheStats.missCountBefore += missCountBefore;
+		m_vertexCacheStats.missCountAfter += missCountAfter;
+		LOG_DEBUG << "Vertex cache ACMR: " << static_cast<float>(missCountBefore) * 3 / indexCount <<
+			" -> " << static_cast<float>(missCountAfter) * 3 / indexCount;
+	}
+
 	void DrawPrimitive::rebaseIndices()
 	{
 		if (0 != m_batched.baseVertexIndex || m_batched.indices.empty())
@@ -675,7 +872,7 @@ namespace D3dDdi
 			{
 				for (auto& index : m_batched.indices)
 				{
-					index = static_cast<UINT16>(m_batched.baseVertexIndex + index);
+					index = static_cast<UINT>(m_batched.baseVertexIndex + index);
 				}
 				m_batched.minIndex += m_batched.baseVertexIndex;
 				m_batched.maxIndex += m_batched.baseVertexIndex;
@@ -688,9 +885,8 @@ namespace D3dDdi
 	{
 		if (m_batched.indices.empty())
 		{
-			m_batched.vertices.reserve(m_batched.vertices.size() + m_streamSource.stride);
-			m_batched.vertices.insert(m_batched.vertices.end(),
-				m_batched.vertices.end() - m_streamSource.stride, m_batched.vertices.end());
+			const std::vector<BYTE> lastVertex(m_batched.lastVertex);
+			appendBatchedVertices(lastVertex.data(), 1);
 		}
 		else
 		{
@@ -698,6 +894,46 @@ namespace D3dDdi
 		}
 	}
 
+	BYTE* DrawPrimitive::reserveBatchedVertices(UINT count)
+	{
+		const UINT offset = getBatchedVertexCount() * m_streamSource.stride;
+		const UINT size = count * m_streamSource.stride;
+		if (0 == offset)
+		{
+			mapBatchedVertices(count, count);
+		}
+
+		// The mapping is write-only, so appendPrimitives rejects anything that would outgrow it
+		m_batched.vertexCount += count;
+		if (m_batched.mappedVertices)
+		{
+			return m_batched.mappedVertices + offset;
+		}
+
+		m_batched.vertices.resize(offset + size);
+		return m_batched.vertices.data() + offset;
+	}
+
+	bool DrawPrimitive::reserveVertexBuffer(UINT size)
+	{
+		if (size > m_vertexBuffer.getSize())
+		{
+			m_vertexBuffer.resize((size + VERTEX_BUFFER_SIZE - 1) / VERTEX_BUFFER_SIZE * VERTEX_BUFFER_SIZE);
+			if (m_vertexBuffer)
+			{
+				D3DDDIARG_SETSTREAMSOURCE ss = {};
+				ss.hVertexBuffer = m_vertexBuffer;
+				ss.Stride = m_streamSource.stride;
+				m_origVtable.pfnSetStreamSource(m_device, &ss);
+			}
+			else
+			{
+				LOG_ONCE("WARN: Dynamic vertex buffer resize failed");
+			}
+		}
+		return nullptr != static_cast<HANDLE>(m_vertexBuffer);
+	}
+
 	void DrawPrimitive::removeSysMemVertexBuffer(HANDLE resource)
 	{
 		m_sysMemVertexBuffers.erase(resource);
@@ -715,7 +951,7 @@ namespace D3dDdi
 		HRESULT result = m_origVtable.pfnSetStreamSource(m_device, &data);
 		if (SUCCEEDED(result))
 		{
-			m_streamSource = { nullptr, data.Stride, 0 };
+			m_streamSource = { nullptr, data.Stride, 0, data.hVertexBuffer };
 		}
 		return result;
 	}
@@ -746,7 +982,7 @@ namespace D3dDdi
 
 		if (SUCCEEDED(result))
 		{
-			m_streamSource = { vertices, stride, fvf };
+			m_streamSource = { vertices, stride, fvf, nullptr };
 		}
 		return result;
 	}
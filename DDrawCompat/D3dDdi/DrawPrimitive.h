@@ -7,6 +7,7 @@
 #include <d3dumddi.h>
 
 #include <D3dDdi/DynamicBuffer.h>
+#include <D3dDdi/VertexCacheOptimizer.h>
 
 namespace D3dDdi
 {
@@ -16,6 +17,7 @@ namespace D3dDdi
 	{
 	public:
 		DrawPrimitive(Device& device);
+		~DrawPrimitive();
 
 		void addSysMemVertexBuffer(HANDLE resource, BYTE* vertices, UINT fvf);
 		void removeSysMemVertexBuffer(HANDLE resource);
@@ -24,6 +26,8 @@ namespace D3dDdi
 
 		HRESULT draw(D3DDDIARG_DRAWPRIMITIVE data, const UINT* flagBuffer);
 		HRESULT drawIndexed(D3DDDIARG_DRAWINDEXEDPRIMITIVE2 data, const UINT16* indices, const UINT* flagBuffer);
+		HRESULT drawIndexedUm(D3DPRIMITIVETYPE primitiveType, UINT primitiveCount,
+			const void* vertices, UINT stride, const UINT16* indices);
 		HRESULT setStreamSource(const D3DDDIARG_SETSTREAMSOURCE& data);
 		HRESULT setStreamSourceUm(const D3DDDIARG_SETSTREAMSOURCEUM& data, const void* umBuffer);
 
@@ -35,8 +39,19 @@ namespace D3dDdi
 			INT baseVertexIndex;
 			UINT minIndex;
 			UINT maxIndex;
+			UINT vertexCount;
+			BYTE* mappedVertices;
+			UINT mappedSize;
+			float firstVertexRhw;
 			std::vector<BYTE> vertices;
-			std::vector<UINT16> indices;
+			std::vector<BYTE> lastVertex;
+			std::vector<UINT> indices;
+		};
+
+		struct IndexRemap
+		{
+			UINT index;
+			UINT epoch;
 		};
 
 		struct StreamSource
@@ -44,6 +59,7 @@ namespace D3dDdi
 			const BYTE* vertices;
 			UINT stride;
 			UINT fvf;
+			HANDLE vertexBuffer;
 		};
 
 		struct SysMemVertexBuffer
@@ -52,6 +68,14 @@ namespace D3dDdi
 			UINT fvf;
 		};
 
+		struct VertexCacheStats
+		{
+			UINT64 triangleCount;
+			UINT64 missCountBefore;
+			UINT64 missCountAfter;
+		};
+
+		void appendBatchedVertices(const BYTE* vertices, UINT count);
 		void appendIndexedVertices(const UINT16* indices, UINT count,
 			INT baseVertexIndex, UINT minIndex, UINT maxIndex);
 		void appendIndexedVerticesWithoutRebase(const UINT16* indices, UINT count,
@@ -75,23 +99,36 @@ namespace D3dDdi
 		void convertIndexedTriangleFanToList(UINT startPrimitive, UINT primitiveCount);
 		void convertIndexedTriangleStripToList(UINT startPrimitive, UINT primitiveCount);
 		void convertToTriangleList();
-		void fixFirstVertexRhw();
+		void fixFirstVertexRhw(BYTE* dst, const BYTE* src);
 		HRESULT flush(const UINT* flagBuffer);
 		HRESULT flushIndexed(const UINT* flagBuffer);
-		INT loadIndices(const void* indices, UINT count);
+		INT loadBatchedVertices();
+		INT loadIndices(const UINT* indices, UINT count);
 		INT loadVertices(const void* vertices, UINT count);
 		UINT getBatchedVertexCount() const;
+		bool hasMappedVertexCapacity(D3DPRIMITIVETYPE primitiveType, UINT primitiveCount) const;
+		void mapBatchedVertices(UINT count, UINT indexCount);
+		bool isTriangleOrderIndependent();
+		void optimizeVertexCache();
+		BYTE* reserveBatchedVertices(UINT count);
+		bool reserveVertexBuffer(UINT size);
 		void rebaseIndices();
 		void repeatLastBatchedVertex();
 
 		HRESULT setSysMemStreamSource(const BYTE* vertices, UINT stride, UINT fvf);
 
-		HANDLE m_device;
+		Device& m_device;
 		const D3DDDI_DEVICEFUNCS& m_origVtable;
 		DynamicVertexBuffer m_vertexBuffer;
 		DynamicIndexBuffer m_indexBuffer;
 		StreamSource m_streamSource;
 		std::map<HANDLE, SysMemVertexBuffer> m_sysMemVertexBuffers;
 		BatchedPrimitives m_batched;
+		UINT m_maxBatchedIndexCount;
+		std::vector<UINT16> m_narrowedIndices;
+		std::vector<IndexRemap> m_indexRemap;
+		UINT m_indexRemapEpoch;
+		VertexCacheOptimizer m_vertexCacheOptimizer;
+		VertexCacheStats m_vertexCacheStats;
 	};
 }
@@ -1,3 +1,6 @@
+#include <algorithm>
+
+#include <Config/Config.h>
 #include <D3dDdi/Device.h>
 #include <D3dDdi/DynamicBuffer.h>
 
@@ -24,25 +27,82 @@ namespace D3dDdi
 		D3DDDIFORMAT format, D3DDDI_RESOURCEFLAGS resourceFlag)
 		: m_device(device)
 		, m_origVtable(origVtable)
-		, m_resource(nullptr, [device, destroy = origVtable.pfnDestroyResource](HANDLE vb) { destroy(device, vb); })
 		, m_size(size)
 		, m_format(format)
 		, m_resourceFlag(resourceFlag)
 		, m_stride(0)
 		, m_pos(0)
+		, m_segmentIndex(0)
+		, m_isDiscardNeeded(false)
 	{
 		resize(size);
 	}
 
+	DynamicBuffer::Segment DynamicBuffer::createSegment(UINT size)
+	{
+		D3DDDI_SURFACEINFO surfaceInfo = {};
+		surfaceInfo.Width = size;
+		surfaceInfo.Height = 1;
+
+		D3DDDIARG_CREATERESOURCE2 cr = {};
+		cr.Format = m_format;
+		cr.Pool = D3DDDIPOOL_VIDEOMEMORY;
+		cr.pSurfList = &surfaceInfo;
+		cr.SurfCount = 1;
+		cr.Flags = m_resourceFlag;
+		cr.Flags.Dynamic = 1;
+		cr.Flags.WriteOnly = 1;
+		cr.Rotation = D3DDDI_ROTATION_IDENTITY;
+
+		Segment segment = {
+			{ nullptr, [device = m_device, destroy = m_origVtable.pfnDestroyResource](HANDLE r) { destroy(device, r); } },
+			{ nullptr, [device = m_device, destroy = m_origVtable.pfnDestroyQuery](HANDLE q) { destroy(device, q); } },
+			false
+		};
+
+		if (SUCCEEDED(m_origVtable.pfnCreateResource2
+			? m_origVtable.pfnCreateResource2(m_device, &cr)
+			: m_origVtable.pfnCreateResource(m_device, reinterpret_cast<D3DDDIARG_CREATERESOURCE*>(&cr))))
+		{
+			segment.resource.reset(cr.hResource);
+
+			D3DDDIARG_CREATEQUERY cq = {};
+			cq.QueryType = D3DDDIQUERYTYPE_EVENT;
+			if (m_origVtable.pfnCreateQuery && SUCCEEDED(m_origVtable.pfnCreateQuery(m_device, &cq)))
+			{
+				segment.query.reset(cq.hQuery);
+			}
+		}
+		return segment;
+	}
+
+	bool DynamicBuffer::isRetired(const Segment& segment)
+	{
+		if (!segment.isQueryIssued)
+		{
+			return true;
+		}
+		if (!segment.query)
+		{
+			return false;
+		}
+
+		BOOL isSignaled = FALSE;
+		D3DDDIARG_GETQUERYDATA gqd = {};
+		gqd.hQuery = segment.query.get();
+		gqd.pData = &isSignaled;
+		return S_OK == m_origVtable.pfnGetQueryData(m_device, &gqd) && isSignaled;
+	}
+
 	void* DynamicBuffer::lock(UINT size)
 	{
 		D3DDDIARG_LOCK lock = {};
-		lock.hResource = m_resource.get();
+		lock.hResource = *this;
 		lock.Range.Offset = m_pos;
 		lock.Range.Size = size;
 		lock.Flags.RangeValid = 1;
 
-		if (0 == m_pos)
+		if (m_isDiscardNeeded)
 		{
 			lock.Flags.Discard = 1;
 		}
@@ -57,6 +117,7 @@ namespace D3dDdi
 		{
 			return nullptr;
 		}
+		m_isDiscardNeeded = false;
 		return lock.pSurfData;
 	}
 
@@ -65,7 +126,7 @@ namespace D3dDdi
 		UINT size = count * m_stride;
 		if (m_pos + size > m_size)
 		{
-			m_pos = 0;
+			nextSegment();
 		}
 
 		UINT pos = m_pos;
@@ -81,35 +142,63 @@ namespace D3dDdi
 		return pos / m_stride;
 	}
 
+	void* DynamicBuffer::map(UINT minSize, UINT& mappedSize)
+	{
+		if (m_pos + minSize > m_size)
+		{
+			nextSegment();
+		}
+
+		mappedSize = m_size - m_pos;
+		return lock(mappedSize);
+	}
+
+	void DynamicBuffer::nextSegment()
+	{
+		auto& segment = m_segments[m_segmentIndex];
+		if (segment.query)
+		{
+			D3DDDIARG_ISSUEQUERY iq = {};
+			iq.hQuery = segment.query.get();
+			iq.Flags.End = 1;
+			m_origVtable.pfnIssueQuery(m_device, &iq);
+		}
+		segment.isQueryIssued = true;
+
+		m_segmentIndex = (m_segmentIndex + 1) % m_segments.size();
+		m_pos = 0;
+		m_isDiscardNeeded = !isRetired(m_segments[m_segmentIndex]);
+		if (m_segments.size() > 1)
+		{
+			bind();
+		}
+	}
+
 	void DynamicBuffer::resize(UINT size)
 	{
 		m_size = 0;
+		m_pos = 0;
+		m_segmentIndex = 0;
+		m_isDiscardNeeded = false;
+		m_segments.clear();
 		if (0 == size)
 		{
-			m_resource.reset();
 			return;
 		}
 
-		D3DDDI_SURFACEINFO surfaceInfo = {};
-		surfaceInfo.Width = size;
-		surfaceInfo.Height = 1;
-
-		D3DDDIARG_CREATERESOURCE2 cr = {};
-		cr.Format = m_format;
-		cr.Pool = D3DDDIPOOL_VIDEOMEMORY;
-		cr.pSurfList = &surfaceInfo;
-		cr.SurfCount = 1;
-		cr.Flags = m_resourceFlag;
-		cr.Flags.Dynamic = 1;
-		cr.Flags.WriteOnly = 1;
-		cr.Rotation = D3DDDI_ROTATION_IDENTITY;
+		const UINT segmentCount = std::max<UINT>(Config::dynamicBufferSegments, 1);
+		for (UINT i = 0; i < segmentCount; ++i)
+		{
+			Segment segment = createSegment(size);
+			if (!segment.resource)
+			{
+				break;
+			}
+			m_segments.push_back(std::move(segment));
+		}
 
-		m_resource.reset();
-		if (SUCCEEDED(m_origVtable.pfnCreateResource2
-			? m_origVtable.pfnCreateResource2(m_device, &cr)
-			: m_origVtable.pfnCreateResource(m_device, reinterpret_cast<D3DDDIARG_CREATERESOURCE*>(&cr))))
+		if (!m_segments.empty())
 		{
-			m_resource.reset(cr.hResource);
 			m_size = size;
 		}
 	}
@@ -120,21 +209,73 @@ namespace D3dDdi
 		m_pos = (m_pos + stride - 1) / stride * stride;
 	}
 
+	INT DynamicBuffer::unmap(UINT usedSize)
+	{
+		unlock();
+		UINT pos = m_pos;
+		m_pos += usedSize;
+		return pos / m_stride;
+	}
+
 	void DynamicBuffer::unlock()
 	{
 		D3DDDIARG_UNLOCK unlock = {};
-		unlock.hResource = m_resource.get();
+		unlock.hResource = *this;
 		m_origVtable.pfnUnlock(m_device, &unlock);
 	}
 
-	DynamicIndexBuffer::DynamicIndexBuffer(Device& device, UINT size)
-		: DynamicBuffer(device, device.getOrigVtable(), size, D3DDDIFMT_INDEX16, getIndexBufferFlag())
+	DynamicIndexBuffer::DynamicIndexBuffer(Device& device, UINT size, bool is32Bit)
+		: DynamicBuffer(device, device.getOrigVtable(), size,
+			is32Bit ? D3DDDIFMT_INDEX32 : D3DDDIFMT_INDEX16, getIndexBufferFlag())
 	{
-		m_stride = 2;
+		m_stride = is32Bit ? 4 : 2;
+		if (is32Bit && 0 != size && 0 == m_size)
+		{
+			m_format = D3DDDIFMT_INDEX16;
+			m_stride = 2;
+			resize(size);
+		}
+	}
+
+	INT DynamicIndexBuffer::load(const UINT* indices, UINT count)
+	{
+		if (4 == m_stride)
+		{
+			return DynamicBuffer::load(indices, count);
+		}
+
+		UINT mappedSize = 0;
+		auto dst = static_cast<UINT16*>(map(count * m_stride, mappedSize));
+		if (!dst)
+		{
+			return -1;
+		}
+
+		for (UINT i = 0; i < count; ++i)
+		{
+			dst[i] = static_cast<UINT16>(indices[i]);
+		}
+		return unmap(count * m_stride);
+	}
+
+	void DynamicIndexBuffer::bind()
+	{
+		D3DDDIARG_SETINDICES si = {};
+		si.hIndexBuffer = *this;
+		si.Stride = m_stride;
+		m_origVtable.pfnSetIndices(m_device, &si);
 	}
 
 	DynamicVertexBuffer::DynamicVertexBuffer(Device& device, UINT size)
 		: DynamicBuffer(device, device.getOrigVtable(), size, D3DDDIFMT_VERTEXDATA, getVertexBufferFlag())
 	{
 	}
+
+	void DynamicVertexBuffer::bind()
+	{
+		D3DDDIARG_SETSTREAMSOURCE ss = {};
+		ss.hVertexBuffer = *this;
+		ss.Stride = m_stride;
+		m_origVtable.pfnSetStreamSource(m_device, &ss);
+	}
 }
@@ -2,6 +2,7 @@
 
 #include <functional>
 #include <memory>
+#include <vector>
 
 #include <d3d.h>
 #include <d3dumddi.h>
@@ -14,33 +15,57 @@ namespace D3dDdi
 	{
 	public:
 		UINT getSize() const { return m_size; }
+		UINT getStride() const { return m_stride; }
 		INT load(const void* src, UINT count);
+		void* map(UINT minSize, UINT& mappedSize);
 		void resize(UINT size);
+		INT unmap(UINT usedSize);
 
-		operator HANDLE() const { return m_resource.get(); }
+		operator HANDLE() const { return m_segments.empty() ? nullptr : m_segments[m_segmentIndex].resource.get(); }
 
 	protected:
 		DynamicBuffer(HANDLE device, const D3DDDI_DEVICEFUNCS& origVtable, UINT size,
 			D3DDDIFORMAT format, D3DDDI_RESOURCEFLAGS resourceFlag);
 
+		virtual void bind() = 0;
 		void* lock(UINT size);
 		void setStride(UINT stride);
 		void unlock();
 
 		HANDLE m_device;
 		const D3DDDI_DEVICEFUNCS& m_origVtable;
-		std::unique_ptr<void, std::function<void(HANDLE)>> m_resource;
 		UINT m_size;
 		D3DDDIFORMAT m_format;
 		D3DDDI_RESOURCEFLAGS m_resourceFlag;
 		UINT m_stride;
 		UINT m_pos;
+
+	private:
+		struct Segment
+		{
+			std::unique_ptr<void, std::function<void(HANDLE)>> resource;
+			std::unique_ptr<void, std::function<void(HANDLE)>> query;
+			bool isQueryIssued;
+		};
+
+		Segment createSegment(UINT size);
+		bool isRetired(const Segment& segment);
+		void nextSegment();
+
+		std::vector<Segment> m_segments;
+		UINT m_segmentIndex;
+		bool m_isDiscardNeeded;
 	};
 
 	class DynamicIndexBuffer : public DynamicBuffer
 	{
 	public:
-		DynamicIndexBuffer(Device& device, UINT size);
+		DynamicIndexBuffer(Device& device, UINT size, bool is32Bit);
+
+		INT load(const UINT* indices, UINT count);
+
+	private:
+		void bind() override;
 	};
 
 	class DynamicVertexBuffer : public DynamicBuffer
@@ -49,5 +74,8 @@ namespace D3dDdi
 		DynamicVertexBuffer(Device& device, UINT size);
 
 		using DynamicBuffer::setStride;
+
+	private:
+		void bind() override;
 	};
 }
@@ -5,6 +5,7 @@
 #include <Common/Time.h>
 #include <Config/Config.h>
 #include <D3dDdi/Adapter.h>
+#include <D3dDdi/BltQueue.h>
 #include <D3dDdi/Device.h>
 #include <D3dDdi/KernelModeThunks.h>
 #include <D3dDdi/Log/DeviceFuncsLog.h>
@@ -19,11 +20,87 @@ namespace
 
 	const UINT g_resourceTypeFlags = getResourceTypeFlags().Value;
 
+	bool isRotatedBlt(const D3DDDIARG_BLT& data)
+	{
+		return data.Flags.Rotate && D3DDDI_ROTATION_IDENTITY != data.Rotation;
+	}
+
+	void bltSysMem(BYTE* dstBuf, UINT dstPitch, const D3dDdi::FormatInfo& dstFormatInfo,
+		const BYTE* srcBuf, UINT srcPitch, const D3dDdi::FormatInfo& srcFormatInfo,
+		bool isSameFormat, const D3DDDIARG_BLT& data)
+	{
+		const LONG dstWidth = data.DstRect.right - data.DstRect.left;
+		const LONG dstHeight = data.DstRect.bottom - data.DstRect.top;
+		const LONG srcWidth = data.SrcRect.right - data.SrcRect.left;
+		const LONG srcHeight = data.SrcRect.bottom - data.SrcRect.top;
+		const DWORD colorKey = data.ColorKey;
+		const DWORD* dstColorKey = data.Flags.DstColorKey ? &colorKey : nullptr;
+		const DWORD* srcColorKey = data.Flags.SrcColorKey ? &colorKey : nullptr;
+
+		if (isRotatedBlt(data))
+		{
+			DDraw::Blitter::Rotation rotation = DDraw::Blitter::ROTATE_180;
+			switch (data.Rotation)
+			{
+			case D3DDDI_ROTATION_90: rotation = DDraw::Blitter::ROTATE_90; break;
+			case D3DDDI_ROTATION_270: rotation = DDraw::Blitter::ROTATE_270; break;
+			}
+			DDraw::Blitter::rotateBlt(dstBuf, dstPitch, dstWidth, dstHeight,
+				srcBuf, srcPitch, dstFormatInfo.bytesPerPixel, rotation);
+			return;
+		}
+
+		if (!isSameFormat)
+		{
+			DDraw::Blitter::convertBlt(dstBuf, dstPitch, dstWidth, dstHeight, dstFormatInfo,
+				srcBuf, srcPitch,
+				(1 - 2 * data.Flags.MirrorLeftRight) * srcWidth,
+				(1 - 2 * data.Flags.MirrorUpDown) * srcHeight,
+				srcFormatInfo, dstColorKey, srcColorKey);
+			return;
+		}
+
+		if (data.Flags.Linear &&
+			(dstWidth != srcWidth || dstHeight != srcHeight) &&
+			!data.Flags.MirrorLeftRight && !data.Flags.MirrorUpDown &&
+			!data.Flags.SrcColorKey && !data.Flags.DstColorKey &&
+			DDraw::Blitter::filteredBlt(dstBuf, dstPitch, dstWidth, dstHeight,
+				srcBuf, srcPitch, srcWidth, srcHeight, dstFormatInfo, DDraw::Blitter::FILTER_BILINEAR))
+		{
+			return;
+		}
+
+		DDraw::Blitter::blt(dstBuf, dstPitch, dstWidth, dstHeight,
+			srcBuf, srcPitch,
+			(1 - 2 * data.Flags.MirrorLeftRight) * srcWidth,
+			(1 - 2 * data.Flags.MirrorUpDown) * srcHeight,
+			dstFormatInfo.bytesPerPixel, dstColorKey, srcColorKey);
+	}
+
 	LONG divCeil(LONG n, LONG d)
 	{
 		return (n + d - 1) / d;
 	}
 
+	bool isSysMemBltSupported(const D3DDDIARG_BLT& data, bool isSameFormat)
+	{
+		if (!isRotatedBlt(data))
+		{
+			return true;
+		}
+
+		const LONG dstWidth = data.DstRect.right - data.DstRect.left;
+		const LONG dstHeight = data.DstRect.bottom - data.DstRect.top;
+		const LONG srcWidth = data.SrcRect.right - data.SrcRect.left;
+		const LONG srcHeight = data.SrcRect.bottom - data.SrcRect.top;
+		const bool isTransposed = D3DDDI_ROTATION_90 == data.Rotation || D3DDDI_ROTATION_270 == data.Rotation;
+		return isSameFormat &&
+			!data.Flags.SrcColorKey && !data.Flags.DstColorKey &&
+			!data.Flags.MirrorLeftRight && !data.Flags.MirrorUpDown &&
+			dstWidth == (isTransposed ? srcHeight : srcWidth) &&
+			dstHeight == (isTransposed ? srcWidth : srcHeight);
+	}
+
 	void fixResourceData(D3dDdi::Device& device, D3DDDIARG_CREATERESOURCE& data)
 	{
 		if (data.Flags.Primary)
@@ -190,11 +267,16 @@ namespace D3dDdi
 	{
 		if (m_lockResource)
 		{
+			waitForAsyncBlt(0);
 			if (!m_lockData[0].isSysMemUpToDate)
 			{
 				copyToSysMem(0);
 			}
 			m_lockData[0].isVidMemUpToDate &= isReadOnly;
+			if (!isReadOnly)
+			{
+				m_lockData[0].colorKeySpans.invalidate();
+			}
 		}
 	}
 
@@ -216,12 +298,19 @@ namespace D3dDdi
 			if (D3DDDIPOOL_SYSTEMMEM == m_fixedData.Pool &&
 				D3DDDIPOOL_SYSTEMMEM == srcResource->m_fixedData.Pool)
 			{
+				waitForAsyncBlt(data.DstSubResourceIndex);
+				srcResource->waitForAsyncBlt(data.SrcSubResourceIndex);
 				return m_device.getOrigVtable().pfnBlt(m_device, &data);
 			}
 		}
 
 		if (isOversized())
 		{
+			waitForAsyncBlts();
+			if (srcResource)
+			{
+				srcResource->waitForAsyncBlt(data.SrcSubResourceIndex);
+			}
 			m_device.prepareForRendering(data.hSrcResource, data.SrcSubResourceIndex, true);
 			return splitBlt(data, data.DstSubResourceIndex, data.DstRect, data.SrcRect);
 		}
@@ -229,6 +318,8 @@ namespace D3dDdi
 		{
 			if (srcResource->isOversized())
 			{
+				waitForAsyncBlt(data.DstSubResourceIndex);
+				srcResource->waitForAsyncBlts();
 				prepareForRendering(data.DstSubResourceIndex, false);
 				return srcResource->splitBlt(data, data.SrcSubResourceIndex, data.SrcRect, data.DstRect);
 			}
@@ -241,6 +332,7 @@ namespace D3dDdi
 				return sysMemPreferredBlt(data, *srcResource);
 			}
 		}
+		waitForAsyncBlt(data.DstSubResourceIndex);
 		prepareForRendering(data.DstSubResourceIndex, false);
 		return m_device.getOrigVtable().pfnBlt(m_device, &data);
 	}
@@ -255,6 +347,10 @@ namespace D3dDdi
 			copyToSysMem(data.SubResourceIndex);
 		}
 		lockData.isVidMemUpToDate &= data.Flags.ReadOnly;
+		if (!data.Flags.ReadOnly)
+		{
+			lockData.colorKeySpans.invalidate();
+		}
 		lockData.qpcLastForcedLock = Time::queryPerformanceCounter();
 
 		unsigned char* ptr = static_cast<unsigned char*>(lockData.data);
@@ -301,6 +397,7 @@ namespace D3dDdi
 			auto& lockData = m_lockData[data.SubResourceIndex];
 			if (lockData.isSysMemUpToDate)
 			{
+				waitForAsyncBlt(data.SubResourceIndex);
 				auto dstBuf = static_cast<BYTE*>(lockData.data) +
 					data.DstRect.top * lockData.pitch + data.DstRect.left * m_formatInfo.bytesPerPixel;
 
@@ -308,7 +405,8 @@ namespace D3dDdi
 					data.DstRect.right - data.DstRect.left, data.DstRect.bottom - data.DstRect.top,
 					m_formatInfo.bytesPerPixel, colorConvert(m_formatInfo, data.Color));
 
-				m_lockData[data.SubResourceIndex].isVidMemUpToDate = false;
+				lockData.isVidMemUpToDate = false;
+				lockData.colorKeySpans.invalidate();
 				return LOG_RESULT(S_OK);
 			}
 		}
@@ -319,6 +417,7 @@ namespace D3dDdi
 	HRESULT Resource::copySubResource(HANDLE dstResource, HANDLE srcResource, UINT subResourceIndex)
 	{
 		LOG_FUNC("Resource::copySubResource", dstResource, srcResource, subResourceIndex);
+		m_device.getBltBatch().flush();
 		RECT rect = {};
 		rect.right = m_fixedData.pSurfList[subResourceIndex].Width;
 		rect.bottom = m_fixedData.pSurfList[subResourceIndex].Height;
@@ -341,12 +440,15 @@ namespace D3dDdi
 
 	void Resource::copyToSysMem(UINT subResourceIndex)
 	{
+		waitForAsyncBlt(subResourceIndex);
 		copySubResource(m_lockResource.get(), m_handle, subResourceIndex);
 		m_lockData[subResourceIndex].isSysMemUpToDate = true;
+		m_lockData[subResourceIndex].colorKeySpans.invalidate();
 	}
 
 	void Resource::copyToVidMem(UINT subResourceIndex)
 	{
+		waitForAsyncBlt(subResourceIndex);
 		copySubResource(m_handle, m_lockResource.get(), subResourceIndex);
 		m_lockData[subResourceIndex].isVidMemUpToDate = true;
 	}
@@ -480,6 +582,34 @@ namespace D3dDdi
 		return m_lockData.empty() ? nullptr : m_lockData[subResourceIndex].data;
 	}
 
+	void* Resource::getSysMemBuffer(UINT subResourceIndex, UINT& pitch)
+	{
+		if (isOversized())
+		{
+			if (0 != subResourceIndex)
+			{
+				return nullptr;
+			}
+			waitForAsyncBlts();
+			pitch = m_origData.pSurfList[0].SysMemPitch;
+			return const_cast<void*>(m_origData.pSurfList[0].pSysMem);
+		}
+
+		if (!m_lockResource || subResourceIndex >= m_lockData.size())
+		{
+			return nullptr;
+		}
+
+		auto& lockData = m_lockData[subResourceIndex];
+		waitForAsyncBlt(subResourceIndex);
+		if (!lockData.isSysMemUpToDate)
+		{
+			copyToSysMem(subResourceIndex);
+		}
+		pitch = lockData.pitch;
+		return lockData.data;
+	}
+
 	bool Resource::isOversized() const
 	{
 		return m_fixedData.SurfCount != m_origData.SurfCount;
@@ -496,6 +626,7 @@ namespace D3dDdi
 	{
 		if (isOversized())
 		{
+			waitForAsyncBlts();
 			if (0 != data.SubResourceIndex ||
 				data.Flags.RangeValid || data.Flags.AreaValid || data.Flags.BoxValid)
 			{
@@ -505,6 +636,7 @@ namespace D3dDdi
 			return splitLock(data, m_device.getOrigVtable().pfnLock);
 		}
 
+		waitForAsyncBlt(data.SubResourceIndex);
 		if (m_lockResource)
 		{
 			return bltLock(data);
@@ -527,6 +659,7 @@ namespace D3dDdi
 
 	HRESULT Resource::presentationBlt(const D3DDDIARG_BLT& data, Resource& srcResource)
 	{
+		srcResource.waitForAsyncBlt(data.SrcSubResourceIndex);
 		if (srcResource.m_lockResource &&
 			srcResource.m_lockData[data.SrcSubResourceIndex].isSysMemUpToDate)
 		{
@@ -537,6 +670,7 @@ namespace D3dDdi
 
 	void Resource::setAsGdiResource(bool isGdiResource)
 	{
+		waitForAsyncBlts();
 		m_lockResource.reset();
 		m_lockData.clear();
 		m_lockBuffer.reset();
@@ -546,6 +680,45 @@ namespace D3dDdi
 		}
 	}
 
+	bool Resource::oversizedSysMemBlt(const D3DDDIARG_BLT& data)
+	{
+		Resource* dstResource = m_device.getResource(data.hDstResource);
+		Resource* srcResource = m_device.getResource(data.hSrcResource);
+		if (!dstResource || !srcResource || dstResource == srcResource)
+		{
+			return false;
+		}
+
+		const bool isSameFormat = dstResource->m_fixedData.Format == srcResource->m_fixedData.Format;
+		if (!isSameFormat && !DDraw::Blitter::isConvertBltSupported(dstResource->m_formatInfo, srcResource->m_formatInfo) ||
+			!isSysMemBltSupported(data, isSameFormat))
+		{
+			return false;
+		}
+
+		UINT dstPitch = 0;
+		UINT srcPitch = 0;
+		auto dstBuf = static_cast<BYTE*>(dstResource->getSysMemBuffer(data.DstSubResourceIndex, dstPitch));
+		auto srcBuf = static_cast<const BYTE*>(srcResource->getSysMemBuffer(data.SrcSubResourceIndex, srcPitch));
+		if (!dstBuf || !srcBuf)
+		{
+			return false;
+		}
+
+		if (!dstResource->isOversized())
+		{
+			auto& dstLockData = dstResource->m_lockData[data.DstSubResourceIndex];
+			dstLockData.isVidMemUpToDate = false;
+			dstLockData.colorKeySpans.invalidate();
+		}
+
+		dstBuf += data.DstRect.top * dstPitch + data.DstRect.left * dstResource->m_formatInfo.bytesPerPixel;
+		srcBuf += data.SrcRect.top * srcPitch + data.SrcRect.left * srcResource->m_formatInfo.bytesPerPixel;
+		bltSysMem(dstBuf, dstPitch, dstResource->m_formatInfo, srcBuf, srcPitch, srcResource->m_formatInfo,
+			isSameFormat, data);
+		return true;
+	}
+
 	HRESULT Resource::splitBlt(D3DDDIARG_BLT& data, UINT& subResourceIndex, RECT& rect, RECT& otherRect)
 	{
 		LOG_FUNC("Resource::splitBlt", data, subResourceIndex, rect, otherRect);
@@ -557,6 +730,10 @@ namespace D3dDdi
 			data.Flags.MirrorUpDown ||
 			data.Flags.Rotate)
 		{
+			if (oversizedSysMemBlt(data))
+			{
+				return LOG_RESULT(S_OK);
+			}
 			LOG_ONCE("WARNING: Unsupported blt of oversized resource: " << data);
 			return LOG_RESULT(m_device.getOrigVtable().pfnBlt(m_device, &data));
 		}
@@ -609,7 +786,9 @@ namespace D3dDdi
 
 	HRESULT Resource::sysMemPreferredBlt(const D3DDDIARG_BLT& data, Resource& srcResource)
 	{
-		if (m_fixedData.Format == srcResource.m_fixedData.Format &&
+		const bool isSameFormat = m_fixedData.Format == srcResource.m_fixedData.Format;
+		if ((isSameFormat || DDraw::Blitter::isConvertBltSupported(m_formatInfo, srcResource.m_formatInfo)) &&
+			isSysMemBltSupported(data, isSameFormat) &&
 			!m_lockData.empty() &&
 			!srcResource.m_lockData.empty())
 		{
@@ -631,7 +810,17 @@ namespace D3dDdi
 
 			if (isSysMemBltPreferred)
 			{
+				m_device.getBltBatch().flush();
+				const bool isAsync = 0 != Config::maxAsyncBltQueueSize &&
+					(Config::asyncSysMemBlts || Device::isAsyncBltEnabled(m_handle));
+				if (!isAsync)
+				{
+					waitForAsyncBlt(data.DstSubResourceIndex);
+					srcResource.waitForAsyncBlt(data.SrcSubResourceIndex);
+				}
+
 				dstLockData.isVidMemUpToDate = false;
+				dstLockData.colorKeySpans.invalidate();
 				if (!srcLockData.isSysMemUpToDate)
 				{
 					srcResource.copyToSysMem(data.SrcSubResourceIndex);
@@ -640,27 +829,54 @@ namespace D3dDdi
 				auto dstBuf = static_cast<BYTE*>(dstLockData.data) +
 					data.DstRect.top * dstLockData.pitch + data.DstRect.left * m_formatInfo.bytesPerPixel;
 				auto srcBuf = static_cast<const BYTE*>(srcLockData.data) +
-					data.SrcRect.top * srcLockData.pitch + data.SrcRect.left * m_formatInfo.bytesPerPixel;
-
-				DDraw::Blitter::blt(
-					dstBuf,
-					dstLockData.pitch,
-					data.DstRect.right - data.DstRect.left,
-					data.DstRect.bottom - data.DstRect.top,
-					srcBuf,
-					srcLockData.pitch,
-					(1 - 2 * data.Flags.MirrorLeftRight) * (data.SrcRect.right - data.SrcRect.left),
-					(1 - 2 * data.Flags.MirrorUpDown) * (data.SrcRect.bottom - data.SrcRect.top),
-					m_formatInfo.bytesPerPixel,
-					data.Flags.DstColorKey ? reinterpret_cast<const DWORD*>(&data.ColorKey) : nullptr,
-					data.Flags.SrcColorKey ? reinterpret_cast<const DWORD*>(&data.ColorKey) : nullptr);
+					data.SrcRect.top * srcLockData.pitch + data.SrcRect.left * srcResource.m_formatInfo.bytesPerPixel;
+
+				const LONG dstWidth = data.DstRect.right - data.DstRect.left;
+				const LONG dstHeight = data.DstRect.bottom - data.DstRect.top;
+				const LONG srcWidth = data.SrcRect.right - data.SrcRect.left;
+				const LONG srcHeight = data.SrcRect.bottom - data.SrcRect.top;
+
+				if (!isAsync && isSameFormat &&
+					data.Flags.SrcColorKey && !data.Flags.DstColorKey &&
+					!data.Flags.MirrorLeftRight && !data.Flags.MirrorUpDown &&
+					dstWidth == srcWidth && dstHeight == srcHeight &&
+					srcResource.m_lockResource && 0 == srcLockData.lockCount && &srcLockData != &dstLockData &&
+					srcLockData.colorKeySpans.blt(dstBuf, dstLockData.pitch, srcLockData.data, srcLockData.pitch,
+						srcResource.m_fixedData.pSurfList[data.SrcSubResourceIndex].Width,
+						srcResource.m_fixedData.pSurfList[data.SrcSubResourceIndex].Height,
+						data.SrcRect, m_formatInfo.bytesPerPixel, data.ColorKey))
+				{
+					return S_OK;
+				}
 
+				auto blt = [=, dstPitch = dstLockData.pitch, srcPitch = srcLockData.pitch,
+					dstFormatInfo = m_formatInfo, srcFormatInfo = srcResource.m_formatInfo]()
+				{
+					bltSysMem(dstBuf, dstPitch, dstFormatInfo, srcBuf, srcPitch, srcFormatInfo, isSameFormat, data);
+				};
+
+				if (isAsync)
+				{
+					const UINT64 fence = BltQueue::enqueue(blt);
+					dstLockData.asyncBltFence = fence;
+					srcLockData.asyncBltFence = fence;
+				}
+				else
+				{
+					blt();
+				}
 				return S_OK;
 			}
 		}
 
+		waitForAsyncBlt(data.DstSubResourceIndex);
+		srcResource.waitForAsyncBlt(data.SrcSubResourceIndex);
 		prepareForRendering(data.DstSubResourceIndex, false);
 		srcResource.prepareForRendering(data.SrcSubResourceIndex, true);
+		if (m_device.getBltBatch().add(data, *this, srcResource))
+		{
+			return S_OK;
+		}
 		return m_device.getOrigVtable().pfnBlt(m_device, &data);
 	}
 
@@ -699,4 +915,21 @@ namespace D3dDdi
 
 		return m_device.getOrigVtable().pfnUnlock(m_device, &data);
 	}
+
+	void Resource::waitForAsyncBlt(UINT subResourceIndex)
+	{
+		if (subResourceIndex < m_lockData.size() && 0 != m_lockData[subResourceIndex].asyncBltFence)
+		{
+			BltQueue::wait(m_lockData[subResourceIndex].asyncBltFence);
+			m_lockData[subResourceIndex].asyncBltFence = 0;
+		}
+	}
+
+	void Resource::waitForAsyncBlts()
+	{
+		for (UINT i = 0; i < m_lockData.size(); ++i)
+		{
+			waitForAsyncBlt(i);
+		}
+	}
 }
@@ -7,6 +7,7 @@
 #include <d3dumddi.h>
 
 #include <D3dDdi/FormatInfo.h>
+#include <DDraw/ColorKeySpans.h>
 
 namespace D3dDdi
 {
@@ -30,11 +31,14 @@ namespace D3dDdi
 		HRESULT blt(D3DDDIARG_BLT data);
 		HRESULT colorFill(D3DDDIARG_COLORFILL data);
 		void endGdiAccess(bool isReadOnly);
+		const D3DDDIARG_CREATERESOURCE2& getFixedDesc() const { return m_fixedData; }
+		const FormatInfo& getFormatInfo() const { return m_formatInfo; }
 		void* getLockPtr(UINT subResourceIndex);
 		HRESULT lock(D3DDDIARG_LOCK& data);
 		void prepareForRendering(UINT subResourceIndex, bool isReadOnly);
 		void setAsGdiResource(bool isGdiResource);
 		HRESULT unlock(const D3DDDIARG_UNLOCK& data);
+		void waitForAsyncBlts();
 
 	private:
 		class Data : public D3DDDIARG_CREATERESOURCE2
@@ -59,8 +63,10 @@ namespace D3dDdi
 			UINT pitch;
 			UINT lockCount;
 			long long qpcLastForcedLock;
+			UINT64 asyncBltFence;
 			bool isSysMemUpToDate;
 			bool isVidMemUpToDate;
+			DDraw::ColorKeySpans colorKeySpans;
 		};
 
 		class ResourceDeleter
@@ -85,8 +91,10 @@ namespace D3dDdi
 		void createGdiLockResource();
 		void createLockResource();
 		void createSysMemResource(const std::vector<D3DDDI_SURFACEINFO>& surfaceInfo);
+		void* getSysMemBuffer(UINT subResourceIndex, UINT& pitch);
 		bool isOversized() const;
 		bool isValidRect(UINT subResourceIndex, const RECT& rect);
+		bool oversizedSysMemBlt(const D3DDDIARG_BLT& data);
 		HRESULT presentationBlt(const D3DDDIARG_BLT& data, Resource& srcResource);
 		HRESULT splitBlt(D3DDDIARG_BLT& data, UINT& subResourceIndex, RECT& rect, RECT& otherRect);
 
@@ -94,6 +102,7 @@ namespace D3dDdi
 		HRESULT splitLock(Arg& data, HRESULT(APIENTRY *lockFunc)(HANDLE, Arg*));
 
 		HRESULT sysMemPreferredBlt(const D3DDDIARG_BLT& data, Resource& srcResource);
+		void waitForAsyncBlt(UINT subResourceIndex);
 
 		Device& m_device;
 		HANDLE m_handle;
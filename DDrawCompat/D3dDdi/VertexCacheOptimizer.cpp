@@ -0,0 +1,234 @@
+#include <algorithm>
+#include <array>
+#include <climits>
+#include <cmath>
+
+#include <D3dDdi/VertexCacheOptimizer.h>
+
+namespace
+{
+	// Post-transform cache models: FIFO for the ACMR statistic, LRU for the Forsyth scoring
+	const UINT FIFO_CACHE_SIZE = 16;
+	const UINT LRU_CACHE_SIZE = 32;
+	const UINT MAX_VALENCE = 64;
+
+	const float CACHE_DECAY_POWER = 1.5f;
+	const float LAST_TRIANGLE_SCORE = 0.75f;
+	const float VALENCE_BOOST_SCALE = 2.0f;
+	const float VALENCE_BOOST_POWER = 0.5f;
+
+	float getVertexScore(INT cachePos, UINT remainingTriangles)
+	{
+		static const auto cacheScores = []()
+		{
+			std::array<float, LRU_CACHE_SIZE> scores = {};
+			for (UINT i = 0; i < LRU_CACHE_SIZE; ++i)
+			{
+				scores[i] = i < 3 ? LAST_TRIANGLE_SCORE
+					: std::pow(1.0f - (i - 3) / static_cast<float>(LRU_CACHE_SIZE - 3), CACHE_DECAY_POWER);
+			}
+			return scores;
+		}();
+
+		static const auto valenceScores = []()
+		{
+			std::array<float, MAX_VALENCE + 1> scores = {};
+			for (UINT i = 1; i <= MAX_VALENCE; ++i)
+			{
+				scores[i] = VALENCE_BOOST_SCALE * std::pow(static_cast<float>(i), -VALENCE_BOOST_POWER);
+			}
+			return scores;
+		}();
+
+		if (0 == remainingTriangles)
+		{
+			return -1.0f;
+		}
+
+		float score = valenceScores[std::min<UINT>(remainingTriangles, MAX_VALENCE)];
+		if (cachePos >= 0)
+		{
+			score += cacheScores[cachePos];
+		}
+		return score;
+	}
+}
+
+namespace D3dDdi
+{
+	UINT VertexCacheOptimizer::getCacheMissCount(const UINT* indices, UINT count)
+	{
+		std::array<UINT, FIFO_CACHE_SIZE> cache;
+		cache.fill(UINT_MAX);
+		UINT nextEntry = 0;
+		UINT missCount = 0;
+
+		for (UINT i = 0; i < count; ++i)
+		{
+			if (std::find(cache.begin(), cache.end(), indices[i]) == cache.end())
+			{
+				cache[nextEntry] = indices[i];
+				nextEntry = (nextEntry + 1) % FIFO_CACHE_SIZE;
+				++missCount;
+			}
+		}
+		return missCount;
+	}
+
+	void VertexCacheOptimizer::optimizeTriangleOrder(UINT* indices, UINT count)
+	{
+		const UINT triangleCount = count / 3;
+		if (triangleCount < 2)
+		{
+			return;
+		}
+
+		const auto [min, max] = std::minmax_element(indices, indices + triangleCount * 3);
+		const UINT minIndex = *min;
+		m_vertices.assign(*max - minIndex + 1, { 0, 0, -1, 0.0f });
+
+		for (UINT i = 0; i < triangleCount * 3; ++i)
+		{
+			++m_vertices[indices[i] - minIndex].remainingTriangles;
+		}
+
+		UINT triangleOffset = 0;
+		for (auto& vertex : m_vertices)
+		{
+			vertex.triangleOffset = triangleOffset;
+			triangleOffset += vertex.remainingTriangles;
+			vertex.score = getVertexScore(-1, vertex.remainingTriangles);
+			vertex.remainingTriangles = 0;
+		}
+
+		m_vertexTriangles.resize(triangleCount * 3);
+		for (UINT i = 0; i < triangleCount * 3; ++i)
+		{
+			auto& vertex = m_vertices[indices[i] - minIndex];
+			m_vertexTriangles[vertex.triangleOffset + vertex.remainingTriangles] = i / 3;
+			++vertex.remainingTriangles;
+		}
+
+		m_triangleScores.resize(triangleCount);
+		m_isTriangleAdded.assign(triangleCount, false);
+		UINT bestTriangle = 0;
+		for (UINT t = 0; t < triangleCount; ++t)
+		{
+			m_triangleScores[t] = m_vertices[indices[t * 3] - minIndex].score +
+				m_vertices[indices[t * 3 + 1] - minIndex].score +
+				m_vertices[indices[t * 3 + 2] - minIndex].score;
+			if (m_triangleScores[t] > m_triangleScores[bestTriangle])
+			{
+				bestTriangle = t;
+			}
+		}
+
+		std::array<UINT, LRU_CACHE_SIZE + 3> cache = {};
+		std::array<UINT, LRU_CACHE_SIZE + 3> newCache = {};
+		UINT cacheSize = 0;
+		UINT scanPos = 0;
+		m_optimizedIndices.clear();
+
+		for (UINT added = 0; added < triangleCount; ++added)
+		{
+			if (UINT_MAX == bestTriangle)
+			{
+				while (m_isTriangleAdded[scanPos])
+				{
+					++scanPos;
+				}
+				bestTriangle = scanPos;
+			}
+
+			m_isTriangleAdded[bestTriangle] = true;
+			UINT newCacheSize = 0;
+			for (UINT i = 0; i < 3; ++i)
+			{
+				const UINT v = indices[bestTriangle * 3 + i] - minIndex;
+				m_optimizedIndices.push_back(indices[bestTriangle * 3 + i]);
+
+				auto& vertex = m_vertices[v];
+				auto triangles = m_vertexTriangles.begin() + vertex.triangleOffset;
+				auto it = std::find(triangles, triangles + vertex.remainingTriangles, bestTriangle);
+				if (it != triangles + vertex.remainingTriangles)
+				{
+					std::iter_swap(it, triangles + vertex.remainingTriangles - 1);
+					--vertex.remainingTriangles;
+				}
+
+				if (std::find(newCache.begin(), newCache.begin() + newCacheSize, v) == newCache.begin() + newCacheSize)
+				{
+					newCache[newCacheSize++] = v;
+				}
+			}
+
+			for (UINT i = 0; i < cacheSize; ++i)
+			{
+				if (std::find(newCache.begin(), newCache.begin() + newCacheSize, cache[i]) ==
+					newCache.begin() + newCacheSize)
+				{
+					newCache[newCacheSize++] = cache[i];
+				}
+			}
+
+			for (UINT i = 0; i < newCacheSize; ++i)
+			{
+				auto& vertex = m_vertices[newCache[i]];
+				vertex.cachePos = i < LRU_CACHE_SIZE ? static_cast<INT>(i) : -1;
+				vertex.score = getVertexScore(vertex.cachePos, vertex.remainingTriangles);
+			}
+
+			bestTriangle = UINT_MAX;
+			float bestScore = -1.0f;
+			for (UINT i = 0; i < newCacheSize; ++i)
+			{
+				const auto& vertex = m_vertices[newCache[i]];
+				for (UINT j = 0; j < vertex.remainingTriangles; ++j)
+				{
+					const UINT t = m_vertexTriangles[vertex.triangleOffset + j];
+					m_triangleScores[t] = m_vertices[indices[t * 3] - minIndex].score +
+						m_vertices[indices[t * 3 + 1] - minIndex].score +
+						m_vertices[indices[t * 3 + 2] - minIndex].score;
+					if (m_triangleScores[t] > bestScore)
+					{
+						bestScore = m_triangleScores[t];
+						bestTriangle = t;
+					}
+				}
+			}
+
+			cacheSize = std::min<UINT>(newCacheSize, LRU_CACHE_SIZE);
+			std::copy(newCache.begin(), newCache.begin() + cacheSize, cache.begin());
+		}
+
+		std::copy(m_optimizedIndices.begin(), m_optimizedIndices.end(), indices);
+	}
+
+	void VertexCacheOptimizer::optimizeVertexOrder(UINT* indices, UINT count, std::vector<BYTE>& vertices, UINT stride)
+	{
+		const UINT vertexCount = vertices.size() / stride;
+		m_vertexRemap.assign(vertexCount, UINT_MAX);
+		UINT nextVertex = 0;
+		for (UINT i = 0; i < count; ++i)
+		{
+			UINT& newIndex = m_vertexRemap[indices[i]];
+			if (UINT_MAX == newIndex)
+			{
+				newIndex = nextVertex++;
+			}
+			indices[i] = newIndex;
+		}
+
+		m_optimizedVertices.resize(vertices.size());
+		for (UINT i = 0; i < vertexCount; ++i)
+		{
+			if (UINT_MAX == m_vertexRemap[i])
+			{
+				m_vertexRemap[i] = nextVertex++;
+			}
+			memcpy(m_optimizedVertices.data() + m_vertexRemap[i] * stride, vertices.data() + i * stride, stride);
+		}
+
+		vertices.swap(m_optimizedVertices);
+	}
+}
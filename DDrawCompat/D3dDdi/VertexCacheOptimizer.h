@@ -0,0 +1,34 @@
+#pragma once
+
+#include <vector>
+
+#include <Windows.h>
+
+namespace D3dDdi
+{
+	class VertexCacheOptimizer
+	{
+	public:
+		static UINT getCacheMissCount(const UINT* indices, UINT count);
+
+		void optimizeTriangleOrder(UINT* indices, UINT count);
+		void optimizeVertexOrder(UINT* indices, UINT count, std::vector<BYTE>& vertices, UINT stride);
+
+	private:
+		struct Vertex
+		{
+			UINT triangleOffset;
+			UINT remainingTriangles;
+			INT cachePos;
+			float score;
+		};
+
+		std::vector<Vertex> m_vertices;
+		std::vector<UINT> m_vertexTriangles;
+		std::vector<float> m_triangleScores;
+		std::vector<bool> m_isTriangleAdded;
+		std::vector<UINT> m_optimizedIndices;
+		std::vector<UINT> m_vertexRemap;
+		std::vector<BYTE> m_optimizedVertices;
+	};
+}
@@ -1,18 +1,21 @@
+﻿#include <algorithm>
 #include <array>
+#include <cmath>
+#include <functional>
 #include <type_traits>
 #include <vector>
 
 #include <intrin.h>
 
-#include "Common/ScopedCriticalSection.h"
+#include "Config/Config.h"
+#include "D3dDdi/FormatInfo.h"
 #include "DDraw/Blitter.h"
+#include "Win32/Thread.h"
 
 #pragma warning(disable : 4127)
 
 namespace
 {
-	Compat::CriticalSection g_overlappingBltCs;
-
 #pragma pack(1)
 	class UInt24
 	{
@@ -46,7 +49,7 @@ namespace
 
 	void blt(BYTE* dst, DWORD dstPitch, DWORD dstWidth, DWORD dstHeight,
 		const BYTE* src, DWORD srcPitch, LONG srcWidth, LONG srcHeight,
-		DWORD bytesPerPixel, const DWORD* dstColorKey, const DWORD* srcColorKey);
+		DWORD bytesPerPixel, const DDCOLORKEY* dstColorKey, const DDCOLORKEY* srcColorKey);
 
 	template <int n> __m128i _mm_cmpeq_epi(__m128i a, __m128i b);
 	template <> __m128i _mm_cmpeq_epi<8>(__m128i a, __m128i b) { return _mm_cmpeq_epi8(a, b); }
@@ -72,6 +75,164 @@ namespace
 	template <> void _mm_storeu_si<64>(void* p, __m128i a) { _mm_storel_epi64(static_cast<__m128i*>(p), a); }
 	template <> void _mm_storeu_si<128>(void* p, __m128i a) { _mm_storeu_si128(static_cast<__m128i*>(p), a); }
 
+	template <typename Pixel>
+	__m128i getLaneReverseShuffleMask()
+	{
+		if (4 == sizeof(Pixel))
+		{
+			return _mm_setr_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
+		}
+		if (2 == sizeof(Pixel))
+		{
+			return _mm_setr_epi8(14, 15, 12, 13, 10, 11, 8, 9, 6, 7, 4, 5, 2, 3, 0, 1);
+		}
+		return _mm_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+	}
+
+	struct Sse2
+	{
+	};
+
+	struct Ssse3
+	{
+	};
+
+	struct Avx2
+	{
+		typedef __m256i Vector;
+		typedef __m256i Mask;
+
+		static Vector load(const void* p) { return _mm256_loadu_si256(static_cast<const __m256i*>(p)); }
+		static void store(void* p, Vector a) { _mm256_storeu_si256(static_cast<__m256i*>(p), a); }
+
+		static Vector gather(const DWORD* src, int& offset, int delta)
+		{
+			__m256i offsets = _mm256_mullo_epi32(_mm256_set1_epi32(delta), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+			offsets = _mm256_add_epi32(offsets, _mm256_set1_epi32(offset));
+			offset += 8 * delta;
+			return _mm256_i32gather_epi32(reinterpret_cast<const int*>(src), _mm256_srai_epi32(offsets, 16), 4);
+		}
+
+		template <typename Pixel, bool useColorKeyRange>
+		static Mask compareColorKey(Vector vec, const DDCOLORKEY& colorKey)
+		{
+			const DWORD low = colorKey.dwColorSpaceLowValue;
+			const DWORD high = colorKey.dwColorSpaceHighValue;
+			if (useColorKeyRange)
+			{
+				switch (sizeof(Pixel))
+				{
+				case 1: return _mm256_cmpeq_epi8(_mm256_setzero_si256(), _mm256_or_si256(
+					_mm256_subs_epu8(_mm256_set1_epi8(static_cast<char>(low)), vec),
+					_mm256_subs_epu8(vec, _mm256_set1_epi8(static_cast<char>(high)))));
+				case 2: return _mm256_cmpeq_epi16(_mm256_setzero_si256(), _mm256_or_si256(
+					_mm256_subs_epu16(_mm256_set1_epi16(static_cast<short>(low)), vec),
+					_mm256_subs_epu16(vec, _mm256_set1_epi16(static_cast<short>(high)))));
+				default: return _mm256_cmpeq_epi32(_mm256_setzero_si256(), _mm256_and_si256(_mm256_or_si256(
+					_mm256_subs_epu8(_mm256_set1_epi32(low), vec),
+					_mm256_subs_epu8(vec, _mm256_set1_epi32(high))), _mm256_set1_epi32(0x00FFFFFF)));
+				}
+			}
+
+			switch (sizeof(Pixel))
+			{
+			case 1: return _mm256_cmpeq_epi8(vec, _mm256_set1_epi8(static_cast<char>(low)));
+			case 2: return _mm256_cmpeq_epi16(vec, _mm256_set1_epi16(static_cast<short>(low)));
+			default: return _mm256_cmpeq_epi32(_mm256_and_si256(vec, _mm256_set1_epi32(0x00FFFFFF)),
+				_mm256_set1_epi32(low));
+			}
+		}
+
+		static Mask maskAndNot(Mask a, Mask b) { return _mm256_andnot_si256(a, b); }
+
+		template <typename Pixel>
+		static Vector reverse(Vector vec)
+		{
+			if (4 == sizeof(Pixel))
+			{
+				return _mm256_permutevar8x32_epi32(vec, _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0));
+			}
+			vec = _mm256_shuffle_epi8(vec, _mm256_broadcastsi128_si256(getLaneReverseShuffleMask<Pixel>()));
+			return _mm256_permute4x64_epi64(vec, _MM_SHUFFLE(1, 0, 3, 2));
+		}
+
+		template <typename Pixel>
+		static Vector select(Mask mask, Vector a, Vector b) { return _mm256_blendv_epi8(b, a, mask); }
+	};
+
+	struct Avx512
+	{
+		typedef __m512i Vector;
+		typedef __mmask64 Mask;
+
+		static Vector load(const void* p) { return _mm512_loadu_si512(p); }
+		static void store(void* p, Vector a) { _mm512_storeu_si512(p, a); }
+
+		static Vector gather(const DWORD* src, int& offset, int delta)
+		{
+			__m512i offsets = _mm512_mullo_epi32(_mm512_set1_epi32(delta),
+				_mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+			offsets = _mm512_add_epi32(offsets, _mm512_set1_epi32(offset));
+			offset += 16 * delta;
+			return _mm512_i32gather_epi32(_mm512_srai_epi32(offsets, 16), src, 4);
+		}
+
+		template <typename Pixel, bool useColorKeyRange>
+		static Mask compareColorKey(Vector vec, const DDCOLORKEY& colorKey)
+		{
+			const DWORD low = colorKey.dwColorSpaceLowValue;
+			const DWORD high = colorKey.dwColorSpaceHighValue;
+			if (useColorKeyRange)
+			{
+				switch (sizeof(Pixel))
+				{
+				case 1: return _mm512_testn_epi8_mask(_mm512_set1_epi8(-1), _mm512_or_si512(
+					_mm512_subs_epu8(_mm512_set1_epi8(static_cast<char>(low)), vec),
+					_mm512_subs_epu8(vec, _mm512_set1_epi8(static_cast<char>(high)))));
+				case 2: return _mm512_testn_epi16_mask(_mm512_set1_epi16(-1), _mm512_or_si512(
+					_mm512_subs_epu16(_mm512_set1_epi16(static_cast<short>(low)), vec),
+					_mm512_subs_epu16(vec, _mm512_set1_epi16(static_cast<short>(high)))));
+				default: return _mm512_testn_epi32_mask(_mm512_set1_epi32(0x00FFFFFF), _mm512_or_si512(
+					_mm512_subs_epu8(_mm512_set1_epi32(low), vec),
+					_mm512_subs_epu8(vec, _mm512_set1_epi32(high))));
+				}
+			}
+
+			switch (sizeof(Pixel))
+			{
+			case 1: return _mm512_cmpeq_epi8_mask(vec, _mm512_set1_epi8(static_cast<char>(low)));
+			case 2: return _mm512_cmpeq_epi16_mask(vec, _mm512_set1_epi16(static_cast<short>(low)));
+			default: return _mm512_cmpeq_epi32_mask(_mm512_and_si512(vec, _mm512_set1_epi32(0x00FFFFFF)),
+				_mm512_set1_epi32(low));
+			}
+		}
+
+		static Mask maskAndNot(Mask a, Mask b) { return ~a & b; }
+
+		template <typename Pixel>
+		static Vector reverse(Vector vec)
+		{
+			if (4 == sizeof(Pixel))
+			{
+				return _mm512_permutexvar_epi32(
+					_mm512_setr_epi32(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0), vec);
+			}
+			vec = _mm512_shuffle_epi8(vec, _mm512_broadcast_i32x4(getLaneReverseShuffleMask<Pixel>()));
+			return _mm512_shuffle_i64x2(vec, vec, _MM_SHUFFLE(0, 1, 2, 3));
+		}
+
+		template <typename Pixel>
+		static Vector select(Mask mask, Vector a, Vector b)
+		{
+			switch (sizeof(Pixel))
+			{
+			case 1: return _mm512_mask_blend_epi8(mask, b, a);
+			case 2: return _mm512_mask_blend_epi16(static_cast<__mmask32>(mask), b, a);
+			default: return _mm512_mask_blend_epi32(static_cast<__mmask16>(mask), b, a);
+			}
+		}
+	};
+
 	template <typename Pixel, int vectorSize>
 	__forceinline __m128i reverseVector(__m128i vec)
 	{
@@ -104,17 +265,6 @@ namespace
 		return vec;
 	}
 
-	template <int pixelsPerVector, int count>
-	__forceinline void loadSrcVectorRemainder(__m128i& vec1, __m128i& vec2,
-		const BYTE*& src, int& offset, int delta, std::integral_constant<int, count>)
-	{
-		vec1 = _mm_insert_epi16(vec1, *(src + (offset >> 16)), (pixelsPerVector - count) / 2);
-		offset += delta;
-		vec2 = _mm_insert_epi16(vec2, *(src + (offset >> 16)), (pixelsPerVector - count) / 2);
-		offset += delta;
-		loadSrcVectorRemainder<pixelsPerVector>(vec1, vec2, src, offset, delta, std::integral_constant<int, count - 2>());
-	}
-
 	template <int pixelsPerVector>
 	__forceinline void loadSrcVectorRemainder(__m128i& vec1, __m128i& vec2,
 		const BYTE*& src, int& offset, int delta, std::integral_constant<int, 1> /*count*/)
@@ -135,6 +285,17 @@ namespace
 	{
 	}
 
+	template <int pixelsPerVector, int count>
+	__forceinline void loadSrcVectorRemainder(__m128i& vec1, __m128i& vec2,
+		const BYTE*& src, int& offset, int delta, std::integral_constant<int, count>)
+	{
+		vec1 = _mm_insert_epi16(vec1, *(src + (offset >> 16)), (pixelsPerVector - count) / 2);
+		offset += delta;
+		vec2 = _mm_insert_epi16(vec2, *(src + (offset >> 16)), (pixelsPerVector - count) / 2);
+		offset += delta;
+		loadSrcVectorRemainder<pixelsPerVector>(vec1, vec2, src, offset, delta, std::integral_constant<int, count - 2>());
+	}
+
 	template <int pixelsPerVector, int count>
 	__forceinline void loadSrcVectorRemainder(__m128i& vec,
 		const BYTE* src, int& offset, int delta, std::integral_constant<int, count>)
@@ -146,6 +307,12 @@ namespace
 		vec = _mm_or_si128(vec, vec2);
 	}
 
+	template <int pixelsPerVector>
+	__forceinline void loadSrcVectorRemainder(__m128i& /*vec*/,
+		const WORD* /*src*/, int& /*offset*/, int /*delta*/, std::integral_constant<int, 0> /*count*/)
+	{
+	}
+
 	template <int pixelsPerVector, int count>
 	__forceinline typename std::enable_if<0 != count>::type loadSrcVectorRemainder(__m128i& vec,
 		const WORD* src, int& offset, int delta, std::integral_constant<int, count>)
@@ -157,7 +324,7 @@ namespace
 
 	template <int pixelsPerVector>
 	__forceinline void loadSrcVectorRemainder(__m128i& /*vec*/,
-		const WORD* /*src*/, int& /*offset*/, int /*delta*/, std::integral_constant<int, 0> /*count*/)
+		const DWORD* /*src*/, int& /*offset*/, int /*delta*/, std::integral_constant<int, 0> /*count*/)
 	{
 	}
 
@@ -172,12 +339,6 @@ namespace
 		loadSrcVectorRemainder<pixelsPerVector>(vec, src, offset, delta, std::integral_constant<int, count - 1>());
 	}
 
-	template <int pixelsPerVector>
-	__forceinline void loadSrcVectorRemainder(__m128i& /*vec*/,
-		const DWORD* /*src*/, int& /*offset*/, int /*delta*/, std::integral_constant<int, 0> /*count*/)
-	{
-	}
-
 	template <int vectorSize, bool stretch, bool mirror, typename Pixel>
 	__forceinline __m128i loadSrcVector(const Pixel*& src, int& offset, int delta)
 	{
@@ -205,10 +366,26 @@ namespace
 		return vec;
 	}
 
-	template <typename Pixel>
-	__forceinline __m128i compareColorKey(__m128i vec, DWORD colorKey)
+	template <typename Pixel, bool useColorKeyRange>
+	__forceinline __m128i compareColorKey(__m128i vec, const DDCOLORKEY& colorKey)
 	{
-		__m128i colorKeyVec = _mm_set1_epi<sizeof(Pixel) * 8>(colorKey);
+		if (useColorKeyRange)
+		{
+			// Channels are in range when neither saturating difference against the range bounds is nonzero
+			const __m128i low = _mm_set1_epi<sizeof(Pixel) * 8>(colorKey.dwColorSpaceLowValue);
+			const __m128i high = _mm_set1_epi<sizeof(Pixel) * 8>(colorKey.dwColorSpaceHighValue);
+			// 16bpp pixels are compared as a whole, so colorKeyRangeBlt only accepts 16bpp ranges with equal bounds
+			__m128i outside = 2 == sizeof(Pixel)
+				? _mm_or_si128(_mm_subs_epu16(low, vec), _mm_subs_epu16(vec, high))
+				: _mm_or_si128(_mm_subs_epu8(low, vec), _mm_subs_epu8(vec, high));
+			if (4 == sizeof(Pixel))
+			{
+				outside = _mm_and_si128(outside, _mm_set1_epi32(0x00FFFFFF));
+			}
+			return _mm_cmpeq_epi<sizeof(Pixel) * 8>(outside, _mm_setzero_si128());
+		}
+
+		__m128i colorKeyVec = _mm_set1_epi<sizeof(Pixel) * 8>(colorKey.dwColorSpaceLowValue);
 		if (4 == sizeof(Pixel))
 		{
 			__m128i colorKeyMask = _mm_set1_epi<sizeof(Pixel) * 8>(0x00FFFFFF);
@@ -217,13 +394,13 @@ namespace
 		return _mm_cmpeq_epi<sizeof(Pixel) * 8>(vec, colorKeyVec);
 	}
 
-	template <typename Pixel, bool mirror, bool useDstColorKey, bool useSrcColorKey>
-	__forceinline __m128i bltVector(__m128i dst, __m128i src, DWORD dstColorKey, DWORD srcColorKey)
+	template <typename Pixel, bool mirror, bool useDstColorKey, bool useSrcColorKey, bool useColorKeyRange>
+	__forceinline __m128i bltVector(__m128i dst, __m128i src, const DDCOLORKEY& dstColorKey, const DDCOLORKEY& srcColorKey)
 	{
 		if (useDstColorKey && useSrcColorKey)
 		{
-			__m128i maskDst = compareColorKey<Pixel>(dst, dstColorKey);
-			__m128i maskSrc = compareColorKey<Pixel>(src, srcColorKey);
+			__m128i maskDst = compareColorKey<Pixel, useColorKeyRange>(dst, dstColorKey);
+			__m128i maskSrc = compareColorKey<Pixel, useColorKeyRange>(src, srcColorKey);
 			__m128i mask = _mm_andnot_si128(maskSrc, maskDst);
 			dst = _mm_andnot_si128(mask, dst);
 			src = _mm_and_si128(mask, src);
@@ -231,14 +408,14 @@ namespace
 		}
 		else if (useDstColorKey)
 		{
-			__m128i mask = compareColorKey<Pixel>(dst, dstColorKey);
+			__m128i mask = compareColorKey<Pixel, useColorKeyRange>(dst, dstColorKey);
 			dst = _mm_andnot_si128(mask, dst);
 			src = _mm_and_si128(mask, src);
 			return _mm_or_si128(dst, src);
 		}
 		else if (useSrcColorKey)
 		{
-			__m128i mask = compareColorKey<Pixel>(src, srcColorKey);
+			__m128i mask = compareColorKey<Pixel, useColorKeyRange>(src, srcColorKey);
 			dst = _mm_and_si128(mask, dst);
 			src = _mm_andnot_si128(mask, src);
 			return _mm_or_si128(dst, src);
@@ -249,28 +426,97 @@ namespace
 		}
 	}
 
-	template <typename Pixel, int vectorSize, bool stretch, bool mirror, bool useDstColorKey, bool useSrcColorKey>
+	template <typename Pixel, int vectorSize, bool stretch, bool mirror, bool useDstColorKey, bool useSrcColorKey, bool useColorKeyRange>
 	__forceinline void bltVector(Pixel*& dst, const Pixel*& src, int& offset, int delta,
-		DWORD dstColorKey, DWORD srcColorKey)
+		const DDCOLORKEY& dstColorKey, const DDCOLORKEY& srcColorKey)
 	{
 		__m128i s = loadSrcVector<vectorSize, stretch, mirror>(src, offset, delta);
 		__m128i d = _mm_loadu_si<vectorSize * 8>(dst);
-		d = bltVector<Pixel, mirror, useDstColorKey, useSrcColorKey>(d, s, dstColorKey, srcColorKey);
+		d = bltVector<Pixel, mirror, useDstColorKey, useSrcColorKey, useColorKeyRange>(d, s, dstColorKey, srcColorKey);
 		_mm_storeu_si<vectorSize * 8>(dst, d);
 		dst += vectorSize / sizeof(Pixel);
 	}
 
-	template <int vectorSize, bool stretch, bool mirror, bool useDstColorKey, bool useSrcColorKey, typename Pixel>
+	template <typename Isa, typename Pixel, bool useDstColorKey, bool useSrcColorKey, bool useColorKeyRange>
+	__forceinline typename Isa::Vector bltWideVector(typename Isa::Vector dst, typename Isa::Vector src,
+		const DDCOLORKEY& dstColorKey, const DDCOLORKEY& srcColorKey)
+	{
+		if (useDstColorKey && useSrcColorKey)
+		{
+			auto mask = Isa::maskAndNot(Isa::template compareColorKey<Pixel, useColorKeyRange>(src, srcColorKey),
+				Isa::template compareColorKey<Pixel, useColorKeyRange>(dst, dstColorKey));
+			return Isa::template select<Pixel>(mask, src, dst);
+		}
+		else if (useDstColorKey)
+		{
+			return Isa::template select<Pixel>(Isa::template compareColorKey<Pixel, useColorKeyRange>(dst, dstColorKey), src, dst);
+		}
+		else if (useSrcColorKey)
+		{
+			return Isa::template select<Pixel>(Isa::template compareColorKey<Pixel, useColorKeyRange>(src, srcColorKey), dst, src);
+		}
+		else
+		{
+			return src;
+		}
+	}
+
+	template <typename Isa, bool stretch, bool mirror, bool useDstColorKey, bool useSrcColorKey, bool useColorKeyRange, typename Pixel>
+	__forceinline void bltWideVectors(Pixel*& dst, const Pixel*& src, DWORD& width, int& offset, int delta,
+		const DDCOLORKEY& dstColorKey, const DDCOLORKEY& srcColorKey)
+	{
+		if constexpr (!std::is_same_v<Isa, Sse2> && (!stretch || 4 == sizeof(Pixel)))
+		{
+			const int pixelsPerVector = sizeof(typename Isa::Vector) / sizeof(Pixel);
+			const int pixelsPerSseVector = 16 / sizeof(Pixel);
+
+			const DWORD count = (width - pixelsPerSseVector) / pixelsPerVector;
+			if (0 == count)
+			{
+				return;
+			}
+
+			for (DWORD i = count; i != 0; --i)
+			{
+				typename Isa::Vector s = {};
+				if (stretch)
+				{
+					s = Isa::gather(reinterpret_cast<const DWORD*>(src), offset, delta);
+				}
+				else if (mirror)
+				{
+					s = Isa::template reverse<Pixel>(Isa::load(src - (pixelsPerVector - pixelsPerSseVector)));
+					src -= pixelsPerVector;
+				}
+				else
+				{
+					s = Isa::load(src);
+					src += pixelsPerVector;
+				}
+				Isa::store(dst, bltWideVector<Isa, Pixel, useDstColorKey, useSrcColorKey, useColorKeyRange>(
+					Isa::load(dst), s, dstColorKey, srcColorKey));
+				dst += pixelsPerVector;
+			}
+
+			width -= count * pixelsPerVector;
+			_mm256_zeroupper();
+		}
+	}
+
+	template <typename Isa, int vectorSize, bool stretch, bool mirror, bool useDstColorKey, bool useSrcColorKey, bool useColorKeyRange,
+		typename Pixel>
 	__forceinline void bltVectorRow(Pixel* dst, const Pixel* src, DWORD width, int offset, int delta,
-		DWORD dstColorKey, DWORD srcColorKey)
+		const DDCOLORKEY& dstColorKey, const DDCOLORKEY& srcColorKey)
 	{
 		const int pixelsPerVector = vectorSize / sizeof(Pixel);
 
 		if (16 == vectorSize)
 		{
+			bltWideVectors<Isa, stretch, mirror, useDstColorKey, useSrcColorKey, useColorKeyRange>(
+				dst, src, width, offset, delta, dstColorKey, srcColorKey);
 			for (DWORD i = width / pixelsPerVector - 1; i != 0; --i)
 			{
-				bltVector<Pixel, 16, stretch, mirror, useDstColorKey, useSrcColorKey>(
+				bltVector<Pixel, 16, stretch, mirror, useDstColorKey, useSrcColorKey, useColorKeyRange>(
 					dst, src, offset, delta, dstColorKey, srcColorKey);
 			}
 		}
@@ -296,21 +542,40 @@ namespace
 			__m128i s2 = loadSrcVector<vectorSize, stretch, mirror>(src, offset, delta);
 			__m128i d1 = _mm_loadu_si<vectorSize * 8>(dst);
 			__m128i d2 = _mm_loadu_si<vectorSize * 8>(dst + remainder);
-			d1 = bltVector<Pixel, mirror, useDstColorKey, useSrcColorKey>(d1, s1, dstColorKey, srcColorKey);
+			d1 = bltVector<Pixel, mirror, useDstColorKey, useSrcColorKey, useColorKeyRange>(d1, s1, dstColorKey, srcColorKey);
 			_mm_storeu_si<vectorSize * 8>(dst, d1);
-			d2 = bltVector<Pixel, mirror, useDstColorKey, useSrcColorKey>(d2, s2, dstColorKey, srcColorKey);
+			d2 = bltVector<Pixel, mirror, useDstColorKey, useSrcColorKey, useColorKeyRange>(d2, s2, dstColorKey, srcColorKey);
 			_mm_storeu_si<vectorSize * 8>(dst + remainder, d2);
 		}
 		else
 		{
-			bltVector<Pixel, vectorSize, stretch, mirror, useDstColorKey, useSrcColorKey>(
+			bltVector<Pixel, vectorSize, stretch, mirror, useDstColorKey, useSrcColorKey, useColorKeyRange>(
 				dst, src, offset, delta, dstColorKey, srcColorKey);
 		}
 	}
 
-	template <bool stretch, bool mirror, bool useDstColorKey, bool useSrcColorKey>
+	template <bool useColorKeyRange>
+	__forceinline bool isColorKeyMatch(DWORD pixel, const DDCOLORKEY& colorKey)
+	{
+		if (useColorKeyRange)
+		{
+			for (int shift = 0; shift < 24; shift += 8)
+			{
+				const BYTE channel = static_cast<BYTE>(pixel >> shift);
+				if (channel < static_cast<BYTE>(colorKey.dwColorSpaceLowValue >> shift) ||
+					channel > static_cast<BYTE>(colorKey.dwColorSpaceHighValue >> shift))
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+		return pixel == colorKey.dwColorSpaceLowValue;
+	}
+
+	template <bool stretch, bool mirror, bool useDstColorKey, bool useSrcColorKey, bool useColorKeyRange>
 	__forceinline void bltPixel(UInt24*& dst, const UInt24*& src, int& offset, int delta,
-		DWORD dstColorKey, DWORD srcColorKey)
+		const DDCOLORKEY& dstColorKey, const DDCOLORKEY& srcColorKey)
 	{
 		const UInt24* src1 = stretch ? src + (offset >> 16) : src;
 		if (useDstColorKey || useSrcColorKey)
@@ -318,8 +583,8 @@ namespace
 			const DWORD d = *reinterpret_cast<const WORD*>(dst) | (reinterpret_cast<const BYTE*>(dst)[2] << 16);
 			const DWORD s = *reinterpret_cast<const WORD*>(src1) | (reinterpret_cast<const BYTE*>(src1)[2] << 16);
 			const DWORD mask = static_cast<DWORD>(-static_cast<int>(
-				(!useDstColorKey || dstColorKey == d) &&
-				(!useSrcColorKey || srcColorKey != s)));
+				(!useDstColorKey || isColorKeyMatch<useColorKeyRange>(d, dstColorKey)) &&
+				(!useSrcColorKey || !isColorKeyMatch<useColorKeyRange>(s, srcColorKey))));
 			*dst = (d & ~mask) | (s & mask);
 		}
 		else
@@ -338,13 +603,78 @@ namespace
 		}
 	}
 
-	template <int vectorSize, bool stretch, bool mirror, bool useDstColorKey, bool useSrcColorKey>
+	template <bool mirror>
+	__forceinline __m128i getUInt24UnpackShuffleMask()
+	{
+		if (mirror)
+		{
+			return _mm_setr_epi8(13, 14, 15, -1, 10, 11, 12, -1, 7, 8, 9, -1, 4, 5, 6, -1);
+		}
+		return _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+	}
+
+	__forceinline __m128i getUInt24PackShuffleMask()
+	{
+		return _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+	}
+
+	template <bool mirror>
+	__forceinline const BYTE* getUInt24VectorSrc(const UInt24* src)
+	{
+		return mirror ? reinterpret_cast<const BYTE*>(src + 1) - 16 : reinterpret_cast<const BYTE*>(src);
+	}
+
+	template <bool mirror, bool useDstColorKey, bool useSrcColorKey, bool useColorKeyRange>
+	__forceinline void bltUInt24Vector(UInt24*& dst, const UInt24*& src, const DDCOLORKEY& dstColorKey, const DDCOLORKEY& srcColorKey)
+	{
+		const __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst));
+		const __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(getUInt24VectorSrc<mirror>(src)));
+		__m128i result = bltVector<DWORD, mirror, useDstColorKey, useSrcColorKey, useColorKeyRange>(
+			_mm_shuffle_epi8(d, getUInt24UnpackShuffleMask<false>()),
+			_mm_shuffle_epi8(s, getUInt24UnpackShuffleMask<mirror>()),
+			dstColorKey, srcColorKey);
+		result = _mm_shuffle_epi8(result, getUInt24PackShuffleMask());
+		_mm_storel_epi64(reinterpret_cast<__m128i*>(dst), result);
+		_mm_storeu_si32(reinterpret_cast<BYTE*>(dst) + 8, _mm_srli_si128(result, 8));
+		dst += 4;
+		src += mirror ? -4 : 4;
+	}
+
+	template <bool mirror, bool useDstColorKey, bool useSrcColorKey, bool useColorKeyRange>
+	__forceinline void bltUInt24WideVector(UInt24*& dst, const UInt24*& src, const DDCOLORKEY& dstColorKey, const DDCOLORKEY& srcColorKey)
+	{
+		BYTE* d0 = reinterpret_cast<BYTE*>(dst);
+		const BYTE* s0 = getUInt24VectorSrc<mirror>(src);
+		const BYTE* s1 = s0 + (mirror ? -12 : 12);
+		const __m256i d = _mm256_inserti128_si256(
+			_mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(d0))),
+			_mm_loadu_si128(reinterpret_cast<const __m128i*>(d0 + 12)), 1);
+		const __m256i s = _mm256_inserti128_si256(
+			_mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(s0))),
+			_mm_loadu_si128(reinterpret_cast<const __m128i*>(s1)), 1);
+
+		__m256i result = bltWideVector<Avx2, DWORD, useDstColorKey, useSrcColorKey, useColorKeyRange>(
+			_mm256_shuffle_epi8(d, _mm256_broadcastsi128_si256(getUInt24UnpackShuffleMask<false>())),
+			_mm256_shuffle_epi8(s, _mm256_broadcastsi128_si256(getUInt24UnpackShuffleMask<mirror>())),
+			dstColorKey, srcColorKey);
+		result = _mm256_shuffle_epi8(result, _mm256_broadcastsi128_si256(getUInt24PackShuffleMask()));
+		result = _mm256_permutevar8x32_epi32(result, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 7, 7));
+
+		// Storing exactly 24 bytes keeps the next iteration's loads from straddling these stores
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(d0), _mm256_castsi256_si128(result));
+		_mm_storel_epi64(reinterpret_cast<__m128i*>(d0 + 16), _mm256_extracti128_si256(result, 1));
+		dst += 8;
+		src += mirror ? -8 : 8;
+	}
+
+	template <typename Isa, int vectorSize, bool stretch, bool mirror, bool useDstColorKey, bool useSrcColorKey, bool useColorKeyRange>
 	__forceinline void bltVectorRow(UInt24* dst, const UInt24* src, DWORD width, int offset, int delta,
-		DWORD dstColorKey, DWORD srcColorKey)
+		const DDCOLORKEY& dstColorKey, const DDCOLORKEY& srcColorKey)
 	{
 		if (!stretch && !mirror && !useDstColorKey && !useSrcColorKey)
 		{
-			bltVectorRow<vectorSize, stretch, mirror, useDstColorKey, useSrcColorKey, BYTE>(
+			bltVectorRow<std::conditional_t<std::is_same_v<Isa, Ssse3>, Sse2, Isa>,
+				vectorSize, stretch, mirror, useDstColorKey, useSrcColorKey, useColorKeyRange, BYTE>(
 				reinterpret_cast<BYTE*>(dst), reinterpret_cast<const BYTE*>(src),
 				width * 3, offset, delta, dstColorKey, srcColorKey);
 			return;
@@ -352,28 +682,47 @@ namespace
 
 		if (2 == vectorSize)
 		{
-			bltPixel<stretch, mirror, useDstColorKey, useSrcColorKey>(dst, src, offset, delta, dstColorKey, srcColorKey);
+			bltPixel<stretch, mirror, useDstColorKey, useSrcColorKey, useColorKeyRange>(dst, src, offset, delta, dstColorKey, srcColorKey);
 			return;
 		}
 
 		if (4 == vectorSize)
 		{
-			bltPixel<stretch, mirror, useDstColorKey, useSrcColorKey>(dst, src, offset, delta, dstColorKey, srcColorKey);
-			bltPixel<stretch, mirror, useDstColorKey, useSrcColorKey>(dst, src, offset, delta, dstColorKey, srcColorKey);
+			bltPixel<stretch, mirror, useDstColorKey, useSrcColorKey, useColorKeyRange>(dst, src, offset, delta, dstColorKey, srcColorKey);
+			bltPixel<stretch, mirror, useDstColorKey, useSrcColorKey, useColorKeyRange>(dst, src, offset, delta, dstColorKey, srcColorKey);
 			return;
 		}
 
+		// Unpacks 3-byte pixels to 32-bit lanes through overlapping 16-byte loads; at least 6 (or 10) pixels
+		// must remain so that the loads stay within the row
+		if constexpr (16 == vectorSize && !stretch && !std::is_same_v<Isa, Sse2>)
+		{
+			if constexpr (!std::is_same_v<Isa, Ssse3>)
+			{
+				for (; width >= 10; width -= 8)
+				{
+					bltUInt24WideVector<mirror, useDstColorKey, useSrcColorKey, useColorKeyRange>(dst, src, dstColorKey, srcColorKey);
+				}
+				_mm256_zeroupper();
+			}
+
+			for (; width >= 6; width -= 4)
+			{
+				bltUInt24Vector<mirror, useDstColorKey, useSrcColorKey, useColorKeyRange>(dst, src, dstColorKey, srcColorKey);
+			}
+		}
+
 		for (DWORD i = width; i != 0; --i)
 		{
-			bltPixel<stretch, mirror, useDstColorKey, useSrcColorKey>(dst, src, offset, delta, dstColorKey, srcColorKey);
+			bltPixel<stretch, mirror, useDstColorKey, useSrcColorKey, useColorKeyRange>(dst, src, offset, delta, dstColorKey, srcColorKey);
 		}
 	}
 
-	template <typename Pixel, int vectorSize, bool stretch, bool mirror, bool useDstColorKey, bool useSrcColorKey>
+	template <typename Isa, typename Pixel, int vectorSize, bool stretch, bool mirror, bool useDstColorKey, bool useSrcColorKey, bool useColorKeyRange>
 	__forceinline std::enable_if_t<vectorSize >= sizeof(Pixel) || (2 == vectorSize && 3 == sizeof(Pixel))> vectorizedBlt(
 		BYTE * dst, DWORD dstPitch, DWORD dstWidth, DWORD dstHeight,
 		const BYTE * src, DWORD srcPitch, int offsetX, int deltaX, int offsetY, int deltaY,
-		DWORD dstColorKey, DWORD srcColorKey)
+		const DDCOLORKEY& dstColorKey, const DDCOLORKEY& srcColorKey)
 	{
 		if (3 != sizeof(Pixel) && !stretch && mirror)
 		{
@@ -382,96 +731,127 @@ namespace
 
 		for (DWORD i = dstHeight; i != 0; --i)
 		{
-			bltVectorRow<vectorSize, stretch, mirror, useDstColorKey, useSrcColorKey>(
+			bltVectorRow<Isa, vectorSize, stretch, mirror, useDstColorKey, useSrcColorKey, useColorKeyRange>(
 				reinterpret_cast<Pixel*>(dst),
-				reinterpret_cast<const Pixel*>(src + (offsetY >> 16) * srcPitch),
+				reinterpret_cast<const Pixel*>(src + (offsetY >> 16) * static_cast<int>(srcPitch)),
 				dstWidth, offsetX, deltaX, dstColorKey, srcColorKey);
 			dst += dstPitch;
 			offsetY += deltaY;
 		}
 	}
 
-	template <typename Pixel, int vectorSize, bool stretch, bool mirror, bool useDstColorKey, bool useSrcColorKey>
+	template <typename Isa, typename Pixel, int vectorSize, bool stretch, bool mirror, bool useDstColorKey, bool useSrcColorKey, bool useColorKeyRange>
 	__forceinline std::enable_if_t < vectorSize < sizeof(Pixel) && (2 != vectorSize || 3 != sizeof(Pixel))> vectorizedBlt(
 		BYTE* /*dst*/, DWORD /*dstPitch*/, DWORD /*dstWidth*/, DWORD /*dstHeight*/,
 		const BYTE* /*src*/, DWORD /*srcPitch*/, int /*offsetX*/, int /*deltaX*/, int /*offsetY*/, int /*deltaY*/,
-		const DWORD /*dstColorKey*/, const DWORD /*srcColorKey*/)
+		const DDCOLORKEY& /*dstColorKey*/, const DDCOLORKEY& /*srcColorKey*/)
 	{
 	}
 
-	template <typename Pixel, int vectorSize, bool stretch, bool mirror, bool useDstColorKey, bool useSrcColorKey>
+	template <typename Isa, typename Pixel, int vectorSize, bool stretch, bool mirror, bool useDstColorKey, bool useSrcColorKey, bool useColorKeyRange>
 	void vectorizedBltFunc(void* dst, DWORD dstPitch, DWORD dstWidth, DWORD dstHeight,
 		const void* src, DWORD srcPitch, int offsetX, int deltaX, int offsetY, int deltaY,
-		DWORD dstColorKey, DWORD srcColorKey)
+		const DDCOLORKEY& dstColorKey, const DDCOLORKEY& srcColorKey)
 	{
-		vectorizedBlt<Pixel, vectorSize, stretch, mirror, useDstColorKey, useSrcColorKey>(
+		vectorizedBlt<Isa, Pixel, vectorSize, stretch, mirror, useDstColorKey, useSrcColorKey, useColorKeyRange>(
 			static_cast<BYTE*>(dst), dstPitch, dstWidth, dstHeight,
 			static_cast<const BYTE*>(src), srcPitch, offsetX, deltaX, offsetY, deltaY, dstColorKey, srcColorKey);
 	}
 
-	template <typename Pixel, int vectorSize, bool stretch, bool mirror, bool useDstColorKey, bool useSrcColorKey>
+	template <typename Isa, typename Pixel, int vectorSize, bool stretch, bool mirror, bool useDstColorKey, bool useSrcColorKey, bool useColorKeyRange>
 	auto getVectorizedBltFunc()
 	{
-		return &vectorizedBltFunc<Pixel, vectorSize, stretch, mirror, useDstColorKey, useSrcColorKey>;
+		return &vectorizedBltFunc<Isa, Pixel, vectorSize, stretch, mirror, useDstColorKey, useSrcColorKey, useColorKeyRange>;
+	}
+
+	template <typename Isa, typename Pixel, int vectorSize, bool stretch, bool mirror, bool useDstColorKey, bool useSrcColorKey>
+	auto getVectorizedBltFunc(bool useColorKeyRange)
+	{
+		if constexpr (useDstColorKey || useSrcColorKey)
+		{
+			return useColorKeyRange
+				? getVectorizedBltFunc<Isa, Pixel, vectorSize, stretch, mirror, useDstColorKey, useSrcColorKey, true>()
+				: getVectorizedBltFunc<Isa, Pixel, vectorSize, stretch, mirror, useDstColorKey, useSrcColorKey, false>();
+		}
+		else
+		{
+			return getVectorizedBltFunc<Isa, Pixel, vectorSize, stretch, mirror, false, false, false>();
+		}
 	}
 
-	template <typename Pixel, int vectorSize, bool stretch, bool mirror, bool useDstColorKey>
-	auto getVectorizedBltFunc(bool useSrcColorKey)
+	template <typename Isa, typename Pixel, int vectorSize, bool stretch, bool mirror, bool useDstColorKey>
+	auto getVectorizedBltFunc(bool useSrcColorKey, bool useColorKeyRange)
 	{
 		return useSrcColorKey
-			? getVectorizedBltFunc<Pixel, vectorSize, stretch, mirror, useDstColorKey, true>()
-			: getVectorizedBltFunc<Pixel, vectorSize, stretch, mirror, useDstColorKey, false>();
+			? getVectorizedBltFunc<Isa, Pixel, vectorSize, stretch, mirror, useDstColorKey, true>(useColorKeyRange)
+			: getVectorizedBltFunc<Isa, Pixel, vectorSize, stretch, mirror, useDstColorKey, false>(useColorKeyRange);
 	}
 
-	template <typename Pixel, int vectorSize, bool stretch, bool mirror>
-	auto getVectorizedBltFunc(bool useDstColorKey, bool useSrcColorKey)
+	template <typename Isa, typename Pixel, int vectorSize, bool stretch, bool mirror>
+	auto getVectorizedBltFunc(bool useDstColorKey, bool useSrcColorKey, bool useColorKeyRange)
 	{
 		return useDstColorKey
-			? getVectorizedBltFunc<Pixel, vectorSize, stretch, mirror, true>(useSrcColorKey)
-			: getVectorizedBltFunc<Pixel, vectorSize, stretch, mirror, false>(useSrcColorKey);
+			? getVectorizedBltFunc<Isa, Pixel, vectorSize, stretch, mirror, true>(useSrcColorKey, useColorKeyRange)
+			: getVectorizedBltFunc<Isa, Pixel, vectorSize, stretch, mirror, false>(useSrcColorKey, useColorKeyRange);
 	}
 
-	template <typename Pixel, int vectorSize, bool stretch>
-	auto getVectorizedBltFunc(bool mirror, bool useDstColorKey, bool useSrcColorKey)
+	template <typename Isa, typename Pixel, int vectorSize, bool stretch>
+	auto getVectorizedBltFunc(bool mirror, bool useDstColorKey, bool useSrcColorKey, bool useColorKeyRange)
 	{
 		return mirror
-			? getVectorizedBltFunc<Pixel, vectorSize, stretch, true>(useDstColorKey, useSrcColorKey)
-			: getVectorizedBltFunc<Pixel, vectorSize, stretch, false>(useDstColorKey, useSrcColorKey);
+			? getVectorizedBltFunc<Isa, Pixel, vectorSize, stretch, true>(useDstColorKey, useSrcColorKey, useColorKeyRange)
+			: getVectorizedBltFunc<Isa, Pixel, vectorSize, stretch, false>(useDstColorKey, useSrcColorKey, useColorKeyRange);
 	}
 
-	template <typename Pixel, int vectorSize>
-	auto getVectorizedBltFunc(bool stretch, bool mirror, bool useDstColorKey, bool useSrcColorKey)
+	template <typename Isa, typename Pixel, int vectorSize>
+	auto getVectorizedBltFunc(bool stretch, bool mirror, bool useDstColorKey, bool useSrcColorKey, bool useColorKeyRange)
 	{
 		return stretch
-			? getVectorizedBltFunc<Pixel, vectorSize, true>(mirror, useDstColorKey, useSrcColorKey)
-			: getVectorizedBltFunc<Pixel, vectorSize, false>(mirror, useDstColorKey, useSrcColorKey);
+			? getVectorizedBltFunc<Isa, Pixel, vectorSize, true>(mirror, useDstColorKey, useSrcColorKey, useColorKeyRange)
+			: getVectorizedBltFunc<Isa, Pixel, vectorSize, false>(mirror, useDstColorKey, useSrcColorKey, useColorKeyRange);
 	}
 
-	template <typename Pixel>
-	auto getVectorizedBltFunc(DWORD width, bool stretch, bool mirror, bool useDstColorKey, bool useSrcColorKey)
+	template <typename Isa, typename Pixel>
+	auto getVectorizedBltFunc(DWORD width, bool stretch, bool mirror,
+		bool useDstColorKey, bool useSrcColorKey, bool useColorKeyRange)
+	{
+		if (width >= 16) return getVectorizedBltFunc<Isa, Pixel, 16>(stretch, mirror, useDstColorKey, useSrcColorKey, useColorKeyRange);
+		if (width >= 8) return getVectorizedBltFunc<Sse2, Pixel, 8>(stretch, mirror, useDstColorKey, useSrcColorKey, useColorKeyRange);
+		if (width >= 4) return getVectorizedBltFunc<Sse2, Pixel, 4>(stretch, mirror, useDstColorKey, useSrcColorKey, useColorKeyRange);
+		if (width >= 2) return getVectorizedBltFunc<Sse2, Pixel, 2>(stretch, mirror, useDstColorKey, useSrcColorKey, useColorKeyRange);
+		return getVectorizedBltFunc<Sse2, Pixel, 1>(stretch, mirror, useDstColorKey, useSrcColorKey, useColorKeyRange);
+	}
+
+	bool isSsse3Supported()
 	{
-		if (width >= 16) return getVectorizedBltFunc<Pixel, 16>(stretch, mirror, useDstColorKey, useSrcColorKey);
-		if (width >= 8) return getVectorizedBltFunc<Pixel, 8>(stretch, mirror, useDstColorKey, useSrcColorKey);
-		if (width >= 4) return getVectorizedBltFunc<Pixel, 4>(stretch, mirror, useDstColorKey, useSrcColorKey);
-		if (width >= 2) return getVectorizedBltFunc<Pixel, 2>(stretch, mirror, useDstColorKey, useSrcColorKey);
-		return getVectorizedBltFunc<Pixel, 1>(stretch, mirror, useDstColorKey, useSrcColorKey);
+		int cpuInfo[4] = {};
+		__cpuid(cpuInfo, 1);
+		const int ssse3 = 1 << 9;
+		return 0 != (cpuInfo[2] & ssse3);
 	}
 
+	template <typename Isa>
 	auto getVectorizedBltFunc(DWORD bytesPerPixel, DWORD width,
-		bool stretch, bool mirror, bool useDstColorKey, bool useSrcColorKey)
+		bool stretch, bool mirror, bool useDstColorKey, bool useSrcColorKey, bool useColorKeyRange)
 	{
 		switch (bytesPerPixel)
 		{
-		case 4: return getVectorizedBltFunc<DWORD>(width, stretch, mirror, useDstColorKey, useSrcColorKey);
-		case 3: return getVectorizedBltFunc<UInt24>(width, stretch, mirror, useDstColorKey, useSrcColorKey);
-		case 2: return getVectorizedBltFunc<WORD>(width, stretch, mirror, useDstColorKey, useSrcColorKey);
-		default: return getVectorizedBltFunc<BYTE>(width, stretch, mirror, useDstColorKey, useSrcColorKey);
+		case 4: return getVectorizedBltFunc<Isa, DWORD>(width, stretch, mirror, useDstColorKey, useSrcColorKey, useColorKeyRange);
+		case 3:
+			if (std::is_same_v<Isa, Sse2> && isSsse3Supported())
+			{
+				return getVectorizedBltFunc<Ssse3, UInt24>(width, stretch, mirror, useDstColorKey, useSrcColorKey, useColorKeyRange);
+			}
+			return getVectorizedBltFunc<Isa, UInt24>(width, stretch, mirror, useDstColorKey, useSrcColorKey, useColorKeyRange);
+		case 2: return getVectorizedBltFunc<Isa, WORD>(width, stretch, mirror, useDstColorKey, useSrcColorKey, useColorKeyRange);
+		default: return getVectorizedBltFunc<Isa, BYTE>(width, stretch, mirror, useDstColorKey, useSrcColorKey, useColorKeyRange);
 		}
 	}
 
+	template <typename Isa>
 	auto getVectorizedBltFuncs()
 	{
-		typename MultiDimArray<decltype(&vectorizedBltFunc<BYTE, 1, false, false, false, false>), 4, 5, 2, 2, 2, 2>::type vectorizedBltFuncs;
+		typename MultiDimArray<decltype(&vectorizedBltFunc<Sse2, BYTE, 1, false, false, false, false, false>), 4, 5, 2, 2, 2, 2, 2>::type vectorizedBltFuncs;
 		for (int bytesPerPixel = 1; bytesPerPixel <= 4; ++bytesPerPixel)
 		{
 			for (int width = 0; width <= 4; ++width)
@@ -484,9 +864,12 @@ namespace
 						{
 							for (int useSrcColorKey = 0; useSrcColorKey <= 1; ++useSrcColorKey)
 							{
-								vectorizedBltFuncs[bytesPerPixel - 1][width][stretch][mirror][useDstColorKey][useSrcColorKey] =
-									getVectorizedBltFunc(bytesPerPixel, static_cast<DWORD>(pow(2, width)),
-										stretch, mirror, useDstColorKey, useSrcColorKey);
+								for (int useColorKeyRange = 0; useColorKeyRange <= 1; ++useColorKeyRange)
+								{
+									vectorizedBltFuncs[bytesPerPixel - 1][width][stretch][mirror][useDstColorKey][useSrcColorKey][useColorKeyRange] =
+										getVectorizedBltFunc<Isa>(bytesPerPixel, static_cast<DWORD>(pow(2, width)),
+											stretch, mirror, useDstColorKey, useSrcColorKey, useColorKeyRange);
+								}
 							}
 						}
 					}
@@ -496,60 +879,600 @@ namespace
 		return vectorizedBltFuncs;
 	}
 
-	const auto g_vectorizedBltFuncs(getVectorizedBltFuncs());
-
-	bool doOverlappingBlt(BYTE* dst, DWORD pitch, DWORD dstWidth, DWORD dstHeight,
-		const BYTE* src, LONG srcWidth, LONG srcHeight,
-		DWORD bytesPerPixel, const DWORD* dstColorKey, const DWORD* srcColorKey)
+	bool isAvx2Supported()
 	{
-		const bool mirrorLeftRight = srcWidth < 0;
-		const bool mirrorUpDown = srcHeight < 0;
+		int cpuInfo[4] = {};
+		__cpuid(cpuInfo, 0);
+		if (cpuInfo[0] < 7)
+		{
+			return false;
+		}
 
-		const DWORD absSrcWidth = mirrorLeftRight ? -srcWidth : srcWidth;
-		const DWORD absSrcHeight = mirrorUpDown ? -srcHeight : srcHeight;
+		__cpuid(cpuInfo, 1);
+		const int osxsave = 1 << 27;
+		const int avx = 1 << 28;
+		if ((cpuInfo[2] & (osxsave | avx)) != (osxsave | avx) ||
+			(_xgetbv(0) & 0x6) != 0x6)
+		{
+			return false;
+		}
 
-		RECT dstRect = { 0, 0, static_cast<LONG>(dstWidth * bytesPerPixel), static_cast<LONG>(dstHeight) };
-		RECT srcRect = { 0, 0, static_cast<LONG>(absSrcWidth * bytesPerPixel), static_cast<LONG>(absSrcHeight) };
+		__cpuidex(cpuInfo, 7, 0);
+		const int avx2 = 1 << 5;
+		return 0 != (cpuInfo[1] & avx2);
+	}
 
-		srcRect.top = (src - dst) / static_cast<LONG>(pitch);
-		srcRect.left = (src - dst) % static_cast<LONG>(pitch);
-		srcRect.bottom += srcRect.top;
-		srcRect.right += srcRect.left;
+	bool isAvx512Supported()
+	{
+		if (!isAvx2Supported() || (_xgetbv(0) & 0xE6) != 0xE6)
+		{
+			return false;
+		}
 
-		LONG rowError = 0;
-		if (src < dst)
+		int cpuInfo[4] = {};
+		__cpuidex(cpuInfo, 7, 0);
+		const int avx512f = 1 << 16;
+		const int avx512bw = 1 << 30;
+		return (cpuInfo[1] & (avx512f | avx512bw)) == (avx512f | avx512bw);
+	}
+
+	auto getVectorizedBltFuncs()
+	{
+		if (isAvx512Supported())
 		{
-			rowError = (dstRect.right - srcRect.left > static_cast<LONG>(pitch)) ? 1 : 0;
+			return getVectorizedBltFuncs<Avx512>();
 		}
-		else
+		if (isAvx2Supported())
 		{
-			rowError = (srcRect.right - dstRect.left > static_cast<LONG>(pitch)) ? -1 : 0;
+			return getVectorizedBltFuncs<Avx2>();
 		}
-		srcRect.left += rowError * pitch;
-		srcRect.right += rowError * pitch;
-		srcRect.top -= rowError;
-		srcRect.bottom -= rowError;
+		return getVectorizedBltFuncs<Sse2>();
+	}
 
-		RECT r = {};
-		if (!IntersectRect(&r, &dstRect, &srcRect))
+	const auto g_vectorizedBltFuncs(getVectorizedBltFuncs());
+
+	auto lookupVectorizedBltFunc(DWORD bytesPerPixel, DWORD width,
+		bool stretch, bool mirror, bool useDstColorKey, bool useSrcColorKey, bool useColorKeyRange)
+	{
+		const DWORD byteWidth = width * bytesPerPixel;
+		return g_vectorizedBltFuncs
+			[bytesPerPixel - 1]
+		[(byteWidth >= 2) + (byteWidth >= 4) + (byteWidth >= 8) + (byteWidth >= 16)]
+		[stretch]
+		[mirror]
+		[useDstColorKey]
+		[useSrcColorKey]
+		[useColorKeyRange];
+	}
+
+	struct BandedExecution
+	{
+		const std::function<void(DWORD, DWORD)>* func;
+		DWORD height;
+		DWORD bandHeight;
+		LONG bandCount;
+		volatile LONG nextBand;
+		volatile LONG activeWorkerCount;
+	};
+
+	// Not a critical section: those are recursive, and a nested execBanded must not replace the running job
+	volatile LONG g_isBandedExecutionBusy = 0;
+	BandedExecution g_bandedExecution = {};
+	HANDLE g_bandedExecutionStartSemaphore = nullptr;
+	HANDLE g_bandedExecutionDoneEvent = nullptr;
+	DWORD g_workerThreadCount = 0;
+	bool g_isWorkerThreadPoolInitialized = false;
+
+	void execBands()
+	{
+		LONG band = 0;
+		while ((band = InterlockedIncrement(&g_bandedExecution.nextBand) - 1) < g_bandedExecution.bandCount)
 		{
-			return false;
+			const DWORD top = band * g_bandedExecution.bandHeight;
+			const DWORD bottom = std::min<DWORD>(top + g_bandedExecution.bandHeight, g_bandedExecution.height);
+			(*g_bandedExecution.func)(top, bottom);
 		}
+	}
 
-		if (!mirrorLeftRight && !mirrorUpDown)
+	DWORD WINAPI workerThreadProc(LPVOID /*lpParameter*/)
+	{
+		while (WAIT_OBJECT_0 == WaitForSingleObject(g_bandedExecutionStartSemaphore, INFINITE))
 		{
-			if (EqualRect(&dstRect, &srcRect))
+			execBands();
+			if (0 == InterlockedDecrement(&g_bandedExecution.activeWorkerCount))
 			{
-				return true;
+				SetEvent(g_bandedExecutionDoneEvent);
+			}
+		}
+		return 0;
+	}
+
+	void initWorkerThreadPool()
+	{
+		g_isWorkerThreadPoolInitialized = true;
+
+		const DWORD threadCount = std::min<DWORD>(Config::maxBltWorkerThreads, Win32::Thread::getAvailableProcessorCount() - 1);
+		if (0 == threadCount)
+		{
+			return;
+		}
+
+		g_bandedExecutionStartSemaphore = CreateSemaphore(nullptr, 0, threadCount, nullptr);
+		g_bandedExecutionDoneEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+		if (!g_bandedExecutionStartSemaphore || !g_bandedExecutionDoneEvent)
+		{
+			return;
+		}
+
+		for (DWORD i = 0; i < threadCount; ++i)
+		{
+			HANDLE thread = CreateThread(nullptr, 0, &workerThreadProc, nullptr, 0, nullptr);
+			if (!thread)
+			{
+				break;
+			}
+			CloseHandle(thread);
+			++g_workerThreadCount;
+		}
+	}
+
+	void execBanded(DWORD height, DWORD byteCount, const std::function<void(DWORD, DWORD)>& func)
+	{
+		if (byteCount < Config::minParallelBltSize ||
+			height < 2 * Config::minParallelBltBandHeight ||
+			0 != InterlockedCompareExchange(&g_isBandedExecutionBusy, 1, 0))
+		{
+			func(0, height);
+			return;
+		}
+
+		if (!g_isWorkerThreadPoolInitialized)
+		{
+			initWorkerThreadPool();
+		}
+
+		if (0 == g_workerThreadCount)
+		{
+			InterlockedExchange(&g_isBandedExecutionBusy, 0);
+			func(0, height);
+			return;
+		}
+
+		const DWORD maxBandCount = std::min<DWORD>(4 * (g_workerThreadCount + 1), height / Config::minParallelBltBandHeight);
+		const DWORD bandHeight = (height + maxBandCount - 1) / maxBandCount;
+		const LONG bandCount = (height + bandHeight - 1) / bandHeight;
+		const LONG workerCount = std::min<LONG>(g_workerThreadCount, bandCount - 1);
+
+		g_bandedExecution.func = &func;
+		g_bandedExecution.height = height;
+		g_bandedExecution.bandHeight = bandHeight;
+		g_bandedExecution.bandCount = bandCount;
+		g_bandedExecution.activeWorkerCount = workerCount;
+		InterlockedExchange(&g_bandedExecution.nextBand, 0);
+
+		ReleaseSemaphore(g_bandedExecutionStartSemaphore, workerCount, nullptr);
+		execBands();
+		WaitForSingleObject(g_bandedExecutionDoneEvent, INFINITE);
+
+		InterlockedExchange(&g_isBandedExecutionBusy, 0);
+	}
+
+	DWORD getMinStreamingBltSize()
+	{
+		DWORD size = 0;
+		GetLogicalProcessorInformation(nullptr, &size);
+		std::vector<SYSTEM_LOGICAL_PROCESSOR_INFORMATION> info(size / sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION));
+		size = info.size() * sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION);
+		if (info.empty() || !GetLogicalProcessorInformation(info.data(), &size))
+		{
+			return Config::minStreamingBltSize;
+		}
+
+		DWORD cacheSize = 0;
+		BYTE cacheLevel = 0;
+		for (const auto& i : info)
+		{
+			if (RelationCache == i.Relationship && i.Cache.Level >= cacheLevel)
+			{
+				cacheSize = i.Cache.Level > cacheLevel ? i.Cache.Size : std::max<DWORD>(cacheSize, i.Cache.Size);
+				cacheLevel = i.Cache.Level;
+			}
+		}
+		return std::max<DWORD>(cacheSize, Config::minStreamingBltSize);
+	}
+
+	const DWORD g_minStreamingBltSize = getMinStreamingBltSize();
+
+	void streamRow(BYTE* dst, const BYTE* src, DWORD size)
+	{
+		if (size < 64)
+		{
+			memcpy(dst, src, size);
+			return;
+		}
+
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst), _mm_loadu_si128(reinterpret_cast<const __m128i*>(src)));
+		DWORD i = (16 - (reinterpret_cast<uintptr_t>(dst) & 15)) & 15;
+		for (; i + 16 <= size; i += 16)
+		{
+			_mm_stream_si128(reinterpret_cast<__m128i*>(dst + i), _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)));
+		}
+
+		if (i < size)
+		{
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + size - 16),
+				_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + size - 16)));
+		}
+	}
+
+	void prefetchRow(const BYTE* src, DWORD size)
+	{
+		for (DWORD i = 0; i < size; i += 64)
+		{
+			_mm_prefetch(reinterpret_cast<const char*>(src + i), _MM_HINT_T0);
+		}
+	}
+
+	void streamingBltRows(BYTE* dst, DWORD dstPitch, DWORD dstWidth, DWORD top, DWORD bottom,
+		const BYTE* src, DWORD srcPitch, const BYTE* srcRowStart, DWORD srcByteWidth,
+		int offsetX, int deltaX, int offsetY, int deltaY, DWORD bytesPerPixel,
+		decltype(&vectorizedBltFunc<Sse2, BYTE, 1, false, false, false, false, false>) vectorizedBltFunc, bool resample)
+	{
+		thread_local std::vector<BYTE> rowBuffer;
+		const DWORD dstByteWidth = dstWidth * bytesPerPixel;
+		if (resample)
+		{
+			rowBuffer.resize(dstByteWidth);
+		}
+
+		for (DWORD y = top; y < bottom; ++y)
+		{
+			const int srcY = (offsetY + static_cast<int>(y) * deltaY) >> 16;
+			const int nextSrcY = (offsetY + static_cast<int>(y + 1) * deltaY) >> 16;
+			const BYTE* srcRow = src + srcY * static_cast<int>(srcPitch);
+			if (y + 1 < bottom && nextSrcY != srcY && nextSrcY != srcY + 1 && nextSrcY != srcY - 1)
+			{
+				prefetchRow(srcRowStart + nextSrcY * static_cast<int>(srcPitch), srcByteWidth);
+			}
+
+			if (resample)
+			{
+				vectorizedBltFunc(rowBuffer.data(), 0, dstWidth, 1, srcRow, 0, offsetX, deltaX, 0, 0, {}, {});
+				srcRow = rowBuffer.data();
+			}
+			streamRow(dst + y * dstPitch, srcRow, dstByteWidth);
+		}
+		_mm_sfence();
+	}
+
+	struct StretchTable
+	{
+		DWORD srcWidth;
+		DWORD dstWidth;
+		bool mirror;
+		DWORD bytesPerPixel;
+		DWORD lastUse;
+		std::vector<int> srcOffsets;
+	};
+
+	const int* getStretchTable(DWORD srcWidth, DWORD dstWidth, bool mirror, DWORD bytesPerPixel)
+	{
+		thread_local std::array<StretchTable, 8> cache = {};
+		thread_local DWORD useCount = 0;
+		++useCount;
+
+		StretchTable* lru = &cache[0];
+		for (auto& table : cache)
+		{
+			if (!table.srcOffsets.empty() && table.srcWidth == srcWidth && table.dstWidth == dstWidth &&
+				table.mirror == mirror && table.bytesPerPixel == bytesPerPixel)
+			{
+				table.lastUse = useCount;
+				return table.srcOffsets.data();
+			}
+			if (table.lastUse < lru->lastUse)
+			{
+				lru = &table;
+			}
+		}
+
+		int deltaX = (srcWidth << 16) / dstWidth;
+		int offsetX = deltaX / 2;
+		if (mirror)
+		{
+			offsetX += static_cast<int>(dstWidth - 1) * deltaX;
+			deltaX = -deltaX;
+		}
+
+		lru->srcWidth = srcWidth;
+		lru->dstWidth = dstWidth;
+		lru->mirror = mirror;
+		lru->bytesPerPixel = bytesPerPixel;
+		lru->lastUse = useCount;
+		lru->srcOffsets.resize(dstWidth);
+		for (DWORD x = 0; x < dstWidth; ++x)
+		{
+			lru->srcOffsets[x] = ((offsetX + static_cast<int>(x) * deltaX) >> 16) * bytesPerPixel;
+		}
+		return lru->srcOffsets.data();
+	}
+
+	template <typename Pixel>
+	void stretchRow(Pixel* dst, const BYTE* src, const int* srcOffsets, DWORD width, int /*maxGatherOffset*/)
+	{
+		for (DWORD x = 0; x < width; ++x)
+		{
+			dst[x] = *reinterpret_cast<const Pixel*>(src + srcOffsets[x]);
+		}
+	}
+
+	template <typename Pixel>
+	void stretchRowAvx2(Pixel* dst, const BYTE* src, const int* srcOffsets, DWORD width, int maxGatherOffset)
+	{
+		if constexpr (3 == sizeof(Pixel))
+		{
+			stretchRow(dst, src, srcOffsets, width, maxGatherOffset);
+		}
+		else
+		{
+			DWORD x = 0;
+			for (; x + 8 <= width; x += 8)
+			{
+				if (4 != sizeof(Pixel) && std::max<int>(srcOffsets[x], srcOffsets[x + 7]) > maxGatherOffset)
+				{
+					stretchRow(dst + x, src, srcOffsets + x, 8, maxGatherOffset);
+					continue;
+				}
+
+				const __m256i offsets = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(srcOffsets + x));
+				__m256i vec = _mm256_i32gather_epi32(reinterpret_cast<const int*>(src), offsets, 1);
+				if (4 == sizeof(Pixel))
+				{
+					_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x), vec);
+				}
+				else if (2 == sizeof(Pixel))
+				{
+					vec = _mm256_shuffle_epi8(vec, _mm256_setr_epi8(
+						0, 1, 4, 5, 8, 9, 12, 13, -1, -1, -1, -1, -1, -1, -1, -1,
+						0, 1, 4, 5, 8, 9, 12, 13, -1, -1, -1, -1, -1, -1, -1, -1));
+					vec = _mm256_permute4x64_epi64(vec, _MM_SHUFFLE(3, 1, 2, 0));
+					_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), _mm256_castsi256_si128(vec));
+				}
+				else
+				{
+					vec = _mm256_shuffle_epi8(vec, _mm256_setr_epi8(
+						0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+						0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1));
+					vec = _mm256_permutevar8x32_epi32(vec, _mm256_setr_epi32(0, 4, 1, 1, 1, 1, 1, 1));
+					_mm_storel_epi64(reinterpret_cast<__m128i*>(dst + x), _mm256_castsi256_si128(vec));
+				}
+			}
+			_mm256_zeroupper();
+			stretchRow(dst + x, src, srcOffsets + x, width - x, maxGatherOffset);
+		}
+	}
+
+	template <typename Pixel>
+	const auto g_stretchRowFunc = isAvx2Supported() ? &stretchRowAvx2<Pixel> : &stretchRow<Pixel>;
+
+	template <int size> __m128i _mm_unpacklo_epi(__m128i a, __m128i b);
+	template <> __m128i _mm_unpacklo_epi<1>(__m128i a, __m128i b) { return _mm_unpacklo_epi8(a, b); }
+	template <> __m128i _mm_unpacklo_epi<2>(__m128i a, __m128i b) { return _mm_unpacklo_epi16(a, b); }
+	template <> __m128i _mm_unpacklo_epi<4>(__m128i a, __m128i b) { return _mm_unpacklo_epi32(a, b); }
+	template <> __m128i _mm_unpacklo_epi<8>(__m128i a, __m128i b) { return _mm_unpacklo_epi64(a, b); }
+
+	template <int size> __m128i _mm_unpackhi_epi(__m128i a, __m128i b);
+	template <> __m128i _mm_unpackhi_epi<1>(__m128i a, __m128i b) { return _mm_unpackhi_epi8(a, b); }
+	template <> __m128i _mm_unpackhi_epi<2>(__m128i a, __m128i b) { return _mm_unpackhi_epi16(a, b); }
+	template <> __m128i _mm_unpackhi_epi<4>(__m128i a, __m128i b) { return _mm_unpackhi_epi32(a, b); }
+	template <> __m128i _mm_unpackhi_epi<8>(__m128i a, __m128i b) { return _mm_unpackhi_epi64(a, b); }
+
+	template <typename Pixel, int factor>
+	void upscaleRow(Pixel* dst, const Pixel* src, DWORD srcWidth)
+	{
+		for (DWORD x = 0; x < srcWidth; ++x)
+		{
+			for (int i = 0; i < factor; ++i)
+			{
+				*dst++ = src[x];
+			}
+		}
+	}
+
+	template <typename Pixel, int factor>
+	void upscaleRowSse2(Pixel* dst, const BYTE* src, const int* /*srcOffsets*/, DWORD width, int /*maxGatherOffset*/)
+	{
+		const int pixelsPerVector = 16 / sizeof(Pixel);
+		const DWORD srcWidth = width / factor;
+		const Pixel* srcPixels = reinterpret_cast<const Pixel*>(src);
+		DWORD x = 0;
+		if constexpr (3 != sizeof(Pixel) && (3 != factor || 4 == sizeof(Pixel)))
+		{
+			for (; x + pixelsPerVector <= srcWidth; x += pixelsPerVector)
+			{
+				const __m128i vec = _mm_loadu_si128(reinterpret_cast<const __m128i*>(srcPixels + x));
+				__m128i* d = reinterpret_cast<__m128i*>(dst + x * factor);
+				if (2 == factor)
+				{
+					_mm_storeu_si128(d, _mm_unpacklo_epi<sizeof(Pixel)>(vec, vec));
+					_mm_storeu_si128(d + 1, _mm_unpackhi_epi<sizeof(Pixel)>(vec, vec));
+				}
+				else if (4 == factor)
+				{
+					const __m128i lo = _mm_unpacklo_epi<sizeof(Pixel)>(vec, vec);
+					const __m128i hi = _mm_unpackhi_epi<sizeof(Pixel)>(vec, vec);
+					_mm_storeu_si128(d, _mm_unpacklo_epi<2 * sizeof(Pixel)>(lo, lo));
+					_mm_storeu_si128(d + 1, _mm_unpackhi_epi<2 * sizeof(Pixel)>(lo, lo));
+					_mm_storeu_si128(d + 2, _mm_unpacklo_epi<2 * sizeof(Pixel)>(hi, hi));
+					_mm_storeu_si128(d + 3, _mm_unpackhi_epi<2 * sizeof(Pixel)>(hi, hi));
+				}
+				else
+				{
+					_mm_storeu_si128(d, _mm_shuffle_epi32(vec, _MM_SHUFFLE(1, 0, 0, 0)));
+					_mm_storeu_si128(d + 1, _mm_shuffle_epi32(vec, _MM_SHUFFLE(2, 2, 1, 1)));
+					_mm_storeu_si128(d + 2, _mm_shuffle_epi32(vec, _MM_SHUFFLE(3, 3, 3, 2)));
+				}
+			}
+		}
+		upscaleRow<Pixel, factor>(dst + x * factor, srcPixels + x, srcWidth - x);
+	}
+
+	template <typename Pixel>
+	__m128i getTripleShuffleMask(int part)
+	{
+		alignas(16) char mask[16] = {};
+		for (int i = 0; i < 16; ++i)
+		{
+			const int dstByte = part * 16 + i;
+			mask[i] = static_cast<char>(dstByte / sizeof(Pixel) / 3 * sizeof(Pixel) + dstByte % sizeof(Pixel));
+		}
+		return _mm_load_si128(reinterpret_cast<const __m128i*>(mask));
+	}
+
+	template <typename Pixel>
+	void upscaleRowSsse3(Pixel* dst, const BYTE* src, const int* srcOffsets, DWORD width, int maxGatherOffset)
+	{
+		if constexpr (1 != sizeof(Pixel) && 2 != sizeof(Pixel))
+		{
+			upscaleRowSse2<Pixel, 3>(dst, src, srcOffsets, width, maxGatherOffset);
+		}
+		else
+		{
+			static const __m128i masks[3] = {
+				getTripleShuffleMask<Pixel>(0), getTripleShuffleMask<Pixel>(1), getTripleShuffleMask<Pixel>(2) };
+			const int pixelsPerVector = 16 / sizeof(Pixel);
+			const DWORD srcWidth = width / 3;
+			const Pixel* srcPixels = reinterpret_cast<const Pixel*>(src);
+			DWORD x = 0;
+			for (; x + pixelsPerVector <= srcWidth; x += pixelsPerVector)
+			{
+				const __m128i vec = _mm_loadu_si128(reinterpret_cast<const __m128i*>(srcPixels + x));
+				__m128i* d = reinterpret_cast<__m128i*>(dst + x * 3);
+				_mm_storeu_si128(d, _mm_shuffle_epi8(vec, masks[0]));
+				_mm_storeu_si128(d + 1, _mm_shuffle_epi8(vec, masks[1]));
+				_mm_storeu_si128(d + 2, _mm_shuffle_epi8(vec, masks[2]));
+			}
+			upscaleRow<Pixel, 3>(dst + x * 3, srcPixels + x, srcWidth - x);
+		}
+	}
+
+	template <typename Pixel>
+	const auto g_upscale3RowFunc = isSsse3Supported() ? &upscaleRowSsse3<Pixel> : &upscaleRowSse2<Pixel, 3>;
+
+	template <typename Pixel>
+	auto getUpscaleRowFunc(DWORD factor)
+	{
+		switch (factor)
+		{
+		case 2: return &upscaleRowSse2<Pixel, 2>;
+		case 3: return g_upscale3RowFunc<Pixel>;
+		case 4: return &upscaleRowSse2<Pixel, 4>;
+		default: return g_stretchRowFunc<Pixel>;
+		}
+	}
+
+	template <typename Pixel>
+	void stretchBltRows(BYTE* dst, DWORD dstPitch, DWORD dstWidth, DWORD top, DWORD bottom,
+		const BYTE* src, DWORD srcPitch, DWORD srcWidth, const int* srcOffsets, int offsetY, int deltaY,
+		DWORD upscaleFactor)
+	{
+		const auto stretchRowFunc = getUpscaleRowFunc<Pixel>(upscaleFactor);
+		const DWORD dstByteWidth = dstWidth * sizeof(Pixel);
+		const int maxGatherOffset = static_cast<int>(srcWidth * sizeof(Pixel)) - 4;
+		int prevSrcY = 0;
+		for (DWORD y = top; y < bottom; ++y)
+		{
+			BYTE* dstRow = dst + y * dstPitch;
+			const int srcY = (offsetY + static_cast<int>(y) * deltaY) >> 16;
+			if (y != top && srcY == prevSrcY)
+			{
+				memcpy(dstRow, dstRow - dstPitch, dstByteWidth);
+				continue;
+			}
+
+			const BYTE* srcRow = src + srcY * static_cast<int>(srcPitch);
+			stretchRowFunc(reinterpret_cast<Pixel*>(dstRow), srcRow, srcOffsets, dstWidth, maxGatherOffset);
+			prevSrcY = srcY;
+		}
+	}
+
+	DDCOLORKEY getColorKey(const DDCOLORKEY* colorKey)
+	{
+		if (!colorKey)
+		{
+			return {};
+		}
+		return { colorKey->dwColorSpaceLowValue & 0x00FFFFFF, colorKey->dwColorSpaceHighValue & 0x00FFFFFF };
+	}
+
+	bool isColorKeyRange(const DDCOLORKEY* colorKey)
+	{
+		return colorKey &&
+			0 != ((colorKey->dwColorSpaceLowValue ^ colorKey->dwColorSpaceHighValue) & 0x00FFFFFF);
+	}
+
+	DDCOLORKEY toColorKeyRange(const DWORD* colorKey)
+	{
+		return colorKey ? DDCOLORKEY{ *colorKey, *colorKey } : DDCOLORKEY{};
+	}
+
+	bool doOverlappingBlt(BYTE* dst, DWORD pitch, DWORD dstWidth, DWORD dstHeight,
+		const BYTE* src, LONG srcWidth, LONG srcHeight,
+		DWORD bytesPerPixel, const DDCOLORKEY* dstColorKey, const DDCOLORKEY* srcColorKey)
+	{
+		const bool mirrorLeftRight = srcWidth < 0;
+		const bool mirrorUpDown = srcHeight < 0;
+
+		const DWORD absSrcWidth = mirrorLeftRight ? -srcWidth : srcWidth;
+		const DWORD absSrcHeight = mirrorUpDown ? -srcHeight : srcHeight;
+
+		RECT dstRect = { 0, 0, static_cast<LONG>(dstWidth * bytesPerPixel), static_cast<LONG>(dstHeight) };
+		RECT srcRect = { 0, 0, static_cast<LONG>(absSrcWidth * bytesPerPixel), static_cast<LONG>(absSrcHeight) };
+
+		srcRect.top = (src - dst) / static_cast<LONG>(pitch);
+		srcRect.left = (src - dst) % static_cast<LONG>(pitch);
+		srcRect.bottom += srcRect.top;
+		srcRect.right += srcRect.left;
+
+		LONG rowError = 0;
+		if (src < dst)
+		{
+			rowError = (dstRect.right - srcRect.left > static_cast<LONG>(pitch)) ? 1 : 0;
+		}
+		else
+		{
+			rowError = (srcRect.right - dstRect.left > static_cast<LONG>(pitch)) ? -1 : 0;
+		}
+		srcRect.left += rowError * pitch;
+		srcRect.right += rowError * pitch;
+		srcRect.top -= rowError;
+		srcRect.bottom -= rowError;
+
+		RECT r = {};
+		if (!IntersectRect(&r, &dstRect, &srcRect))
+		{
+			return false;
+		}
+
+		if (!mirrorLeftRight && !mirrorUpDown)
+		{
+			if (EqualRect(&dstRect, &srcRect))
+			{
+				return true;
 			}
 
 			if (dstWidth == absSrcWidth && dstHeight == absSrcHeight && !dstColorKey && !srcColorKey)
 			{
-				if (dst < src)
+				const DWORD dstByteWidth = dstWidth * bytesPerPixel;
+				if (dstByteWidth == pitch)
+				{
+					std::memmove(dst, src, dstHeight * pitch);
+				}
+				else if (dst < src)
 				{
 					for (DWORD y = dstHeight; y != 0; --y)
 					{
-						std::memmove(dst, src, dstWidth * bytesPerPixel);
+						std::memmove(dst, src, dstByteWidth);
 						dst += pitch;
 						src += pitch;
 					}
@@ -560,7 +1483,7 @@ namespace
 					src += (srcHeight - 1) * pitch;
 					for (DWORD y = dstHeight; y != 0; --y)
 					{
-						std::memmove(dst, src, dstWidth * bytesPerPixel);
+						std::memmove(dst, src, dstByteWidth);
 						dst -= pitch;
 						src -= pitch;
 					}
@@ -569,139 +1492,1581 @@ namespace
 			}
 		}
 
-		Compat::ScopedCriticalSection lock(g_overlappingBltCs);
-		static std::vector<BYTE> tmpSurface;
-		const LONG srcByteWidth = absSrcWidth * bytesPerPixel;
-		if (tmpSurface.size() < absSrcHeight * srcByteWidth)
+		const DWORD srcByteWidth = absSrcWidth * bytesPerPixel;
+		const DWORD dstByteWidth = dstWidth * bytesPerPixel;
+		const BYTE* dstEnd = dst + (dstHeight - 1) * pitch + dstByteWidth;
+
+		int deltaY = (absSrcHeight << 16) / dstHeight;
+		int offsetY = deltaY / 2;
+		if (mirrorUpDown)
+		{
+			offsetY += static_cast<int>(dstHeight - 1) * deltaY;
+			deltaY = -deltaY;
+		}
+
+		auto getSrcRow = [&](DWORD y)
+		{
+			return src + ((offsetY + static_cast<int>(y) * deltaY) >> 16) * static_cast<int>(pitch);
+		};
+
+		bool isTopDownSafe = true;
+		bool isBottomUpSafe = true;
+		for (DWORD y = 0; y < dstHeight && (isTopDownSafe || isBottomUpSafe); ++y)
+		{
+			const BYTE* srcRow = getSrcRow(y);
+			if (y > 0 && srcRow + srcByteWidth > dst && srcRow < dst + (y - 1) * pitch + dstByteWidth)
+			{
+				isTopDownSafe = false;
+			}
+			if (y + 1 < dstHeight && srcRow + srcByteWidth > dst + (y + 1) * pitch && srcRow < dstEnd)
+			{
+				isBottomUpSafe = false;
+			}
+		}
+
+		if (isTopDownSafe || isBottomUpSafe)
+		{
+			thread_local std::vector<BYTE> rowBuffer;
+			if (rowBuffer.size() < srcByteWidth)
+			{
+				rowBuffer.resize(srcByteWidth);
+			}
+
+			int deltaX = (absSrcWidth << 16) / dstWidth;
+			int offsetX = deltaX / 2;
+			if (mirrorLeftRight)
+			{
+				offsetX += static_cast<int>(dstWidth - 1) * deltaX;
+				deltaX = -deltaX;
+			}
+			const BYTE* rowSrc = rowBuffer.data() + (offsetX >> 16) * bytesPerPixel;
+			offsetX &= 0x0000FFFF;
+
+			const DDCOLORKEY dstCk = getColorKey(dstColorKey);
+			const DDCOLORKEY srcCk = getColorKey(srcColorKey);
+			auto vectorizedBltFunc = lookupVectorizedBltFunc(bytesPerPixel, dstWidth,
+				dstWidth != absSrcWidth, mirrorLeftRight, nullptr != dstColorKey, nullptr != srcColorKey,
+				isColorKeyRange(dstColorKey) || isColorKeyRange(srcColorKey));
+
+			for (DWORD i = 0; i < dstHeight; ++i)
+			{
+				const DWORD y = isTopDownSafe ? i : dstHeight - 1 - i;
+				memcpy(rowBuffer.data(), getSrcRow(y), srcByteWidth);
+				vectorizedBltFunc(dst + y * pitch, pitch, dstWidth, 1,
+					rowSrc, srcByteWidth, offsetX, deltaX, 0x8000, 0x10000, dstCk, srcCk);
+			}
+			return true;
+		}
+
+		thread_local std::vector<BYTE> tmpSurface;
+		if (tmpSurface.size() < absSrcHeight * srcByteWidth)
+		{
+			tmpSurface.resize(absSrcHeight * srcByteWidth);
+		}
+		BYTE* tmp = tmpSurface.data();
+
+		auto vectorizedBltFunc = g_vectorizedBltFuncs[0]
+			[(srcByteWidth >= 2) + (srcByteWidth >= 4) + (srcByteWidth >= 8) + (srcByteWidth >= 16)][0][0][0][0][0];
+
+		vectorizedBltFunc(tmp, srcByteWidth, srcByteWidth, absSrcHeight,
+			src, pitch, 0x8000, 0x10000, 0x8000, 0x10000, {}, {});
+
+		blt(dst, pitch, dstWidth, dstHeight,
+			tmp, srcByteWidth, srcWidth, srcHeight,
+			bytesPerPixel, dstColorKey, srcColorKey);
+
+		return true;
+	}
+
+	void blt(BYTE* dst, DWORD dstPitch, DWORD dstWidth, DWORD dstHeight,
+		const BYTE* src, DWORD srcPitch, LONG srcWidth, LONG srcHeight,
+		DWORD bytesPerPixel, const DDCOLORKEY* dstColorKey, const DDCOLORKEY* srcColorKey)
+	{
+		const bool mirrorLeftRight = srcWidth < 0;
+		const bool mirrorUpDown = srcHeight < 0;
+		const DWORD absSrcWidth = mirrorLeftRight ? -srcWidth : srcWidth;
+		const DWORD absSrcHeight = mirrorUpDown ? -srcHeight : srcHeight;
+
+		if (dstPitch == srcPitch)
+		{
+			const BYTE* dstEnd = dst + (dstHeight - 1) * dstPitch + dstWidth * bytesPerPixel;
+			const BYTE* srcEnd = src + (absSrcHeight - 1) * srcPitch + absSrcWidth * bytesPerPixel;
+
+			if (dst < src ? dstEnd > src : srcEnd > dst)
+			{
+				if (doOverlappingBlt(dst, dstPitch, dstWidth, dstHeight,
+					src, srcWidth, srcHeight, bytesPerPixel, dstColorKey, srcColorKey))
+				{
+					return;
+				}
+			}
+		}
+
+		int deltaX = (absSrcWidth << 16) / dstWidth;
+		int deltaY = (absSrcHeight << 16) / dstHeight;
+
+		int offsetX = deltaX / 2;
+		int offsetY = deltaY / 2;
+
+		if (mirrorLeftRight)
+		{
+			offsetX += static_cast<int>(dstWidth - 1) * deltaX;
+			deltaX = -deltaX;
+		}
+		if (mirrorUpDown)
+		{
+			offsetY += static_cast<int>(dstHeight - 1) * deltaY;
+			deltaY = -deltaY;
+		}
+
+		// Integer upscales use the pixel duplication kernels at every bpp. Otherwise the offset table only
+		// beats the vector kernels when upscaling narrow pixels.
+		const DWORD upscaleFactor = !mirrorLeftRight && dstWidth > absSrcWidth && 0 == dstWidth % absSrcWidth &&
+			dstWidth <= 0x7FFF ? dstWidth / absSrcWidth : 0;
+		if ((0 != upscaleFactor || (dstWidth > absSrcWidth && bytesPerPixel <= 2)) && !dstColorKey && !srcColorKey &&
+			dstWidth * bytesPerPixel * dstHeight < g_minStreamingBltSize)
+		{
+			decltype(&stretchBltRows<BYTE>) stretchBltRowsFunc = nullptr;
+			switch (bytesPerPixel)
+			{
+			case 1: stretchBltRowsFunc = &stretchBltRows<BYTE>; break;
+			case 2: stretchBltRowsFunc = &stretchBltRows<WORD>; break;
+			case 3: stretchBltRowsFunc = &stretchBltRows<UInt24>; break;
+			default: stretchBltRowsFunc = &stretchBltRows<DWORD>; break;
+			}
+
+			const int* srcOffsets = getStretchTable(absSrcWidth, dstWidth, mirrorLeftRight, bytesPerPixel);
+			execBanded(dstHeight, dstWidth * bytesPerPixel * dstHeight, [&](DWORD top, DWORD bottom)
+				{
+					stretchBltRowsFunc(dst, dstPitch, dstWidth, top, bottom, src, srcPitch, absSrcWidth, srcOffsets,
+						offsetY, deltaY, upscaleFactor);
+				});
+			return;
+		}
+
+		src += (offsetY >> 16) * srcPitch + (offsetX >> 16) * bytesPerPixel;
+		offsetX &= 0x0000FFFF;
+		offsetY &= 0x0000FFFF;
+
+		const DDCOLORKEY dstCk = getColorKey(dstColorKey);
+		const DDCOLORKEY srcCk = getColorKey(srcColorKey);
+		const bool useColorKeyRange = isColorKeyRange(dstColorKey) || isColorKeyRange(srcColorKey);
+		const DWORD dstByteWidth = dstWidth * bytesPerPixel;
+
+		auto vectorizedBltFunc = lookupVectorizedBltFunc(bytesPerPixel, dstWidth,
+			dstWidth != absSrcWidth, mirrorLeftRight,
+			nullptr != dstColorKey, nullptr != srcColorKey, useColorKeyRange);
+
+		if (!dstColorKey && !srcColorKey && dstByteWidth * dstHeight >= g_minStreamingBltSize)
+		{
+			const bool resample = dstWidth != absSrcWidth || mirrorLeftRight;
+			const BYTE* srcRowStart = mirrorLeftRight ? src - (absSrcWidth - 1) * bytesPerPixel : src;
+			execBanded(dstHeight, dstByteWidth * dstHeight, [&](DWORD top, DWORD bottom)
+				{
+					streamingBltRows(dst, dstPitch, dstWidth, top, bottom, src, srcPitch, srcRowStart,
+						absSrcWidth * bytesPerPixel, offsetX, deltaX, offsetY, deltaY, bytesPerPixel,
+						vectorizedBltFunc, resample);
+				});
+			return;
+		}
+
+		execBanded(dstHeight, dstByteWidth * dstHeight, [&](DWORD top, DWORD bottom)
+			{
+				vectorizedBltFunc(dst + top * dstPitch, dstPitch, dstWidth, bottom - top,
+					src, srcPitch, offsetX, deltaX, offsetY + static_cast<int>(top) * deltaY, deltaY, dstCk, srcCk);
+			});
+	}
+
+	struct ClippedBlt
+	{
+		RECT rect;
+		decltype(&vectorizedBltFunc<Sse2, BYTE, 1, false, false, false, false, false>) vectorizedBltFunc;
+	};
+
+	void bltClipped(BYTE* dst, DWORD dstPitch, DWORD dstWidth, DWORD dstHeight,
+		const BYTE* src, DWORD srcPitch, LONG srcWidth, LONG srcHeight,
+		DWORD bytesPerPixel, const DDCOLORKEY* dstColorKey, const DDCOLORKEY* srcColorKey,
+		const RECT* clipRects, DWORD clipRectCount)
+	{
+		const bool mirrorLeftRight = srcWidth < 0;
+		const bool mirrorUpDown = srcHeight < 0;
+		const DWORD absSrcWidth = mirrorLeftRight ? -srcWidth : srcWidth;
+		const DWORD absSrcHeight = mirrorUpDown ? -srcHeight : srcHeight;
+
+		if (dstPitch == srcPitch)
+		{
+			const BYTE* dstEnd = dst + (dstHeight - 1) * dstPitch + dstWidth * bytesPerPixel;
+			const BYTE* srcEnd = src + (absSrcHeight - 1) * srcPitch + absSrcWidth * bytesPerPixel;
+
+			if (dst < src ? dstEnd > src : srcEnd > dst)
+			{
+				thread_local std::vector<BYTE> tmpSurface;
+				const DWORD srcByteWidth = absSrcWidth * bytesPerPixel;
+				if (tmpSurface.size() < absSrcHeight * srcByteWidth)
+				{
+					tmpSurface.resize(absSrcHeight * srcByteWidth);
+				}
+
+				BYTE* tmp = tmpSurface.data();
+				for (DWORD y = 0; y < absSrcHeight; ++y)
+				{
+					memcpy(tmp + y * srcByteWidth, src + y * srcPitch, srcByteWidth);
+				}
+
+				bltClipped(dst, dstPitch, dstWidth, dstHeight, tmp, srcByteWidth, srcWidth, srcHeight,
+					bytesPerPixel, dstColorKey, srcColorKey, clipRects, clipRectCount);
+				return;
+			}
+		}
+
+		int deltaX = (absSrcWidth << 16) / dstWidth;
+		int deltaY = (absSrcHeight << 16) / dstHeight;
+
+		int offsetX = deltaX / 2;
+		int offsetY = deltaY / 2;
+
+		if (mirrorLeftRight)
+		{
+			offsetX += static_cast<int>(dstWidth - 1) * deltaX;
+			deltaX = -deltaX;
+		}
+		if (mirrorUpDown)
+		{
+			offsetY += static_cast<int>(dstHeight - 1) * deltaY;
+			deltaY = -deltaY;
+		}
+
+		const DDCOLORKEY dstCk = getColorKey(dstColorKey);
+		const DDCOLORKEY srcCk = getColorKey(srcColorKey);
+		const bool useColorKeyRange = isColorKeyRange(dstColorKey) || isColorKeyRange(srcColorKey);
+		const RECT bounds = { 0, 0, static_cast<LONG>(dstWidth), static_cast<LONG>(dstHeight) };
+
+		std::vector<ClippedBlt> clippedBlts;
+		clippedBlts.reserve(clipRectCount);
+		DWORD byteCount = 0;
+		for (DWORD i = 0; i < clipRectCount; ++i)
+		{
+			ClippedBlt clippedBlt = {};
+			if (IntersectRect(&clippedBlt.rect, &clipRects[i], &bounds))
+			{
+				const DWORD width = clippedBlt.rect.right - clippedBlt.rect.left;
+				clippedBlt.vectorizedBltFunc = lookupVectorizedBltFunc(bytesPerPixel, width, dstWidth != absSrcWidth,
+					mirrorLeftRight, nullptr != dstColorKey, nullptr != srcColorKey, useColorKeyRange);
+				clippedBlts.push_back(clippedBlt);
+				byteCount += width * bytesPerPixel * (clippedBlt.rect.bottom - clippedBlt.rect.top);
+			}
+		}
+
+		if (clippedBlts.empty())
+		{
+			return;
+		}
+
+		execBanded(dstHeight, byteCount, [&](DWORD top, DWORD bottom)
+			{
+				for (const auto& clippedBlt : clippedBlts)
+				{
+					const LONG clipTop = std::max<LONG>(clippedBlt.rect.top, top);
+					const LONG clipBottom = std::min<LONG>(clippedBlt.rect.bottom, bottom);
+					if (clipTop >= clipBottom)
+					{
+						continue;
+					}
+
+					const int clipOffsetX = offsetX + clippedBlt.rect.left * deltaX;
+					const int clipOffsetY = offsetY + clipTop * deltaY;
+					clippedBlt.vectorizedBltFunc(
+						dst + clipTop * dstPitch + clippedBlt.rect.left * bytesPerPixel, dstPitch,
+						clippedBlt.rect.right - clippedBlt.rect.left, clipBottom - clipTop,
+						src + (clipOffsetY >> 16) * static_cast<int>(srcPitch) + (clipOffsetX >> 16) * static_cast<int>(bytesPerPixel),
+						srcPitch, clipOffsetX & 0x0000FFFF, deltaX, clipOffsetY & 0x0000FFFF, deltaY, dstCk, srcCk);
+				}
+			});
+	}
+
+	template <typename Pixel>
+	void colorFill(BYTE* dst, DWORD dstPitch, DWORD dstWidth, DWORD dstHeight, DWORD color)
+	{
+		DWORD c = 0;
+		memset(&c, color, sizeof(Pixel));
+		if (c == color)
+		{
+			for (DWORD i = dstHeight; i != 0; --i)
+			{
+				memset(dst, color, dstWidth * sizeof(Pixel));
+				dst += dstPitch;
+			}
+			return;
+		}
+
+		for (DWORD i = 0; i < dstWidth; ++i)
+		{
+			reinterpret_cast<Pixel*>(dst)[i] = static_cast<Pixel>(color);
+		}
+
+		for (DWORD i = dstHeight - 1; i != 0; --i)
+		{
+			memcpy(dst + dstPitch, dst, dstWidth * sizeof(Pixel));
+			dst += dstPitch;
+		}
+	}
+
+	template <typename Pixel>
+	void streamingColorFill(BYTE* dst, DWORD dstPitch, DWORD dstWidth, DWORD dstHeight, DWORD color)
+	{
+		colorFill<Pixel>(dst, dstPitch, dstWidth, 1, color);
+		for (DWORD i = 1; i < dstHeight; ++i)
+		{
+			streamRow(dst + i * dstPitch, dst, dstWidth * sizeof(Pixel));
+		}
+		_mm_sfence();
+	}
+
+	struct FilterCoord
+	{
+		DWORD pos;
+		DWORD weight;
+	};
+
+	struct FilterColumn
+	{
+		DWORD pos;
+		WORD weights[8];
+	};
+
+	void getFilterCoords(std::vector<FilterCoord>& coords, DWORD dstSize, DWORD srcSize,
+		DDraw::Blitter::Filter filter)
+	{
+		coords.resize(dstSize);
+		const int scale = std::max<int>(1, dstSize / srcSize);
+		const int regionRange = 0x8000 - 0x8000 / scale;
+		const int maxPos = (srcSize - 1) << 16;
+
+		for (DWORD i = 0; i < dstSize; ++i)
+		{
+			int pos = static_cast<int>((static_cast<long long>(2 * i + 1) * srcSize << 16) / (2 * dstSize));
+			if (DDraw::Blitter::FILTER_SHARP_BILINEAR == filter)
+			{
+				const int centerDist = (pos & 0xFFFF) - 0x8000;
+				const int clampedCenterDist = std::min<int>(std::max<int>(centerDist, -regionRange), regionRange);
+				pos = (pos & ~0xFFFF) + (centerDist - clampedCenterDist) * scale + 0x8000;
+			}
+			pos = std::min<int>(std::max<int>(pos - 0x8000, 0), maxPos);
+			coords[i].pos = pos >> 16;
+			coords[i].weight = (pos >> 8) & 0xFF;
+		}
+	}
+
+	__forceinline DWORD lerpPixel(DWORD a, DWORD b, DWORD weight)
+	{
+		DWORD result = 0;
+		for (int shift = 0; shift < 32; shift += 8)
+		{
+			const DWORD ca = (a >> shift) & 0xFF;
+			const DWORD cb = (b >> shift) & 0xFF;
+			result |= ((ca * (256 - weight) + cb * weight + 128) >> 8) << shift;
+		}
+		return result;
+	}
+
+	__forceinline __m128i lerpChannels(__m128i a, __m128i b, __m128i weightA, __m128i weightB)
+	{
+		__m128i sum = _mm_add_epi16(_mm_mullo_epi16(a, weightA), _mm_mullo_epi16(b, weightB));
+		return _mm_srli_epi16(_mm_add_epi16(sum, _mm_set1_epi16(128)), 8);
+	}
+
+	void lerpRows(DWORD* dst, const DWORD* src0, const DWORD* src1, DWORD width, DWORD weight)
+	{
+		if (0 == weight)
+		{
+			memcpy(dst, src0, width * 4);
+			return;
+		}
+
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i weight0 = _mm_set1_epi16(static_cast<short>(256 - weight));
+		const __m128i weight1 = _mm_set1_epi16(static_cast<short>(weight));
+
+		DWORD i = 0;
+		for (; i + 4 <= width; i += 4)
+		{
+			__m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src0 + i));
+			__m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src1 + i));
+			__m128i lo = lerpChannels(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero), weight0, weight1);
+			__m128i hi = lerpChannels(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero), weight0, weight1);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi16(lo, hi));
+		}
+
+		for (; i < width; ++i)
+		{
+			dst[i] = lerpPixel(src0[i], src1[i], weight);
+		}
+	}
+
+	__forceinline __m128i lerpColumnPair(const DWORD* src, const FilterColumn& column)
+	{
+		__m128i pixels = _mm_unpacklo_epi8(
+			_mm_loadl_epi64(reinterpret_cast<const __m128i*>(src + column.pos)), _mm_setzero_si128());
+		return _mm_mullo_epi16(pixels, _mm_loadu_si128(reinterpret_cast<const __m128i*>(column.weights)));
+	}
+
+	__forceinline __m128i lerpColumns(const DWORD* src, const FilterColumn* columns)
+	{
+		__m128i a = lerpColumnPair(src, columns[0]);
+		__m128i b = lerpColumnPair(src, columns[1]);
+		__m128i sum = _mm_add_epi16(_mm_unpacklo_epi64(a, b), _mm_unpackhi_epi64(a, b));
+		return _mm_srli_epi16(_mm_add_epi16(sum, _mm_set1_epi16(128)), 8);
+	}
+
+	void lerpColumns(DWORD* dst, const DWORD* src, const FilterColumn* columns, DWORD width)
+	{
+		DWORD i = 0;
+		for (; i + 4 <= width; i += 4)
+		{
+			__m128i lo = lerpColumns(src, columns + i);
+			__m128i hi = lerpColumns(src, columns + i + 2);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi16(lo, hi));
+		}
+
+		for (; i < width; ++i)
+		{
+			dst[i] = lerpPixel(src[columns[i].pos], src[columns[i].pos + 1], columns[i].weights[4]);
+		}
+	}
+
+	__forceinline __m128i expandChannel(__m128i vec, BYTE bitCount, BYTE pos)
+	{
+		if (0 == bitCount)
+		{
+			return _mm_setzero_si128();
+		}
+
+		__m128i channel = _mm_and_si128(_mm_srl_epi16(vec, _mm_cvtsi32_si128(pos)),
+			_mm_set1_epi16(static_cast<short>((1 << bitCount) - 1)));
+		__m128i result = _mm_setzero_si128();
+		for (int shift = 8 - bitCount; shift > -bitCount; shift -= bitCount)
+		{
+			result = _mm_or_si128(result, shift >= 0
+				? _mm_sll_epi16(channel, _mm_cvtsi32_si128(shift))
+				: _mm_srl_epi16(channel, _mm_cvtsi32_si128(-shift)));
+		}
+		return result;
+	}
+
+	__forceinline DWORD expandChannel(DWORD pixel, BYTE bitCount, BYTE pos)
+	{
+		if (0 == bitCount)
+		{
+			return 0;
+		}
+
+		const DWORD channel = (pixel >> pos) & ((1 << bitCount) - 1);
+		DWORD result = 0;
+		for (int shift = 8 - bitCount; shift > -bitCount; shift -= bitCount)
+		{
+			result |= shift >= 0 ? channel << shift : channel >> -shift;
+		}
+		return result;
+	}
+
+	void expandRow(DWORD* dst, const WORD* src, DWORD width, const D3dDdi::FormatInfo& fi)
+	{
+		DWORD i = 0;
+		for (; i + 8 <= width; i += 8)
+		{
+			__m128i vec = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+			__m128i bg = _mm_or_si128(expandChannel(vec, fi.blueBitCount, fi.bluePos),
+				_mm_slli_epi16(expandChannel(vec, fi.greenBitCount, fi.greenPos), 8));
+			__m128i ra = _mm_or_si128(expandChannel(vec, fi.redBitCount, fi.redPos),
+				_mm_slli_epi16(expandChannel(vec, fi.alphaBitCount, fi.alphaPos), 8));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_unpacklo_epi16(bg, ra));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 4), _mm_unpackhi_epi16(bg, ra));
+		}
+
+		for (; i < width; ++i)
+		{
+			dst[i] = expandChannel(src[i], fi.blueBitCount, fi.bluePos) |
+				(expandChannel(src[i], fi.greenBitCount, fi.greenPos) << 8) |
+				(expandChannel(src[i], fi.redBitCount, fi.redPos) << 16) |
+				(expandChannel(src[i], fi.alphaBitCount, fi.alphaPos) << 24);
+		}
+	}
+
+	__forceinline __m128i packChannel(__m128i vec, int shift, BYTE bitCount, BYTE pos)
+	{
+		if (0 == bitCount)
+		{
+			return _mm_setzero_si128();
+		}
+
+		__m128i channel = _mm_and_si128(_mm_srl_epi32(vec, _mm_cvtsi32_si128(shift)), _mm_set1_epi32(0xFF));
+		return _mm_sll_epi32(_mm_srl_epi32(channel, _mm_cvtsi32_si128(8 - bitCount)), _mm_cvtsi32_si128(pos));
+	}
+
+	__forceinline __m128i packPixels(__m128i vec, const D3dDdi::FormatInfo& fi)
+	{
+		vec = _mm_or_si128(
+			_mm_or_si128(packChannel(vec, 0, fi.blueBitCount, fi.bluePos), packChannel(vec, 8, fi.greenBitCount, fi.greenPos)),
+			_mm_or_si128(packChannel(vec, 16, fi.redBitCount, fi.redPos), packChannel(vec, 24, fi.alphaBitCount, fi.alphaPos)));
+		return _mm_srai_epi32(_mm_slli_epi32(vec, 16), 16);
+	}
+
+	__forceinline DWORD packChannel(DWORD pixel, int shift, BYTE bitCount, BYTE pos)
+	{
+		return 0 == bitCount ? 0 : (((pixel >> shift) & 0xFF) >> (8 - bitCount)) << pos;
+	}
+
+	void packRow(WORD* dst, const DWORD* src, DWORD width, const D3dDdi::FormatInfo& fi)
+	{
+		DWORD i = 0;
+		for (; i + 8 <= width; i += 8)
+		{
+			__m128i lo = packPixels(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)), fi);
+			__m128i hi = packPixels(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 4)), fi);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packs_epi32(lo, hi));
+		}
+
+		for (; i < width; ++i)
+		{
+			dst[i] = static_cast<WORD>(packChannel(src[i], 0, fi.blueBitCount, fi.bluePos) |
+				packChannel(src[i], 8, fi.greenBitCount, fi.greenPos) |
+				packChannel(src[i], 16, fi.redBitCount, fi.redPos) |
+				packChannel(src[i], 24, fi.alphaBitCount, fi.alphaPos));
+		}
+	}
+
+	void filteredBltRows(BYTE* dst, DWORD dstPitch, DWORD dstWidth, DWORD top, DWORD bottom,
+		const BYTE* src, DWORD srcPitch, DWORD srcWidth, DWORD srcHeight, const D3dDdi::FormatInfo& formatInfo,
+		const std::vector<FilterColumn>& columns, const std::vector<FilterCoord>& rows)
+	{
+		thread_local std::vector<DWORD> srcRowBuffer;
+		thread_local std::vector<DWORD> rowBuffer;
+		thread_local std::vector<DWORD> dstRowBuffer;
+
+		const bool is16Bit = 2 == formatInfo.bytesPerPixel;
+		rowBuffer.resize(srcWidth + 1);
+		if (is16Bit)
+		{
+			srcRowBuffer.resize(2 * srcWidth);
+			dstRowBuffer.resize(dstWidth);
+		}
+
+		for (DWORD y = top; y < bottom; ++y)
+		{
+			const BYTE* srcRow0 = src + rows[y].pos * srcPitch;
+			const BYTE* srcRow1 = src + std::min<DWORD>(rows[y].pos + 1, srcHeight - 1) * srcPitch;
+			if (is16Bit)
+			{
+				expandRow(srcRowBuffer.data(), reinterpret_cast<const WORD*>(srcRow0), srcWidth, formatInfo);
+				if (0 != rows[y].weight)
+				{
+					expandRow(srcRowBuffer.data() + srcWidth, reinterpret_cast<const WORD*>(srcRow1), srcWidth, formatInfo);
+				}
+				srcRow0 = reinterpret_cast<const BYTE*>(srcRowBuffer.data());
+				srcRow1 = reinterpret_cast<const BYTE*>(srcRowBuffer.data() + srcWidth);
+			}
+
+			lerpRows(rowBuffer.data(), reinterpret_cast<const DWORD*>(srcRow0), reinterpret_cast<const DWORD*>(srcRow1),
+				srcWidth, rows[y].weight);
+			rowBuffer[srcWidth] = rowBuffer[srcWidth - 1];
+
+			BYTE* dstRow = dst + y * dstPitch;
+			if (is16Bit)
+			{
+				lerpColumns(dstRowBuffer.data(), rowBuffer.data(), columns.data(), dstWidth);
+				packRow(reinterpret_cast<WORD*>(dstRow), dstRowBuffer.data(), dstWidth, formatInfo);
+			}
+			else
+			{
+				lerpColumns(reinterpret_cast<DWORD*>(dstRow), rowBuffer.data(), columns.data(), dstWidth);
+			}
+		}
+	}
+	bool isArgb8888Layout(const D3dDdi::FormatInfo& fi)
+	{
+		return 8 == fi.redBitCount && 16 == fi.redPos &&
+			8 == fi.greenBitCount && 8 == fi.greenPos &&
+			8 == fi.blueBitCount && 0 == fi.bluePos &&
+			(0 == fi.alphaBitCount || (8 == fi.alphaBitCount && 24 == fi.alphaPos));
+	}
+
+	bool isRgb565Layout(const D3dDdi::FormatInfo& fi)
+	{
+		return 2 == fi.bytesPerPixel && 0 == fi.alphaBitCount &&
+			5 == fi.redBitCount && 11 == fi.redPos &&
+			6 == fi.greenBitCount && 5 == fi.greenPos &&
+			5 == fi.blueBitCount && 0 == fi.bluePos;
+	}
+
+	bool isRgb555Layout(const D3dDdi::FormatInfo& fi)
+	{
+		return 2 == fi.bytesPerPixel && (0 == fi.alphaBitCount || (1 == fi.alphaBitCount && 15 == fi.alphaPos)) &&
+			5 == fi.redBitCount && 10 == fi.redPos &&
+			5 == fi.greenBitCount && 5 == fi.greenPos &&
+			5 == fi.blueBitCount && 0 == fi.bluePos;
+	}
+
+	DWORD getOpaqueAlpha(const D3dDdi::FormatInfo& fi)
+	{
+		return 0 == fi.alphaBitCount ? 0 : ((1 << fi.alphaBitCount) - 1) << fi.alphaPos;
+	}
+
+	__forceinline __m128i expandChannel32(__m128i vec, BYTE bitCount, BYTE pos, int shift)
+	{
+		if (0 == bitCount)
+		{
+			return _mm_setzero_si128();
+		}
+
+		__m128i channel = _mm_and_si128(_mm_srl_epi32(vec, _mm_cvtsi32_si128(pos)), _mm_set1_epi32((1 << bitCount) - 1));
+		__m128i result = _mm_setzero_si128();
+		for (int s = 8 - bitCount; s > -bitCount; s -= bitCount)
+		{
+			result = _mm_or_si128(result, s >= 0
+				? _mm_sll_epi32(channel, _mm_cvtsi32_si128(s))
+				: _mm_srl_epi32(channel, _mm_cvtsi32_si128(-s)));
+		}
+		return _mm_sll_epi32(result, _mm_cvtsi32_si128(shift));
+	}
+
+	__forceinline DWORD expandPixel(DWORD pixel, const D3dDdi::FormatInfo& fi)
+	{
+		return expandChannel(pixel, fi.blueBitCount, fi.bluePos) |
+			(expandChannel(pixel, fi.greenBitCount, fi.greenPos) << 8) |
+			(expandChannel(pixel, fi.redBitCount, fi.redPos) << 16) |
+			(expandChannel(pixel, fi.alphaBitCount, fi.alphaPos) << 24);
+	}
+
+	__forceinline DWORD packPixel(DWORD pixel, const D3dDdi::FormatInfo& fi)
+	{
+		return packChannel(pixel, 0, fi.blueBitCount, fi.bluePos) |
+			packChannel(pixel, 8, fi.greenBitCount, fi.greenPos) |
+			packChannel(pixel, 16, fi.redBitCount, fi.redPos) |
+			packChannel(pixel, 24, fi.alphaBitCount, fi.alphaPos);
+	}
+
+	void orRow(DWORD* dst, DWORD width, DWORD value)
+	{
+		const __m128i valueVec = _mm_set1_epi32(value);
+		DWORD i = 0;
+		for (; i + 4 <= width; i += 4)
+		{
+			__m128i* p = reinterpret_cast<__m128i*>(dst + i);
+			_mm_storeu_si128(p, _mm_or_si128(_mm_loadu_si128(p), valueVec));
+		}
+
+		for (; i < width; ++i)
+		{
+			dst[i] |= value;
+		}
+	}
+
+	void convertRow565To555(WORD* dst, const WORD* src, DWORD width, WORD alpha)
+	{
+		const __m128i rgMask = _mm_set1_epi16(0x7FE0);
+		const __m128i bMask = _mm_set1_epi16(0x001F);
+		const __m128i alphaVec = _mm_set1_epi16(alpha);
+		DWORD i = 0;
+		for (; i + 8 <= width; i += 8)
+		{
+			__m128i vec = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+			vec = _mm_or_si128(
+				_mm_or_si128(_mm_and_si128(_mm_srli_epi16(vec, 1), rgMask), _mm_and_si128(vec, bMask)),
+				alphaVec);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), vec);
+		}
+
+		for (; i < width; ++i)
+		{
+			dst[i] = static_cast<WORD>(((src[i] >> 1) & 0x7FE0) | (src[i] & 0x001F) | alpha);
+		}
+	}
+
+	void convertRow555To565(WORD* dst, const WORD* src, DWORD width)
+	{
+		const __m128i rgMask = _mm_set1_epi16(static_cast<short>(0xFFC0));
+		const __m128i gLowMask = _mm_set1_epi16(0x0020);
+		const __m128i bMask = _mm_set1_epi16(0x001F);
+		DWORD i = 0;
+		for (; i + 8 <= width; i += 8)
+		{
+			__m128i vec = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+			vec = _mm_or_si128(
+				_mm_or_si128(_mm_and_si128(_mm_slli_epi16(vec, 1), rgMask), _mm_and_si128(_mm_srli_epi16(vec, 4), gLowMask)),
+				_mm_and_si128(vec, bMask));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), vec);
+		}
+
+		for (; i < width; ++i)
+		{
+			dst[i] = static_cast<WORD>(((src[i] << 1) & 0xFFC0) | ((src[i] >> 4) & 0x0020) | (src[i] & 0x001F));
+		}
+	}
+
+	void convertRowToArgb(DWORD* dst, const BYTE* src, DWORD width, const D3dDdi::FormatInfo& fi)
+	{
+		const DWORD alpha = 0 == fi.alphaBitCount ? 0xFF000000 : 0;
+		switch (fi.bytesPerPixel)
+		{
+		case 2:
+			expandRow(dst, reinterpret_cast<const WORD*>(src), width, fi);
+			break;
+
+		case 3:
+			for (DWORD i = 0; i < width; ++i)
+			{
+				const BYTE* p = src + i * 3;
+				dst[i] = expandPixel(p[0] | (p[1] << 8) | (p[2] << 16), fi);
+			}
+			break;
+
+		case 4:
+			if (isArgb8888Layout(fi))
+			{
+				memcpy(dst, src, width * 4);
+				break;
+			}
+
+			{
+				DWORD i = 0;
+				for (; i + 4 <= width; i += 4)
+				{
+					__m128i vec = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 4));
+					vec = _mm_or_si128(
+						_mm_or_si128(expandChannel32(vec, fi.blueBitCount, fi.bluePos, 0),
+							expandChannel32(vec, fi.greenBitCount, fi.greenPos, 8)),
+						_mm_or_si128(expandChannel32(vec, fi.redBitCount, fi.redPos, 16),
+							expandChannel32(vec, fi.alphaBitCount, fi.alphaPos, 24)));
+					_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), vec);
+				}
+
+				for (; i < width; ++i)
+				{
+					dst[i] = expandPixel(reinterpret_cast<const DWORD*>(src)[i], fi);
+				}
+			}
+			break;
+		}
+
+		if (0 != alpha)
+		{
+			orRow(dst, width, alpha);
+		}
+	}
+
+	void convertRowFromArgb(BYTE* dst, const DWORD* src, DWORD width, const D3dDdi::FormatInfo& fi)
+	{
+		switch (fi.bytesPerPixel)
+		{
+		case 2:
+			packRow(reinterpret_cast<WORD*>(dst), src, width, fi);
+			break;
+
+		case 3:
+			for (DWORD i = 0; i < width; ++i)
+			{
+				const DWORD pixel = packPixel(src[i], fi);
+				memcpy(dst + i * 3, &pixel, 3);
+			}
+			break;
+
+		case 4:
+			if (isArgb8888Layout(fi))
+			{
+				memcpy(dst, src, width * 4);
+				break;
+			}
+
+			{
+				DWORD i = 0;
+				for (; i + 4 <= width; i += 4)
+				{
+					__m128i vec = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+					vec = _mm_or_si128(
+						_mm_or_si128(packChannel(vec, 0, fi.blueBitCount, fi.bluePos), packChannel(vec, 8, fi.greenBitCount, fi.greenPos)),
+						_mm_or_si128(packChannel(vec, 16, fi.redBitCount, fi.redPos), packChannel(vec, 24, fi.alphaBitCount, fi.alphaPos)));
+					_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 4), vec);
+				}
+
+				for (; i < width; ++i)
+				{
+					reinterpret_cast<DWORD*>(dst)[i] = packPixel(src[i], fi);
+				}
+			}
+			break;
+		}
+	}
+
+	void convertRow(BYTE* dst, const D3dDdi::FormatInfo& dstFormatInfo,
+		const BYTE* src, const D3dDdi::FormatInfo& srcFormatInfo, DWORD width)
+	{
+		thread_local std::vector<DWORD> argbRowBuffer;
+
+		if (isRgb565Layout(srcFormatInfo) && isRgb555Layout(dstFormatInfo))
+		{
+			convertRow565To555(reinterpret_cast<WORD*>(dst), reinterpret_cast<const WORD*>(src), width,
+				static_cast<WORD>(getOpaqueAlpha(dstFormatInfo)));
+			return;
+		}
+
+		if (isRgb555Layout(srcFormatInfo) && isRgb565Layout(dstFormatInfo))
+		{
+			convertRow555To565(reinterpret_cast<WORD*>(dst), reinterpret_cast<const WORD*>(src), width);
+			return;
+		}
+
+		if (4 == dstFormatInfo.bytesPerPixel && isArgb8888Layout(dstFormatInfo))
+		{
+			convertRowToArgb(reinterpret_cast<DWORD*>(dst), src, width, srcFormatInfo);
+			return;
+		}
+
+		DWORD* argbRow = nullptr;
+		if (4 == srcFormatInfo.bytesPerPixel && isArgb8888Layout(srcFormatInfo) && 0 != srcFormatInfo.alphaBitCount)
+		{
+			argbRow = const_cast<DWORD*>(reinterpret_cast<const DWORD*>(src));
+		}
+		else
+		{
+			argbRowBuffer.resize(width);
+			argbRow = argbRowBuffer.data();
+			convertRowToArgb(argbRow, src, width, srcFormatInfo);
+		}
+		convertRowFromArgb(dst, argbRow, width, dstFormatInfo);
+	}
+
+	template <int dstBytesPerPixel, int srcBytesPerPixel>
+	void applySrcColorKey(BYTE* dst, const BYTE* converted, const BYTE* src, DWORD width,
+		const DWORD* dstColorKey, DWORD srcColorKey)
+	{
+		const DWORD dstColorKeyMask = 4 == dstBytesPerPixel ? 0x00FFFFFF : (1 << (dstBytesPerPixel * 8)) - 1;
+		const DWORD srcColorKeyMask = 4 == srcBytesPerPixel ? 0x00FFFFFF : (1 << (srcBytesPerPixel * 8)) - 1;
+		const DWORD dstCk = dstColorKey ? *dstColorKey & dstColorKeyMask : 0;
+		srcColorKey &= srcColorKeyMask;
+
+		for (DWORD i = 0; i < width; ++i)
+		{
+			DWORD s = 0;
+			memcpy(&s, src + i * srcBytesPerPixel, srcBytesPerPixel);
+			if ((s & srcColorKeyMask) == srcColorKey)
+			{
+				continue;
+			}
+
+			BYTE* d = dst + i * dstBytesPerPixel;
+			if (dstColorKey)
+			{
+				DWORD dp = 0;
+				memcpy(&dp, d, dstBytesPerPixel);
+				if ((dp & dstColorKeyMask) != dstCk)
+				{
+					continue;
+				}
+			}
+			memcpy(d, converted + i * dstBytesPerPixel, dstBytesPerPixel);
+		}
+	}
+
+	template <int dstBytesPerPixel>
+	auto getApplySrcColorKeyFunc(DWORD srcBytesPerPixel)
+	{
+		switch (srcBytesPerPixel)
+		{
+		case 2: return &applySrcColorKey<dstBytesPerPixel, 2>;
+		case 3: return &applySrcColorKey<dstBytesPerPixel, 3>;
+		default: return &applySrcColorKey<dstBytesPerPixel, 4>;
+		}
+	}
+
+	auto getApplySrcColorKeyFunc(DWORD dstBytesPerPixel, DWORD srcBytesPerPixel)
+	{
+		switch (dstBytesPerPixel)
+		{
+		case 2: return getApplySrcColorKeyFunc<2>(srcBytesPerPixel);
+		case 3: return getApplySrcColorKeyFunc<3>(srcBytesPerPixel);
+		default: return getApplySrcColorKeyFunc<4>(srcBytesPerPixel);
+		}
+	}
+
+	bool isConvertibleFormat(const D3dDdi::FormatInfo& fi)
+	{
+		return fi.bytesPerPixel >= 2 && fi.bytesPerPixel <= 4 &&
+			0 != fi.redBitCount && 0 != fi.greenBitCount && 0 != fi.blueBitCount &&
+			fi.redBitCount <= 8 && fi.greenBitCount <= 8 && fi.blueBitCount <= 8 && fi.alphaBitCount <= 8;
+	}
+
+	__forceinline __m128i div255(__m128i vec)
+	{
+		vec = _mm_add_epi16(vec, _mm_set1_epi16(128));
+		return _mm_srli_epi16(_mm_add_epi16(vec, _mm_srli_epi16(vec, 8)), 8);
+	}
+
+	template <bool usePixelAlpha>
+	__forceinline __m128i alphaBlendPixels(__m128i dst, __m128i src, __m128i constantAlpha)
+	{
+		__m128i srcAlpha = constantAlpha;
+		if (usePixelAlpha)
+		{
+			srcAlpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(src, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+			srcAlpha = div255(_mm_mullo_epi16(srcAlpha, constantAlpha));
+		}
+		src = div255(_mm_mullo_epi16(src, constantAlpha));
+		dst = div255(_mm_mullo_epi16(dst, _mm_sub_epi16(_mm_set1_epi16(255), srcAlpha)));
+		return _mm_add_epi16(src, dst);
+	}
+
+	template <bool usePixelAlpha>
+	void alphaBlendRow(DWORD* dst, const DWORD* src, DWORD width, BYTE constantAlpha)
+	{
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i ca = _mm_set1_epi16(constantAlpha);
+		DWORD i = 0;
+		for (; i + 4 <= width; i += 4)
+		{
+			__m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+			__m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i));
+			__m128i lo = alphaBlendPixels<usePixelAlpha>(_mm_unpacklo_epi8(d, zero), _mm_unpacklo_epi8(s, zero), ca);
+			__m128i hi = alphaBlendPixels<usePixelAlpha>(_mm_unpackhi_epi8(d, zero), _mm_unpackhi_epi8(s, zero), ca);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi16(lo, hi));
+		}
+
+		for (; i < width; ++i)
+		{
+			__m128i d = _mm_unpacklo_epi8(_mm_cvtsi32_si128(dst[i]), zero);
+			__m128i s = _mm_unpacklo_epi8(_mm_cvtsi32_si128(src[i]), zero);
+			dst[i] = _mm_cvtsi128_si32(_mm_packus_epi16(alphaBlendPixels<usePixelAlpha>(d, s, ca), zero));
+		}
+	}
+
+	void alphaBltRows(BYTE* dst, DWORD dstPitch, const BYTE* src, DWORD srcPitch, DWORD width, DWORD height,
+		const D3dDdi::FormatInfo& formatInfo, BYTE constantAlpha, bool usePixelAlpha)
+	{
+		thread_local std::vector<DWORD> srcRowBuffer;
+		thread_local std::vector<DWORD> dstRowBuffer;
+
+		const bool isArgb = 4 == formatInfo.bytesPerPixel && isArgb8888Layout(formatInfo);
+		if (!isArgb)
+		{
+			srcRowBuffer.resize(width);
+			dstRowBuffer.resize(width);
+		}
+
+		auto blendRow = usePixelAlpha ? &alphaBlendRow<true> : &alphaBlendRow<false>;
+		for (DWORD y = 0; y < height; ++y)
+		{
+			if (isArgb)
+			{
+				blendRow(reinterpret_cast<DWORD*>(dst), reinterpret_cast<const DWORD*>(src), width, constantAlpha);
+			}
+			else
+			{
+				convertRowToArgb(srcRowBuffer.data(), src, width, formatInfo);
+				convertRowToArgb(dstRowBuffer.data(), dst, width, formatInfo);
+				blendRow(dstRowBuffer.data(), srcRowBuffer.data(), width, constantAlpha);
+				convertRowFromArgb(dst, dstRowBuffer.data(), width, formatInfo);
+			}
+			dst += dstPitch;
+			src += srcPitch;
+		}
+	}
+
+	template <DWORD rop>
+	__forceinline __m128i ropVector(__m128i dst, __m128i src)
+	{
+		switch (rop)
 		{
-			tmpSurface.resize(absSrcHeight * srcByteWidth);
+		case SRCAND: return _mm_and_si128(dst, src);
+		case SRCPAINT: return _mm_or_si128(dst, src);
+		case SRCINVERT: return _mm_xor_si128(dst, src);
+		default: return src;
 		}
-		BYTE* tmp = tmpSurface.data();
+	}
 
-		auto vectorizedBltFunc = g_vectorizedBltFuncs[0]
-			[(srcByteWidth >= 2) + (srcByteWidth >= 4) + (srcByteWidth >= 8) + (srcByteWidth >= 16)][0][0][0][0];
+	template <DWORD rop>
+	__forceinline BYTE ropByte(BYTE dst, BYTE src)
+	{
+		switch (rop)
+		{
+		case SRCAND: return dst & src;
+		case SRCPAINT: return dst | src;
+		case SRCINVERT: return dst ^ src;
+		default: return src;
+		}
+	}
 
-		vectorizedBltFunc(tmp, srcByteWidth, srcByteWidth, absSrcHeight,
-			src, pitch, 0x8000, 0x10000, 0x8000, 0x10000, 0, 0);
+	template <DWORD rop>
+	void ropBltRows(BYTE* dst, DWORD dstPitch, const BYTE* src, DWORD srcPitch, DWORD byteWidth, DWORD height)
+	{
+		for (DWORD y = 0; y < height; ++y)
+		{
+			DWORD i = 0;
+			for (; i + 16 <= byteWidth; i += 16)
+			{
+				__m128i* d = reinterpret_cast<__m128i*>(dst + i);
+				_mm_storeu_si128(d, ropVector<rop>(_mm_loadu_si128(d),
+					_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i))));
+			}
 
-		blt(dst, pitch, dstWidth, dstHeight,
-			tmp, srcByteWidth, srcWidth, srcHeight,
-			bytesPerPixel, dstColorKey, srcColorKey);
+			for (; i < byteWidth; ++i)
+			{
+				dst[i] = ropByte<rop>(dst[i], src[i]);
+			}
 
-		return true;
+			dst += dstPitch;
+			src += srcPitch;
+		}
 	}
 
-	void blt(BYTE* dst, DWORD dstPitch, DWORD dstWidth, DWORD dstHeight,
-		const BYTE* src, DWORD srcPitch, LONG srcWidth, LONG srcHeight,
-		DWORD bytesPerPixel, const DWORD* dstColorKey, const DWORD* srcColorKey)
+	void paletteBltRow(DWORD* dst, const BYTE* src, DWORD width, const DWORD* palette)
 	{
-		const bool mirrorLeftRight = srcWidth < 0;
-		const bool mirrorUpDown = srcHeight < 0;
-		const DWORD absSrcWidth = mirrorLeftRight ? -srcWidth : srcWidth;
-		const DWORD absSrcHeight = mirrorUpDown ? -srcHeight : srcHeight;
+		DWORD i = 0;
+		for (; i + 4 <= width; i += 4)
+		{
+			const DWORD indexes = *reinterpret_cast<const DWORD*>(src + i);
+			dst[i] = palette[indexes & 0xFF];
+			dst[i + 1] = palette[(indexes >> 8) & 0xFF];
+			dst[i + 2] = palette[(indexes >> 16) & 0xFF];
+			dst[i + 3] = palette[indexes >> 24];
+		}
 
-		if (dstPitch == srcPitch)
+		for (; i < width; ++i)
 		{
-			const BYTE* dstEnd = dst + (dstHeight - 1) * dstPitch + dstWidth * bytesPerPixel;
-			const BYTE* srcEnd = src + (absSrcHeight - 1) * srcPitch + absSrcWidth * bytesPerPixel;
+			dst[i] = palette[src[i]];
+		}
+	}
 
-			if (dst < src ? dstEnd > src : srcEnd > dst)
-			{
-				if (doOverlappingBlt(dst, dstPitch, dstWidth, dstHeight,
-					src, srcWidth, srcHeight, bytesPerPixel, dstColorKey, srcColorKey))
-				{
-					return;
-				}
-			}
+	void paletteBltRowAvx2(DWORD* dst, const BYTE* src, DWORD width, const DWORD* palette)
+	{
+		DWORD i = 0;
+		for (; i + 16 <= width; i += 16)
+		{
+			__m128i indexes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+			__m256i lo = _mm256_i32gather_epi32(reinterpret_cast<const int*>(palette), _mm256_cvtepu8_epi32(indexes), 4);
+			__m256i hi = _mm256_i32gather_epi32(reinterpret_cast<const int*>(palette),
+				_mm256_cvtepu8_epi32(_mm_srli_si128(indexes, 8)), 4);
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), lo);
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i + 8), hi);
 		}
+		_mm256_zeroupper();
 
-		int deltaX = (absSrcWidth << 16) / dstWidth;
-		int deltaY = (absSrcHeight << 16) / dstHeight;
+		paletteBltRow(dst + i, src + i, width - i, palette);
+	}
 
-		int offsetX = deltaX / 2;
-		int offsetY = deltaY / 2;
+	const auto g_paletteBltRowFunc = isAvx2Supported() ? &paletteBltRowAvx2 : &paletteBltRow;
 
-		if (mirrorLeftRight)
+	void lutBltRow32(DWORD* dst, const DWORD* src, DWORD width, const DWORD (&channelLuts)[3][256])
+	{
+		for (DWORD i = 0; i < width; ++i)
 		{
-			offsetX += static_cast<int>(dstWidth - 1) * deltaX;
-			deltaX = -deltaX;
+			const DWORD pixel = src[i];
+			dst[i] = (pixel & 0xFF000000) | channelLuts[0][pixel & 0xFF] |
+				channelLuts[1][(pixel >> 8) & 0xFF] | channelLuts[2][(pixel >> 16) & 0xFF];
 		}
-		if (mirrorUpDown)
+	}
+
+	void lutBltRow32Avx2(DWORD* dst, const DWORD* src, DWORD width, const DWORD (&channelLuts)[3][256])
+	{
+		const __m256i byteMask = _mm256_set1_epi32(0xFF);
+		DWORD i = 0;
+		for (; i + 8 <= width; i += 8)
 		{
-			offsetY += static_cast<int>(dstHeight - 1) * deltaY;
-			deltaY = -deltaY;
+			const __m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+			__m256i result = _mm256_andnot_si256(_mm256_set1_epi32(0x00FFFFFF), pixels);
+			result = _mm256_or_si256(result, _mm256_i32gather_epi32(reinterpret_cast<const int*>(channelLuts[0]),
+				_mm256_and_si256(pixels, byteMask), 4));
+			result = _mm256_or_si256(result, _mm256_i32gather_epi32(reinterpret_cast<const int*>(channelLuts[1]),
+				_mm256_and_si256(_mm256_srli_epi32(pixels, 8), byteMask), 4));
+			result = _mm256_or_si256(result, _mm256_i32gather_epi32(reinterpret_cast<const int*>(channelLuts[2]),
+				_mm256_and_si256(_mm256_srli_epi32(pixels, 16), byteMask), 4));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), result);
 		}
+		_mm256_zeroupper();
 
-		src += (offsetY >> 16) * srcPitch + (offsetX >> 16) * bytesPerPixel;
-		offsetX &= 0x0000FFFF;
-		offsetY &= 0x0000FFFF;
+		lutBltRow32(dst + i, src + i, width - i, channelLuts);
+	}
 
-		const DWORD dstCk = dstColorKey ? *dstColorKey & 0x00FFFFFF : 0;
-		const DWORD srcCk = srcColorKey ? *srcColorKey & 0x00FFFFFF : 0;
-		const DWORD dstByteWidth = dstWidth * bytesPerPixel;
+	const auto g_lutBltRow32Func = isAvx2Supported() ? &lutBltRow32Avx2 : &lutBltRow32;
 
-		auto vectorizedBltFunc = g_vectorizedBltFuncs
-			[bytesPerPixel - 1]
-		[(dstByteWidth >= 2) + (dstByteWidth >= 4) + (dstByteWidth >= 8) + (dstByteWidth >= 16)]
-		[dstWidth != absSrcWidth]
-		[mirrorLeftRight]
-		[nullptr != dstColorKey]
-		[nullptr != srcColorKey];
+	void lutBltRow16(WORD* dst, const WORD* src, DWORD width, const WORD* pixelLut)
+	{
+		for (DWORD i = 0; i < width; ++i)
+		{
+			dst[i] = pixelLut[src[i]];
+		}
+	}
+
+	void lutBltRow16Avx2(WORD* dst, const WORD* src, DWORD width, const WORD* pixelLut)
+	{
+		const __m256i wordMask = _mm256_set1_epi32(0xFFFF);
+		DWORD i = 0;
+		for (; i + 16 <= width; i += 16)
+		{
+			const __m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+			__m256i lo = _mm256_i32gather_epi32(reinterpret_cast<const int*>(pixelLut),
+				_mm256_cvtepu16_epi32(_mm256_castsi256_si128(pixels)), 2);
+			__m256i hi = _mm256_i32gather_epi32(reinterpret_cast<const int*>(pixelLut),
+				_mm256_cvtepu16_epi32(_mm256_extracti128_si256(pixels, 1)), 2);
+			__m256i result = _mm256_packus_epi32(_mm256_and_si256(lo, wordMask), _mm256_and_si256(hi, wordMask));
+			result = _mm256_permute4x64_epi64(result, _MM_SHUFFLE(3, 1, 2, 0));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), result);
+		}
+		_mm256_zeroupper();
 
-		vectorizedBltFunc(dst, dstPitch, dstWidth, dstHeight,
-			src, srcPitch, offsetX, deltaX, offsetY, deltaY, dstCk, srcCk);
+		lutBltRow16(dst + i, src + i, width - i, pixelLut);
 	}
 
+	const auto g_lutBltRow16Func = isAvx2Supported() ? &lutBltRow16Avx2 : &lutBltRow16;
+
 	template <typename Pixel>
-	void colorFill(BYTE* dst, DWORD dstPitch, DWORD dstWidth, DWORD dstHeight, DWORD color)
+	void rotateRect(BYTE* dst, DWORD dstPitch, const BYTE* src, int xStep, int yStep, DWORD width, DWORD height)
 	{
-		DWORD c = 0;
-		memset(&c, color, sizeof(Pixel));
-		if (c == color)
+		for (DWORD y = 0; y < height; ++y)
 		{
-			for (DWORD i = dstHeight; i != 0; --i)
+			auto dstRow = reinterpret_cast<Pixel*>(dst + y * dstPitch);
+			const BYTE* srcPixel = src + static_cast<int>(y) * yStep;
+			for (DWORD x = 0; x < width; ++x)
 			{
-				memset(dst, color, dstWidth * sizeof(Pixel));
-				dst += dstPitch;
+				dstRow[x] = *reinterpret_cast<const Pixel*>(srcPixel);
+				srcPixel += xStep;
 			}
-			return;
 		}
+	}
 
-		for (DWORD i = 0; i < dstWidth; ++i)
+	template <bool reverse>
+	__m128i loadRotateTileColumn32(const BYTE* src)
+	{
+		if (reverse)
 		{
-			reinterpret_cast<Pixel*>(dst)[i] = static_cast<Pixel>(color);
+			return _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src - 12)), 0x1B);
 		}
+		return _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+	}
 
-		for (DWORD i = dstHeight - 1; i != 0; --i)
+	template <bool reverse>
+	__m128i loadRotateTileColumn16(const BYTE* src)
+	{
+		if (reverse)
 		{
-			memcpy(dst + dstPitch, dst, dstWidth * sizeof(Pixel));
-			dst += dstPitch;
+			__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src - 14));
+			v = _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, 0x1B), 0x1B);
+			return _mm_shuffle_epi32(v, 0x4E);
+		}
+		return _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+	}
+
+	template <bool reverse>
+	void rotateTile4x4(BYTE* dst, DWORD dstPitch, const BYTE* src, int xStep)
+	{
+		const __m128i c0 = loadRotateTileColumn32<reverse>(src);
+		const __m128i c1 = loadRotateTileColumn32<reverse>(src + xStep);
+		const __m128i c2 = loadRotateTileColumn32<reverse>(src + 2 * xStep);
+		const __m128i c3 = loadRotateTileColumn32<reverse>(src + 3 * xStep);
+
+		const __m128i t0 = _mm_unpacklo_epi32(c0, c1);
+		const __m128i t1 = _mm_unpacklo_epi32(c2, c3);
+		const __m128i t2 = _mm_unpackhi_epi32(c0, c1);
+		const __m128i t3 = _mm_unpackhi_epi32(c2, c3);
+
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst), _mm_unpacklo_epi64(t0, t1));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + dstPitch), _mm_unpackhi_epi64(t0, t1));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 2 * dstPitch), _mm_unpacklo_epi64(t2, t3));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 3 * dstPitch), _mm_unpackhi_epi64(t2, t3));
+	}
+
+	template <bool reverse>
+	void rotateTile8x8(BYTE* dst, DWORD dstPitch, const BYTE* src, int xStep)
+	{
+		__m128i c[8];
+		for (int i = 0; i < 8; ++i)
+		{
+			c[i] = loadRotateTileColumn16<reverse>(src + i * xStep);
+		}
+
+		__m128i a[8];
+		for (int i = 0; i < 4; ++i)
+		{
+			a[i] = _mm_unpacklo_epi16(c[2 * i], c[2 * i + 1]);
+			a[i + 4] = _mm_unpackhi_epi16(c[2 * i], c[2 * i + 1]);
+		}
+
+		__m128i b[8];
+		for (int i = 0; i < 2; ++i)
+		{
+			b[4 * i] = _mm_unpacklo_epi32(a[4 * i], a[4 * i + 1]);
+			b[4 * i + 1] = _mm_unpacklo_epi32(a[4 * i + 2], a[4 * i + 3]);
+			b[4 * i + 2] = _mm_unpackhi_epi32(a[4 * i], a[4 * i + 1]);
+			b[4 * i + 3] = _mm_unpackhi_epi32(a[4 * i + 2], a[4 * i + 3]);
+		}
+
+		for (int i = 0; i < 4; ++i)
+		{
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 2 * i * dstPitch),
+				_mm_unpacklo_epi64(b[2 * i], b[2 * i + 1]));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + (2 * i + 1) * dstPitch),
+				_mm_unpackhi_epi64(b[2 * i], b[2 * i + 1]));
+		}
+	}
+
+	template <typename Pixel, bool reverse>
+	void rotateBltRows(BYTE* dst, DWORD dstPitch, DWORD dstWidth, DWORD top, DWORD bottom,
+		const BYTE* src, int xStep, int yStep)
+	{
+		constexpr DWORD tileSize = 4 == sizeof(Pixel) ? 4 : (2 == sizeof(Pixel) ? 8 : 1);
+		const DWORD blockSize = 32;
+
+		for (DWORD blockTop = top; blockTop < bottom; blockTop += blockSize)
+		{
+			const DWORD blockBottom = std::min<DWORD>(blockTop + blockSize, bottom);
+			for (DWORD blockLeft = 0; blockLeft < dstWidth; blockLeft += blockSize)
+			{
+				const DWORD blockRight = std::min<DWORD>(blockLeft + blockSize, dstWidth);
+				DWORD y = blockTop;
+				if constexpr (1 != tileSize)
+				{
+					for (; y + tileSize <= blockBottom; y += tileSize)
+					{
+						DWORD x = blockLeft;
+						for (; x + tileSize <= blockRight; x += tileSize)
+						{
+							BYTE* dstTile = dst + y * dstPitch + x * sizeof(Pixel);
+							const BYTE* srcTile = src + static_cast<int>(x) * xStep + static_cast<int>(y) * yStep;
+							if constexpr (4 == tileSize)
+							{
+								rotateTile4x4<reverse>(dstTile, dstPitch, srcTile, xStep);
+							}
+							else
+							{
+								rotateTile8x8<reverse>(dstTile, dstPitch, srcTile, xStep);
+							}
+						}
+						rotateRect<Pixel>(dst + y * dstPitch + x * sizeof(Pixel), dstPitch,
+							src + static_cast<int>(x) * xStep + static_cast<int>(y) * yStep, xStep, yStep,
+							blockRight - x, tileSize);
+					}
+				}
+				rotateRect<Pixel>(dst + y * dstPitch + blockLeft * sizeof(Pixel), dstPitch,
+					src + static_cast<int>(blockLeft) * xStep + static_cast<int>(y) * yStep, xStep, yStep,
+					blockRight - blockLeft, blockBottom - y);
+			}
 		}
 	}
+
+	template <typename Pixel>
+	auto getRotateBltRowsFunc(bool reverse)
+	{
+		return reverse ? &rotateBltRows<Pixel, true> : &rotateBltRows<Pixel, false>;
+	}
+
 }
 
 namespace DDraw
 {
 	namespace Blitter
 	{
+		bool alphaBlt(void* dst, DWORD dstPitch, DWORD width, DWORD height,
+			const void* src, DWORD srcPitch, const D3dDdi::FormatInfo& formatInfo,
+			BYTE constantAlpha, bool usePixelAlpha)
+		{
+			if (!isConvertibleFormat(formatInfo) || 3 == formatInfo.bytesPerPixel)
+			{
+				return false;
+			}
+
+			execBanded(height, width * formatInfo.bytesPerPixel * height, [&](DWORD top, DWORD bottom)
+				{
+					alphaBltRows(static_cast<BYTE*>(dst) + top * dstPitch, dstPitch,
+						static_cast<const BYTE*>(src) + top * srcPitch, srcPitch, width, bottom - top,
+						formatInfo, constantAlpha, usePixelAlpha);
+				});
+			return true;
+		}
+
+		bool ropBlt(void* dst, DWORD dstPitch, DWORD width, DWORD height,
+			const void* src, DWORD srcPitch, DWORD bytesPerPixel, DWORD rop, DWORD patternColor)
+		{
+			decltype(&ropBltRows<SRCCOPY>) ropBltFunc = nullptr;
+			switch (rop)
+			{
+			case SRCCOPY: ropBltFunc = &ropBltRows<SRCCOPY>; break;
+			case SRCAND: ropBltFunc = &ropBltRows<SRCAND>; break;
+			case SRCPAINT: ropBltFunc = &ropBltRows<SRCPAINT>; break;
+			case SRCINVERT: ropBltFunc = &ropBltRows<SRCINVERT>; break;
+			case PATCOPY:
+				colorFill(dst, dstPitch, width, height, bytesPerPixel, patternColor);
+				return true;
+			default:
+				return false;
+			}
+
+			execBanded(height, width * bytesPerPixel * height, [&](DWORD top, DWORD bottom)
+				{
+					ropBltFunc(static_cast<BYTE*>(dst) + top * dstPitch, dstPitch,
+						static_cast<const BYTE*>(src) + top * srcPitch, srcPitch, width * bytesPerPixel, bottom - top);
+				});
+			return true;
+		}
+
 		void blt(void* dst, DWORD dstPitch, DWORD dstWidth, DWORD dstHeight,
 			const void* src, DWORD srcPitch, LONG srcWidth, LONG srcHeight,
 			DWORD bytesPerPixel, const DWORD* dstColorKey, const DWORD* srcColorKey)
 		{
+			const DDCOLORKEY dstColorKeyRange = toColorKeyRange(dstColorKey);
+			const DDCOLORKEY srcColorKeyRange = toColorKeyRange(srcColorKey);
 			::blt(static_cast<BYTE*>(dst), dstPitch, dstWidth, dstHeight,
+				static_cast<const BYTE*>(src), srcPitch, srcWidth, srcHeight, bytesPerPixel,
+				dstColorKey ? &dstColorKeyRange : nullptr, srcColorKey ? &srcColorKeyRange : nullptr);
+		}
+
+		void blt(void* dst, DWORD dstPitch, DWORD dstWidth, DWORD dstHeight,
+			const void* src, DWORD srcPitch, LONG srcWidth, LONG srcHeight,
+			DWORD bytesPerPixel, const DWORD* dstColorKey, const DWORD* srcColorKey,
+			const RECT* clipRects, DWORD clipRectCount)
+		{
+			const DDCOLORKEY dstColorKeyRange = toColorKeyRange(dstColorKey);
+			const DDCOLORKEY srcColorKeyRange = toColorKeyRange(srcColorKey);
+			bltClipped(static_cast<BYTE*>(dst), dstPitch, dstWidth, dstHeight,
+				static_cast<const BYTE*>(src), srcPitch, srcWidth, srcHeight, bytesPerPixel,
+				dstColorKey ? &dstColorKeyRange : nullptr, srcColorKey ? &srcColorKeyRange : nullptr,
+				clipRects, clipRectCount);
+		}
+
+		bool colorKeyRangeBlt(void* dst, DWORD dstPitch, DWORD dstWidth, DWORD dstHeight,
+			const void* src, DWORD srcPitch, LONG srcWidth, LONG srcHeight,
+			DWORD bytesPerPixel, const DDCOLORKEY* dstColorKey, const DDCOLORKEY* srcColorKey,
+			const RECT* clipRects, DWORD clipRectCount)
+		{
+			// The channel layout of 16bpp formats varies, and a whole-pixel range would key unrelated colors
+			auto isWordRange = [](const DDCOLORKEY* colorKey)
+			{
+				return colorKey && 0 != ((colorKey->dwColorSpaceLowValue ^ colorKey->dwColorSpaceHighValue) & 0xFFFF);
+			};
+			if (2 == bytesPerPixel && (isWordRange(dstColorKey) || isWordRange(srcColorKey)))
+			{
+				return false;
+			}
+
+			bltClipped(static_cast<BYTE*>(dst), dstPitch, dstWidth, dstHeight,
 				static_cast<const BYTE*>(src), srcPitch, srcWidth, srcHeight,
-				bytesPerPixel, dstColorKey, srcColorKey);
+				bytesPerPixel, dstColorKey, srcColorKey, clipRects, clipRectCount);
+			return true;
 		}
 
 		void colorFill(void* dst, DWORD dstPitch, DWORD dstWidth, DWORD dstHeight, DWORD bytesPerPixel, DWORD color)
 		{
+			const DWORD byteCount = dstWidth * bytesPerPixel * dstHeight;
+			const bool isStreaming = byteCount >= g_minStreamingBltSize;
+			decltype(&::colorFill<BYTE>) colorFillFunc = nullptr;
+			switch (bytesPerPixel)
+			{
+			case 1: colorFillFunc = isStreaming ? &streamingColorFill<BYTE> : &::colorFill<BYTE>; break;
+			case 2: colorFillFunc = isStreaming ? &streamingColorFill<WORD> : &::colorFill<WORD>; break;
+			case 3: colorFillFunc = isStreaming ? &streamingColorFill<UInt24> : &::colorFill<UInt24>; break;
+			case 4: colorFillFunc = isStreaming ? &streamingColorFill<DWORD> : &::colorFill<DWORD>; break;
+			default: return;
+			}
+
+			execBanded(dstHeight, byteCount, [&](DWORD top, DWORD bottom)
+				{
+					colorFillFunc(static_cast<BYTE*>(dst) + top * dstPitch, dstPitch, dstWidth, bottom - top, color);
+				});
+		}
+
+		bool isConvertBltSupported(const D3dDdi::FormatInfo& dstFormatInfo, const D3dDdi::FormatInfo& srcFormatInfo)
+		{
+			return isConvertibleFormat(dstFormatInfo) && isConvertibleFormat(srcFormatInfo);
+		}
+
+		void convertBlt(void* dst, DWORD dstPitch, DWORD dstWidth, DWORD dstHeight, const D3dDdi::FormatInfo& dstFormatInfo,
+			const void* src, DWORD srcPitch, LONG srcWidth, LONG srcHeight, const D3dDdi::FormatInfo& srcFormatInfo,
+			const DWORD* dstColorKey, const DWORD* srcColorKey)
+		{
+			if (!isConvertBltSupported(dstFormatInfo, srcFormatInfo))
+			{
+				return;
+			}
+
+			const bool mirrorLeftRight = srcWidth < 0;
+			const bool mirrorUpDown = srcHeight < 0;
+			const DWORD absSrcWidth = mirrorLeftRight ? -srcWidth : srcWidth;
+			const DWORD absSrcHeight = mirrorUpDown ? -srcHeight : srcHeight;
+			const DWORD dstBpp = dstFormatInfo.bytesPerPixel;
+			const DWORD srcBpp = srcFormatInfo.bytesPerPixel;
+
+			int deltaX = (absSrcWidth << 16) / dstWidth;
+			int deltaY = (absSrcHeight << 16) / dstHeight;
+			int offsetX = deltaX / 2;
+			int offsetY = deltaY / 2;
+
+			if (mirrorLeftRight)
+			{
+				offsetX += static_cast<int>(dstWidth - 1) * deltaX;
+				deltaX = -deltaX;
+			}
+			if (mirrorUpDown)
+			{
+				offsetY += static_cast<int>(dstHeight - 1) * deltaY;
+				deltaY = -deltaY;
+			}
+
+			const BYTE* srcStart = static_cast<const BYTE*>(src) + (offsetX >> 16) * static_cast<int>(srcBpp);
+			offsetX &= 0x0000FFFF;
+
+			const bool resample = dstWidth != absSrcWidth || mirrorLeftRight;
+			auto resampleFunc = lookupVectorizedBltFunc(srcBpp, dstWidth, dstWidth != absSrcWidth, mirrorLeftRight,
+				false, false, false);
+			auto dstColorKeyFunc = lookupVectorizedBltFunc(dstBpp, dstWidth, false, false, true, false, false);
+			auto applySrcColorKeyFunc = getApplySrcColorKeyFunc(dstBpp, srcBpp);
+
+			execBanded(dstHeight, dstWidth * dstBpp * dstHeight, [&](DWORD top, DWORD bottom)
+				{
+					thread_local std::vector<BYTE> srcRowBuffer;
+					thread_local std::vector<BYTE> dstRowBuffer;
+					if (resample)
+					{
+						srcRowBuffer.resize(dstWidth * srcBpp);
+					}
+					if (dstColorKey || srcColorKey)
+					{
+						dstRowBuffer.resize(dstWidth * dstBpp);
+					}
+
+					for (DWORD y = top; y < bottom; ++y)
+					{
+						const BYTE* srcRow = srcStart +
+							((offsetY + static_cast<int>(y) * deltaY) >> 16) * static_cast<int>(srcPitch);
+						BYTE* dstRow = static_cast<BYTE*>(dst) + y * dstPitch;
+
+						if (resample)
+						{
+							resampleFunc(srcRowBuffer.data(), 0, dstWidth, 1, srcRow, 0, offsetX, deltaX, 0, 0, {}, {});
+							srcRow = srcRowBuffer.data();
+						}
+
+						if (srcColorKey)
+						{
+							convertRow(dstRowBuffer.data(), dstFormatInfo, srcRow, srcFormatInfo, dstWidth);
+							applySrcColorKeyFunc(dstRow, dstRowBuffer.data(), srcRow, dstWidth, dstColorKey, *srcColorKey);
+						}
+						else if (dstColorKey)
+						{
+							convertRow(dstRowBuffer.data(), dstFormatInfo, srcRow, srcFormatInfo, dstWidth);
+							const DDCOLORKEY dstCk = { *dstColorKey & 0x00FFFFFF, *dstColorKey & 0x00FFFFFF };
+							dstColorKeyFunc(dstRow, 0, dstWidth, 1, dstRowBuffer.data(), 0, 0x8000, 0x10000, 0, 0,
+								dstCk, {});
+						}
+						else
+						{
+							convertRow(dstRow, dstFormatInfo, srcRow, srcFormatInfo, dstWidth);
+						}
+					}
+				});
+		}
+
+		void paletteBlt(void* dst, DWORD dstPitch, DWORD width, DWORD height,
+			const void* src, DWORD srcPitch, const DWORD* palette)
+		{
+			execBanded(height, width * 4 * height, [&](DWORD top, DWORD bottom)
+				{
+					for (DWORD y = top; y < bottom; ++y)
+					{
+						g_paletteBltRowFunc(reinterpret_cast<DWORD*>(static_cast<BYTE*>(dst) + y * dstPitch),
+							static_cast<const BYTE*>(src) + y * srcPitch, width, palette);
+					}
+				});
+		}
+
+		void lutBlt(void* dst, DWORD dstPitch, DWORD width, DWORD height,
+			const void* src, DWORD srcPitch, const DWORD (&channelLuts)[3][256])
+		{
+			execBanded(height, width * 4 * height, [&](DWORD top, DWORD bottom)
+				{
+					for (DWORD y = top; y < bottom; ++y)
+					{
+						g_lutBltRow32Func(reinterpret_cast<DWORD*>(static_cast<BYTE*>(dst) + y * dstPitch),
+							reinterpret_cast<const DWORD*>(static_cast<const BYTE*>(src) + y * srcPitch), width, channelLuts);
+					}
+				});
+		}
+
+		void lutBlt(void* dst, DWORD dstPitch, DWORD width, DWORD height,
+			const void* src, DWORD srcPitch, const WORD* pixelLut)
+		{
+			execBanded(height, width * 2 * height, [&](DWORD top, DWORD bottom)
+				{
+					for (DWORD y = top; y < bottom; ++y)
+					{
+						g_lutBltRow16Func(reinterpret_cast<WORD*>(static_cast<BYTE*>(dst) + y * dstPitch),
+							reinterpret_cast<const WORD*>(static_cast<const BYTE*>(src) + y * srcPitch), width, pixelLut);
+					}
+				});
+		}
+
+		bool filteredBlt(void* dst, DWORD dstPitch, DWORD dstWidth, DWORD dstHeight,
+			const void* src, DWORD srcPitch, DWORD srcWidth, DWORD srcHeight,
+			const D3dDdi::FormatInfo& formatInfo, Filter filter)
+		{
+			if (2 != formatInfo.bytesPerPixel && 4 != formatInfo.bytesPerPixel)
+			{
+				return false;
+			}
+
+			std::vector<FilterCoord> rows;
+			getFilterCoords(rows, dstHeight, srcHeight, filter);
+
+			std::vector<FilterCoord> coords;
+			getFilterCoords(coords, dstWidth, srcWidth, filter);
+			std::vector<FilterColumn> columns(dstWidth);
+			for (DWORD i = 0; i < dstWidth; ++i)
+			{
+				columns[i].pos = coords[i].pos;
+				for (int j = 0; j < 4; ++j)
+				{
+					columns[i].weights[j] = static_cast<WORD>(256 - coords[i].weight);
+					columns[i].weights[j + 4] = static_cast<WORD>(coords[i].weight);
+				}
+			}
+
+			execBanded(dstHeight, dstWidth * formatInfo.bytesPerPixel * dstHeight, [&](DWORD top, DWORD bottom)
+				{
+					filteredBltRows(static_cast<BYTE*>(dst), dstPitch, dstWidth, top, bottom,
+						static_cast<const BYTE*>(src), srcPitch, srcWidth, srcHeight, formatInfo, columns, rows);
+				});
+			return true;
+		}
+
+		void rotateBlt(void* dst, DWORD dstPitch, DWORD dstWidth, DWORD dstHeight,
+			const void* src, DWORD srcPitch, DWORD bytesPerPixel, Rotation rotation)
+		{
+			if (ROTATE_180 == rotation)
+			{
+				::blt(static_cast<BYTE*>(dst), dstPitch, dstWidth, dstHeight, static_cast<const BYTE*>(src), srcPitch,
+					-static_cast<LONG>(dstWidth), -static_cast<LONG>(dstHeight), bytesPerPixel, nullptr, nullptr);
+				return;
+			}
+
+			const bool isClockwise = ROTATE_90 == rotation;
+			const int pitch = static_cast<int>(srcPitch);
+			const int bpp = static_cast<int>(bytesPerPixel);
+			const int xStep = isClockwise ? -pitch : pitch;
+			const int yStep = isClockwise ? bpp : -bpp;
+			const BYTE* srcOrigin = static_cast<const BYTE*>(src) + (isClockwise
+				? (dstWidth - 1) * srcPitch
+				: (dstHeight - 1) * bytesPerPixel);
+
+			decltype(&rotateBltRows<BYTE, false>) rotateBltRowsFunc = nullptr;
 			switch (bytesPerPixel)
 			{
-			case 1: return ::colorFill<BYTE>(static_cast<BYTE*>(dst), dstPitch, dstWidth, dstHeight, color);
-			case 2: return ::colorFill<WORD>(static_cast<BYTE*>(dst), dstPitch, dstWidth, dstHeight, color);
-			case 3: return ::colorFill<UInt24>(static_cast<BYTE*>(dst), dstPitch, dstWidth, dstHeight, color);
-			case 4: return ::colorFill<DWORD>(static_cast<BYTE*>(dst), dstPitch, dstWidth, dstHeight, color);
+			case 1: rotateBltRowsFunc = getRotateBltRowsFunc<BYTE>(!isClockwise); break;
+			case 2: rotateBltRowsFunc = getRotateBltRowsFunc<WORD>(!isClockwise); break;
+			case 3: rotateBltRowsFunc = getRotateBltRowsFunc<UInt24>(!isClockwise); break;
+			default: rotateBltRowsFunc = getRotateBltRowsFunc<DWORD>(!isClockwise); break;
 			}
+
+			execBanded(dstHeight, dstWidth * bytesPerPixel * dstHeight, [&](DWORD top, DWORD bottom)
+				{
+					rotateBltRowsFunc(static_cast<BYTE*>(dst), dstPitch, dstWidth, top, bottom,
+						srcOrigin, xStep, yStep);
+				});
 		}
 	}
 }
@@ -1,14 +1,61 @@
 #pragma once
 
 #include <Windows.h>
+#include <ddraw.h>
+
+namespace D3dDdi
+{
+	struct FormatInfo;
+}
 
 namespace DDraw
 {
 	namespace Blitter
 	{
+		enum Filter
+		{
+			FILTER_BILINEAR,
+			FILTER_SHARP_BILINEAR
+		};
+
+		enum Rotation
+		{
+			ROTATE_90,
+			ROTATE_180,
+			ROTATE_270
+		};
+
+		bool alphaBlt(void* dst, DWORD dstPitch, DWORD width, DWORD height,
+			const void* src, DWORD srcPitch, const D3dDdi::FormatInfo& formatInfo,
+			BYTE constantAlpha, bool usePixelAlpha);
 		void blt(void* dst, DWORD dstPitch, DWORD dstWidth, DWORD dstHeight,
 			const void* src, DWORD srcPitch, LONG srcWidth, LONG srcHeight,
 			DWORD bytesPerPixel, const DWORD* dstColorKey, const DWORD* srcColorKey);
+		void blt(void* dst, DWORD dstPitch, DWORD dstWidth, DWORD dstHeight,
+			const void* src, DWORD srcPitch, LONG srcWidth, LONG srcHeight,
+			DWORD bytesPerPixel, const DWORD* dstColorKey, const DWORD* srcColorKey,
+			const RECT* clipRects, DWORD clipRectCount);
+		bool colorKeyRangeBlt(void* dst, DWORD dstPitch, DWORD dstWidth, DWORD dstHeight,
+			const void* src, DWORD srcPitch, LONG srcWidth, LONG srcHeight,
+			DWORD bytesPerPixel, const DDCOLORKEY* dstColorKey, const DDCOLORKEY* srcColorKey,
+			const RECT* clipRects, DWORD clipRectCount);
+		void convertBlt(void* dst, DWORD dstPitch, DWORD dstWidth, DWORD dstHeight, const D3dDdi::FormatInfo& dstFormatInfo,
+			const void* src, DWORD srcPitch, LONG srcWidth, LONG srcHeight, const D3dDdi::FormatInfo& srcFormatInfo,
+			const DWORD* dstColorKey, const DWORD* srcColorKey);
+		bool isConvertBltSupported(const D3dDdi::FormatInfo& dstFormatInfo, const D3dDdi::FormatInfo& srcFormatInfo);
 		void colorFill(void* dst, DWORD dstPitch, DWORD dstWidth, DWORD dstHeight, DWORD bytesPerPixel, DWORD color);
+		bool ropBlt(void* dst, DWORD dstPitch, DWORD width, DWORD height,
+			const void* src, DWORD srcPitch, DWORD bytesPerPixel, DWORD rop, DWORD patternColor);
+		void rotateBlt(void* dst, DWORD dstPitch, DWORD dstWidth, DWORD dstHeight,
+			const void* src, DWORD srcPitch, DWORD bytesPerPixel, Rotation rotation);
+		void lutBlt(void* dst, DWORD dstPitch, DWORD width, DWORD height,
+			const void* src, DWORD srcPitch, const DWORD (&channelLuts)[3][256]);
+		void lutBlt(void* dst, DWORD dstPitch, DWORD width, DWORD height,
+			const void* src, DWORD srcPitch, const WORD* pixelLut);
+		void paletteBlt(void* dst, DWORD dstPitch, DWORD width, DWORD height,
+			const void* src, DWORD srcPitch, const DWORD* palette);
+		bool filteredBlt(void* dst, DWORD dstPitch, DWORD dstWidth, DWORD dstHeight,
+			const void* src, DWORD srcPitch, DWORD srcWidth, DWORD srcHeight,
+			const D3dDdi::FormatInfo& formatInfo, Filter filter);
 	}
 }
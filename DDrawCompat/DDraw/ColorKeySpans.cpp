@@ -0,0 +1,245 @@
+#include <algorithm>
+#include <cstring>
+
+#include <intrin.h>
+
+#include "DDraw/ColorKeySpans.h"
+
+namespace
+{
+#pragma pack(1)
+	struct UInt24
+	{
+		WORD low16;
+		BYTE high8;
+
+		operator DWORD() const { return low16 | (high8 << 16); }
+	};
+#pragma pack()
+
+	__forceinline void copySpan(BYTE* dst, const BYTE* src, DWORD size)
+	{
+		if (size >= 16)
+		{
+			for (DWORD i = 0; i + 16 < size; i += 16)
+			{
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)));
+			}
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + size - 16),
+				_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + size - 16)));
+		}
+		else if (size >= 8)
+		{
+			_mm_storel_epi64(reinterpret_cast<__m128i*>(dst), _mm_loadl_epi64(reinterpret_cast<const __m128i*>(src)));
+			_mm_storel_epi64(reinterpret_cast<__m128i*>(dst + size - 8),
+				_mm_loadl_epi64(reinterpret_cast<const __m128i*>(src + size - 8)));
+		}
+		else if (size >= 4)
+		{
+			*reinterpret_cast<DWORD*>(dst) = *reinterpret_cast<const DWORD*>(src);
+			*reinterpret_cast<DWORD*>(dst + size - 4) = *reinterpret_cast<const DWORD*>(src + size - 4);
+		}
+		else
+		{
+			for (DWORD i = 0; i < size; ++i)
+			{
+				dst[i] = src[i];
+			}
+		}
+	}
+
+	DWORD getColorKeyMask(DWORD bytesPerPixel)
+	{
+		return 4 == bytesPerPixel ? 0x00FFFFFF : (1 << (bytesPerPixel * 8)) - 1;
+	}
+}
+
+namespace DDraw
+{
+	ColorKeySpans::ColorKeySpans()
+		: m_width(0)
+		, m_height(0)
+		, m_bytesPerPixel(0)
+		, m_colorKey(0)
+		, m_useCount(0)
+		, m_isValid(false)
+	{
+	}
+
+	bool ColorKeySpans::blt(void* dst, DWORD dstPitch, const void* src, DWORD srcPitch, DWORD srcWidth, DWORD srcHeight,
+		const RECT& srcRect, DWORD bytesPerPixel, DWORD colorKey)
+	{
+		colorKey &= getColorKeyMask(bytesPerPixel);
+		if (!m_isValid || colorKey != m_colorKey || srcWidth != m_width || srcHeight != m_height ||
+			bytesPerPixel != m_bytesPerPixel)
+		{
+			// Surfaces used as a keyed source only once between modifications are not worth scanning
+			if (++m_useCount < 2)
+			{
+				return false;
+			}
+			build(static_cast<const BYTE*>(src), srcPitch, srcWidth, srcHeight, bytesPerPixel, colorKey);
+		}
+
+		const TileState tileState = getTileState(srcRect);
+		if (TILE_TRANSPARENT == tileState)
+		{
+			return true;
+		}
+
+		const DWORD left = srcRect.left;
+		const DWORD right = srcRect.right;
+		BYTE* dstRow = static_cast<BYTE*>(dst);
+		const BYTE* srcRow = static_cast<const BYTE*>(src) + srcRect.top * srcPitch;
+
+		if (TILE_OPAQUE == tileState)
+		{
+			for (LONG y = srcRect.top; y < srcRect.bottom; ++y)
+			{
+				memcpy(dstRow, srcRow + left * bytesPerPixel, (right - left) * bytesPerPixel);
+				dstRow += dstPitch;
+				srcRow += srcPitch;
+			}
+			return true;
+		}
+
+		for (LONG y = srcRect.top; y < srcRect.bottom; ++y)
+		{
+			const Span* span = m_spans.data() + m_rowSpans[y];
+			const Span* spanEnd = m_spans.data() + m_rowSpans[y + 1];
+			span = std::upper_bound(span, spanEnd, left, [](DWORD x, const Span& s) { return x < s.end; });
+			for (; span != spanEnd && span->begin < right; ++span)
+			{
+				const DWORD begin = std::max<DWORD>(span->begin, left);
+				const DWORD end = std::min<DWORD>(span->end, right);
+				copySpan(dstRow + (begin - left) * bytesPerPixel, srcRow + begin * bytesPerPixel,
+					(end - begin) * bytesPerPixel);
+			}
+			dstRow += dstPitch;
+			srcRow += srcPitch;
+		}
+		return true;
+	}
+
+	void ColorKeySpans::build(const BYTE* src, DWORD srcPitch, DWORD width, DWORD height,
+		DWORD bytesPerPixel, DWORD colorKey)
+	{
+		m_width = width;
+		m_height = height;
+		m_bytesPerPixel = bytesPerPixel;
+		m_colorKey = colorKey;
+		m_isValid = true;
+
+		m_spans.clear();
+		m_rowSpans.resize(height + 1);
+		for (DWORD y = 0; y < height; ++y)
+		{
+			m_rowSpans[y] = static_cast<DWORD>(m_spans.size());
+			switch (bytesPerPixel)
+			{
+			case 1: buildRowSpans(src, width, colorKey); break;
+			case 2: buildRowSpans(reinterpret_cast<const WORD*>(src), width, colorKey); break;
+			case 3: buildRowSpans(reinterpret_cast<const UInt24*>(src), width, colorKey); break;
+			case 4: buildRowSpans(reinterpret_cast<const DWORD*>(src), width, colorKey); break;
+			}
+			src += srcPitch;
+		}
+		m_rowSpans[height] = static_cast<DWORD>(m_spans.size());
+
+		const DWORD tilesPerRow = (width + TILE_SIZE - 1) / TILE_SIZE;
+		const DWORD tilesPerColumn = (height + TILE_SIZE - 1) / TILE_SIZE;
+		m_tiles.assign(tilesPerRow * tilesPerColumn, TILE_TRANSPARENT);
+		for (DWORD tileY = 0; tileY < tilesPerColumn; ++tileY)
+		{
+			for (DWORD tileX = 0; tileX < tilesPerRow; ++tileX)
+			{
+				const DWORD left = tileX * TILE_SIZE;
+				const DWORD right = std::min<DWORD>(left + TILE_SIZE, width);
+				DWORD opaqueCount = 0;
+				for (DWORD y = tileY * TILE_SIZE; y < std::min<DWORD>((tileY + 1) * TILE_SIZE, height); ++y)
+				{
+					for (DWORD i = m_rowSpans[y]; i < m_rowSpans[y + 1]; ++i)
+					{
+						if (m_spans[i].end > left && m_spans[i].begin < right)
+						{
+							opaqueCount += std::min<DWORD>(m_spans[i].end, right) - std::max<DWORD>(m_spans[i].begin, left);
+						}
+					}
+				}
+
+				const DWORD tileHeight = std::min<DWORD>(TILE_SIZE, height - tileY * TILE_SIZE);
+				TileState& tile = m_tiles[tileY * tilesPerRow + tileX];
+				if (0 == opaqueCount)
+				{
+					tile = TILE_TRANSPARENT;
+				}
+				else if (opaqueCount == (right - left) * tileHeight)
+				{
+					tile = TILE_OPAQUE;
+				}
+				else
+				{
+					tile = TILE_MIXED;
+				}
+			}
+		}
+	}
+
+	template <typename Pixel>
+	void ColorKeySpans::buildRowSpans(const Pixel* src, DWORD width, DWORD colorKey)
+	{
+		const DWORD mask = getColorKeyMask(sizeof(Pixel));
+		DWORD x = 0;
+		while (x < width)
+		{
+			while (x < width && (static_cast<DWORD>(src[x]) & mask) == colorKey)
+			{
+				++x;
+			}
+
+			const DWORD begin = x;
+			while (x < width && (static_cast<DWORD>(src[x]) & mask) != colorKey)
+			{
+				++x;
+			}
+
+			if (x != begin)
+			{
+				m_spans.push_back({ begin, x });
+			}
+		}
+	}
+
+	ColorKeySpans::TileState ColorKeySpans::getTileState(const RECT& rect) const
+	{
+		const DWORD tilesPerRow = (m_width + TILE_SIZE - 1) / TILE_SIZE;
+		const DWORD firstTileX = rect.left / TILE_SIZE;
+		const DWORD lastTileX = (rect.right - 1) / TILE_SIZE;
+		const DWORD firstTileY = rect.top / TILE_SIZE;
+		const DWORD lastTileY = (rect.bottom - 1) / TILE_SIZE;
+
+		const TileState state = m_tiles[firstTileY * tilesPerRow + firstTileX];
+		if (TILE_MIXED == state)
+		{
+			return TILE_MIXED;
+		}
+
+		for (DWORD tileY = firstTileY; tileY <= lastTileY; ++tileY)
+		{
+			for (DWORD tileX = firstTileX; tileX <= lastTileX; ++tileX)
+			{
+				if (m_tiles[tileY * tilesPerRow + tileX] != state)
+				{
+					return TILE_MIXED;
+				}
+			}
+		}
+		return state;
+	}
+
+	void ColorKeySpans::invalidate()
+	{
+		m_isValid = false;
+		m_useCount = 0;
+	}
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <vector>
+
+#include <Windows.h>
+
+namespace DDraw
+{
+	class ColorKeySpans
+	{
+	public:
+		ColorKeySpans();
+
+		bool blt(void* dst, DWORD dstPitch, const void* src, DWORD srcPitch, DWORD srcWidth, DWORD srcHeight,
+			const RECT& srcRect, DWORD bytesPerPixel, DWORD colorKey);
+		void invalidate();
+
+	private:
+		enum TileState : BYTE
+		{
+			TILE_TRANSPARENT,
+			TILE_OPAQUE,
+			TILE_MIXED
+		};
+
+		struct Span
+		{
+			DWORD begin;
+			DWORD end;
+		};
+
+		static const DWORD TILE_SIZE = 64;
+
+		void build(const BYTE* src, DWORD srcPitch, DWORD width, DWORD height, DWORD bytesPerPixel, DWORD colorKey);
+		TileState getTileState(const RECT& rect) const;
+
+		template <typename Pixel>
+		void buildRowSpans(const Pixel* src, DWORD width, DWORD colorKey);
+
+		DWORD m_width;
+		DWORD m_height;
+		DWORD m_bytesPerPixel;
+		DWORD m_colorKey;
+		DWORD m_useCount;
+		bool m_isValid;
+		std::vector<Span> m_spans;
+		std::vector<DWORD> m_rowSpans;
+		std::vector<TileState> m_tiles;
+	};
+}
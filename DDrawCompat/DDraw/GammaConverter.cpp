@@ -0,0 +1,165 @@
+#include <cstring>
+
+#include "DDraw/Blitter.h"
+#include "DDraw/GammaConverter.h"
+
+namespace
+{
+	DWORD getMaskShift(DWORD mask)
+	{
+		DWORD shift = 0;
+		while (0 == (mask & 1))
+		{
+			mask >>= 1;
+			++shift;
+		}
+		return shift;
+	}
+}
+
+namespace DDraw
+{
+	GammaConverter::GammaConverter()
+		: m_ramp{}
+		, m_lut{}
+		, m_isIdentity(true)
+		, m_arePixelLutsValid(false)
+		, m_pixelFormat{}
+		, m_channelLuts{}
+	{
+		reset();
+	}
+
+	bool GammaConverter::convert(void* dst, DWORD dstPitch, const void* src, DWORD srcPitch,
+		DWORD width, DWORD height, const DDPIXELFORMAT& pixelFormat)
+	{
+		if (m_isIdentity || !updatePixelLuts(pixelFormat))
+		{
+			return false;
+		}
+
+		if (32 == pixelFormat.dwRGBBitCount)
+		{
+			Blitter::lutBlt(dst, dstPitch, width, height, src, srcPitch, m_channelLuts);
+		}
+		else
+		{
+			Blitter::lutBlt(dst, dstPitch, width, height, src, srcPitch, m_pixelLut.data());
+		}
+		return true;
+	}
+
+	void GammaConverter::convertPalette(DWORD* palette, DWORD count) const
+	{
+		for (DWORD i = 0; i < count; ++i)
+		{
+			palette[i] = (m_lut[0][(palette[i] >> 16) & 0xFF] << 16) |
+				(m_lut[1][(palette[i] >> 8) & 0xFF] << 8) |
+				m_lut[2][palette[i] & 0xFF];
+		}
+	}
+
+	const DDGAMMARAMP& GammaConverter::getRamp() const
+	{
+		return m_ramp;
+	}
+
+	bool GammaConverter::isIdentity() const
+	{
+		return m_isIdentity;
+	}
+
+	void GammaConverter::reset()
+	{
+		DDGAMMARAMP ramp = {};
+		for (WORD i = 0; i < 256; ++i)
+		{
+			ramp.red[i] = ramp.green[i] = ramp.blue[i] = static_cast<WORD>(i * 0x101);
+		}
+		setRamp(ramp);
+	}
+
+	void GammaConverter::setRamp(const DDGAMMARAMP& ramp)
+	{
+		m_ramp = ramp;
+		m_isIdentity = true;
+		for (DWORD i = 0; i < 256; ++i)
+		{
+			m_lut[0][i] = static_cast<BYTE>(ramp.red[i] >> 8);
+			m_lut[1][i] = static_cast<BYTE>(ramp.green[i] >> 8);
+			m_lut[2][i] = static_cast<BYTE>(ramp.blue[i] >> 8);
+			m_isIdentity = m_isIdentity && m_lut[0][i] == i && m_lut[1][i] == i && m_lut[2][i] == i;
+		}
+		m_arePixelLutsValid = false;
+	}
+
+	bool GammaConverter::updatePixelLuts(const DDPIXELFORMAT& pixelFormat)
+	{
+		if (m_arePixelLutsValid && 0 == memcmp(&m_pixelFormat, &pixelFormat, sizeof(m_pixelFormat)))
+		{
+			return true;
+		}
+
+		const DWORD masks[3] = { pixelFormat.dwRBitMask, pixelFormat.dwGBitMask, pixelFormat.dwBBitMask };
+		if (!(pixelFormat.dwFlags & DDPF_RGB) || 0 == masks[0] || 0 == masks[1] || 0 == masks[2])
+		{
+			return false;
+		}
+
+		if (32 == pixelFormat.dwRGBBitCount)
+		{
+			for (DWORD byte = 0; byte < 3; ++byte)
+			{
+				const DWORD byteMask = 0xFF << (byte * 8);
+				DWORD channel = 0;
+				while (channel < 3 && masks[channel] != byteMask)
+				{
+					++channel;
+				}
+				if (3 == channel)
+				{
+					return false;
+				}
+
+				for (DWORD i = 0; i < 256; ++i)
+				{
+					m_channelLuts[byte][i] = m_lut[channel][i] << (byte * 8);
+				}
+			}
+		}
+		else if (16 == pixelFormat.dwRGBBitCount)
+		{
+			DWORD shifts[3] = {};
+			DWORD maxValues[3] = {};
+			for (DWORD channel = 0; channel < 3; ++channel)
+			{
+				shifts[channel] = getMaskShift(masks[channel]);
+				maxValues[channel] = masks[channel] >> shifts[channel];
+			}
+
+			// One extra entry keeps the 32 bit gathers of the last pixel value inside the table
+			m_pixelLut.resize(0x10001);
+			const DWORD rgbMask = masks[0] | masks[1] | masks[2];
+			for (DWORD pixel = 0; pixel < 0x10000; ++pixel)
+			{
+				DWORD result = pixel & ~rgbMask;
+				for (DWORD channel = 0; channel < 3; ++channel)
+				{
+					const DWORD value = (pixel & masks[channel]) >> shifts[channel];
+					const DWORD value8 = (value * 255 + maxValues[channel] / 2) / maxValues[channel];
+					const DWORD gamma = (m_lut[channel][value8] * maxValues[channel] + 127) / 255;
+					result |= gamma << shifts[channel];
+				}
+				m_pixelLut[pixel] = static_cast<WORD>(result);
+			}
+		}
+		else
+		{
+			return false;
+		}
+
+		m_pixelFormat = pixelFormat;
+		m_arePixelLutsValid = true;
+		return true;
+	}
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <vector>
+
+#include <ddraw.h>
+
+namespace DDraw
+{
+	class GammaConverter
+	{
+	public:
+		GammaConverter();
+
+		bool convert(void* dst, DWORD dstPitch, const void* src, DWORD srcPitch,
+			DWORD width, DWORD height, const DDPIXELFORMAT& pixelFormat);
+		void convertPalette(DWORD* palette, DWORD count) const;
+		const DDGAMMARAMP& getRamp() const;
+		bool isIdentity() const;
+		void reset();
+		void setRamp(const DDGAMMARAMP& ramp);
+
+	private:
+		bool updatePixelLuts(const DDPIXELFORMAT& pixelFormat);
+
+		DDGAMMARAMP m_ramp;
+		BYTE m_lut[3][256];
+		bool m_isIdentity;
+		bool m_arePixelLutsValid;
+		DDPIXELFORMAT m_pixelFormat;
+		DWORD m_channelLuts[3][256];
+		std::vector<WORD> m_pixelLut;
+	};
+}
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <memory>
 #include <vector>
 
@@ -9,14 +10,17 @@
 #include "D3dDdi/KernelModeThunks.h"
 #include "DDraw/DirectDraw.h"
 #include "DDraw/DirectDrawSurface.h"
+#include "DDraw/GammaConverter.h"
 #include "DDraw/IReleaseNotifier.h"
 #include "DDraw/RealPrimarySurface.h"
 #include "DDraw/ScopedThreadLock.h"
 #include "DDraw/Surfaces/PrimarySurface.h"
+#include "DDraw/TiledPaletteConverter.h"
 #include "DDraw/Types.h"
 #include "Gdi/AccessGuard.h"
 #include "Gdi/Caret.h"
 #include "Gdi/Gdi.h"
+#include "Gdi/Palette.h"
 #include "Gdi/VirtualScreen.h"
 #include "Gdi/Window.h"
 #include "Win32/DisplayMode.h"
@@ -28,6 +32,10 @@ namespace
 
 	CompatWeakPtr<IDirectDrawSurface7> g_frontBuffer;
 	CompatWeakPtr<IDirectDrawSurface7> g_paletteConverter;
+	CompatWeakPtr<IDirectDrawSurface7> g_gammaSurface;
+	DDraw::GammaConverter g_gammaConverter;
+	bool g_isGammaEmulated = false;
+	DDraw::TiledPaletteConverter g_tiledPaletteConverter;
 	CompatWeakPtr<IDirectDrawClipper> g_clipper;
 	DDSURFACEDESC2 g_surfaceDesc = {};
 	DDraw::IReleaseNotifier g_releaseNotifier(onRelease);
@@ -312,6 +320,8 @@ namespace
 		g_isPresentPending = false;
 		g_waitingForPrimaryUnlock = false;
 		g_paletteConverter.release();
+		g_tiledPaletteConverter.invalidate();
+		g_gammaSurface.release();
 		g_surfaceDesc = {};
 	}
 
@@ -360,6 +370,103 @@ namespace
 		D3dDdi::KernelModeThunks::waitForVerticalBlank();
 	}
 
+	bool convertToPaletteConverter(CompatRef<IDirectDrawSurface7> src)
+	{
+		DDSURFACEDESC2 srcDesc = {};
+		srcDesc.dwSize = sizeof(srcDesc);
+		if (FAILED(src->Lock(&src, nullptr, &srcDesc, DDLOCK_WAIT | DDLOCK_READONLY | DDLOCK_NOSYSLOCK, nullptr)))
+		{
+			return false;
+		}
+
+		DDSURFACEDESC2 dstDesc = {};
+		dstDesc.dwSize = sizeof(dstDesc);
+		if (8 != srcDesc.ddpfPixelFormat.dwRGBBitCount ||
+			FAILED(g_paletteConverter->Lock(g_paletteConverter, nullptr, &dstDesc,
+				DDLOCK_WAIT | DDLOCK_WRITEONLY | DDLOCK_NOSYSLOCK, nullptr)))
+		{
+			src->Unlock(&src, nullptr);
+			return false;
+		}
+
+		DWORD palette[256] = {};
+		auto hardwarePalette(Gdi::Palette::getHardwarePalette());
+		for (UINT i = 0; i < 256; ++i)
+		{
+			palette[i] = (hardwarePalette[i].peRed << 16) | (hardwarePalette[i].peGreen << 8) | hardwarePalette[i].peBlue;
+		}
+
+		if (!g_gammaConverter.isIdentity())
+		{
+			g_gammaConverter.convertPalette(palette, 256);
+		}
+
+		g_tiledPaletteConverter.convert(dstDesc.lpSurface, dstDesc.lPitch,
+			srcDesc.lpSurface, srcDesc.lPitch,
+			std::min<DWORD>(srcDesc.dwWidth, dstDesc.dwWidth), std::min<DWORD>(srcDesc.dwHeight, dstDesc.dwHeight),
+			palette);
+
+		g_paletteConverter->Unlock(g_paletteConverter, nullptr);
+		src->Unlock(&src, nullptr);
+		return true;
+	}
+
+	bool convertToGammaSurface(CompatRef<IDirectDrawSurface7> src)
+	{
+		if (g_gammaConverter.isIdentity())
+		{
+			return false;
+		}
+
+		if (!g_gammaSurface)
+		{
+			CompatPtr<IUnknown> ddUnk;
+			g_frontBuffer->GetDDInterface(g_frontBuffer, reinterpret_cast<void**>(&ddUnk.getRef()));
+			CompatPtr<IDirectDraw7> dd(ddUnk);
+			if (!dd)
+			{
+				return false;
+			}
+
+			DDSURFACEDESC2 desc = {};
+			desc.dwSize = sizeof(desc);
+			desc.dwFlags = DDSD_WIDTH | DDSD_HEIGHT | DDSD_PIXELFORMAT | DDSD_CAPS;
+			desc.dwWidth = g_surfaceDesc.dwWidth;
+			desc.dwHeight = g_surfaceDesc.dwHeight;
+			desc.ddpfPixelFormat = g_surfaceDesc.ddpfPixelFormat;
+			desc.ddsCaps.dwCaps = DDSCAPS_OFFSCREENPLAIN | DDSCAPS_SYSTEMMEMORY;
+			if (FAILED(dd->CreateSurface(dd, &desc, &g_gammaSurface.getRef(), nullptr)))
+			{
+				return false;
+			}
+		}
+
+		DDSURFACEDESC2 srcDesc = {};
+		srcDesc.dwSize = sizeof(srcDesc);
+		if (FAILED(src->Lock(&src, nullptr, &srcDesc, DDLOCK_WAIT | DDLOCK_READONLY | DDLOCK_NOSYSLOCK, nullptr)))
+		{
+			return false;
+		}
+
+		DDSURFACEDESC2 dstDesc = {};
+		dstDesc.dwSize = sizeof(dstDesc);
+		if (FAILED(g_gammaSurface->Lock(g_gammaSurface, nullptr, &dstDesc,
+			DDLOCK_WAIT | DDLOCK_WRITEONLY | DDLOCK_NOSYSLOCK, nullptr)))
+		{
+			src->Unlock(&src, nullptr);
+			return false;
+		}
+
+		bool result = 0 == memcmp(&srcDesc.ddpfPixelFormat, &dstDesc.ddpfPixelFormat, sizeof(srcDesc.ddpfPixelFormat)) &&
+			g_gammaConverter.convert(dstDesc.lpSurface, dstDesc.lPitch, srcDesc.lpSurface, srcDesc.lPitch,
+				std::min<DWORD>(srcDesc.dwWidth, dstDesc.dwWidth), std::min<DWORD>(srcDesc.dwHeight, dstDesc.dwHeight),
+				srcDesc.ddpfPixelFormat);
+
+		g_gammaSurface->Unlock(g_gammaSurface, nullptr);
+		src->Unlock(&src, nullptr);
+		return result;
+	}
+
 	void presentToPrimaryChain(CompatWeakPtr<IDirectDrawSurface7> src)
 	{
 		LOG_FUNC("RealPrimarySurface::presentToPrimaryChain", src);
@@ -375,7 +482,11 @@ namespace
 		Gdi::Region primaryRegion(D3dDdi::KernelModeThunks::getMonitorRect());
 		bltToWindowViaGdi(&primaryRegion);
 
-		if (Win32::DisplayMode::getBpp() <= 8)
+		if (Win32::DisplayMode::getBpp() <= 8 && convertToPaletteConverter(*src))
+		{
+			bltToPrimaryChain(*g_paletteConverter);
+		}
+		else if (Win32::DisplayMode::getBpp() <= 8)
 		{
 			HDC paletteConverterDc = nullptr;
 			g_paletteConverter->GetDC(g_paletteConverter, &paletteConverterDc);
@@ -397,6 +508,10 @@ namespace
 
 			bltToPrimaryChain(*g_paletteConverter);
 		}
+		else if (convertToGammaSurface(*src))
+		{
+			bltToPrimaryChain(*g_gammaSurface);
+		}
 		else
 		{
 			bltToPrimaryChain(*src);
@@ -515,6 +630,8 @@ namespace DDraw
 		{
 			Compat::Log() << "ERROR: Failed to create the real primary surface: " << Compat::hex(result);
 			g_paletteConverter.release();
+			g_tiledPaletteConverter.invalidate();
+			g_gammaSurface.release();
 			return result;
 		}
 
@@ -592,6 +709,12 @@ namespace DDraw
 	HRESULT RealPrimarySurface::getGammaRamp(DDGAMMARAMP* rampData)
 	{
 		DDraw::ScopedThreadLock lock;
+		if (g_isGammaEmulated && rampData)
+		{
+			*rampData = g_gammaConverter.getRamp();
+			return DD_OK;
+		}
+
 		auto gammaControl(CompatPtr<IDirectDrawGammaControl>::from(g_frontBuffer.get()));
 		if (!gammaControl)
 		{
@@ -665,7 +788,27 @@ namespace DDraw
 			return DDERR_INVALIDPARAMS;
 		}
 
-		return gammaControl->SetGammaRamp(gammaControl, 0, rampData);
+		HRESULT result = gammaControl->SetGammaRamp(gammaControl, 0, rampData);
+		if (SUCCEEDED(result))
+		{
+			if (g_isGammaEmulated)
+			{
+				g_gammaConverter.reset();
+				g_isGammaEmulated = false;
+				update();
+			}
+			return result;
+		}
+
+		if (!rampData)
+		{
+			return result;
+		}
+
+		g_gammaConverter.setRamp(*rampData);
+		g_isGammaEmulated = true;
+		update();
+		return DD_OK;
 	}
 
 	void RealPrimarySurface::update()
@@ -1,6 +1,9 @@
+#include <vector>
+
 #include <Common/CompatPtr.h>
 #include <D3dDdi/KernelModeThunks.h>
 #include <D3dDdi/ScopedCriticalSection.h>
+#include <DDraw/Blitter.h>
 #include <DDraw/DirectDrawClipper.h>
 #include <DDraw/DirectDrawPalette.h>
 #include <DDraw/DirectDrawSurface.h>
@@ -14,6 +17,81 @@
 
 namespace
 {
+	bool bltToGdiDirect(const RECT& dstRect, const Gdi::Region& clipRgn,
+		CompatRef<IDirectDrawSurface7> src, LPRECT lpSrcRect, DWORD dwFlags, LPDDBLTFX lpDDBltFx)
+	{
+		const DWORD supportedFlags = DDBLT_ASYNC | DDBLT_WAIT | DDBLT_DONOTWAIT | DDBLT_KEYSRC | DDBLT_KEYSRCOVERRIDE;
+		if (dwFlags & ~supportedFlags)
+		{
+			return false;
+		}
+
+		DDCOLORKEY srcColorKey = {};
+		if (dwFlags & DDBLT_KEYSRCOVERRIDE)
+		{
+			if (!lpDDBltFx)
+			{
+				return false;
+			}
+			srcColorKey = lpDDBltFx->ddckSrcColorkey;
+		}
+		else if ((dwFlags & DDBLT_KEYSRC) && FAILED(src->GetColorKey(&src, DDCKEY_SRCBLT, &srcColorKey)))
+		{
+			return false;
+		}
+
+		const bool useSrcColorKey = 0 != (dwFlags & (DDBLT_KEYSRC | DDBLT_KEYSRCOVERRIDE));
+
+		DDSURFACEDESC2 dstDesc = Gdi::VirtualScreen::getSurfaceDesc(dstRect);
+		if (!dstDesc.lpSurface)
+		{
+			return false;
+		}
+
+		DDSURFACEDESC2 srcDesc = {};
+		srcDesc.dwSize = sizeof(srcDesc);
+		if (FAILED(src->GetSurfaceDesc(&src, &srcDesc)) ||
+			dstDesc.ddpfPixelFormat.dwRGBBitCount < 8 ||
+			0 != memcmp(&dstDesc.ddpfPixelFormat, &srcDesc.ddpfPixelFormat, sizeof(dstDesc.ddpfPixelFormat)))
+		{
+			return false;
+		}
+
+		RECT srcRect = lpSrcRect ? *lpSrcRect
+			: RECT{ 0, 0, static_cast<LONG>(srcDesc.dwWidth), static_cast<LONG>(srcDesc.dwHeight) };
+		if (srcRect.left < 0 || srcRect.top < 0 || srcRect.left >= srcRect.right || srcRect.top >= srcRect.bottom ||
+			srcRect.right > static_cast<LONG>(srcDesc.dwWidth) || srcRect.bottom > static_cast<LONG>(srcDesc.dwHeight))
+		{
+			return false;
+		}
+
+		Gdi::Region rgn(clipRgn);
+		rgn.offset(-dstRect.left, -dstRect.top);
+		DWORD rgnDataSize = GetRegionData(rgn, 0, nullptr);
+		if (0 == rgnDataSize)
+		{
+			return false;
+		}
+
+		std::vector<unsigned char> rgnDataBuf(rgnDataSize);
+		auto& rgnData = *reinterpret_cast<RGNDATA*>(rgnDataBuf.data());
+		GetRegionData(rgn, rgnDataSize, &rgnData);
+
+		if (FAILED(src->Lock(&src, &srcRect, &srcDesc, DDLOCK_WAIT | DDLOCK_NOSYSLOCK | DDLOCK_READONLY, nullptr)))
+		{
+			return false;
+		}
+
+		const bool result = DDraw::Blitter::colorKeyRangeBlt(dstDesc.lpSurface, dstDesc.lPitch, dstDesc.dwWidth, dstDesc.dwHeight,
+			srcDesc.lpSurface, srcDesc.lPitch, srcRect.right - srcRect.left, srcRect.bottom - srcRect.top,
+			dstDesc.ddpfPixelFormat.dwRGBBitCount / 8, nullptr,
+			useSrcColorKey ? &srcColorKey : nullptr,
+			reinterpret_cast<const RECT*>(rgnData.Buffer), rgnData.rdh.nCount);
+
+		src->Unlock(&src, &srcRect);
+		return result;
+	}
+
 	template <typename TSurface>
 	void bltToGdi(TSurface* This, LPRECT lpDestRect, TSurface* lpDDSrcSurface, LPRECT lpSrcRect,
 		DWORD dwFlags, LPDDBLTFX lpDDBltFx)
@@ -42,6 +120,14 @@ namespace
 			return;
 		}
 
+		auto srcSurface(CompatPtr<IDirectDrawSurface7>::from(lpDDSrcSurface));
+		RECT screenRect = *lpDestRect;
+		OffsetRect(&screenRect, monitorRect.left, monitorRect.top);
+		if (srcSurface && bltToGdiDirect(screenRect, clipRgn, *srcSurface, lpSrcRect, dwFlags, lpDDBltFx))
+		{
+			return;
+		}
+
 		auto gdiSurface(Gdi::VirtualScreen::createSurface(virtualScreenBounds));
 		if (!gdiSurface)
 		{
@@ -60,7 +146,6 @@ namespace
 		clipRgn.offset(-virtualScreenBounds.left, -virtualScreenBounds.top);
 		DDraw::DirectDrawClipper::setClipRgn(*gdiClipper, clipRgn);
 
-		auto srcSurface(CompatPtr<IDirectDrawSurface7>::from(lpDDSrcSurface));
 		gdiSurface->SetClipper(gdiSurface, gdiClipper);
 		gdiSurface.get()->lpVtbl->Blt(gdiSurface, &dstRect, srcSurface, lpSrcRect, dwFlags, lpDDBltFx);
 		gdiSurface->SetClipper(gdiSurface, nullptr);
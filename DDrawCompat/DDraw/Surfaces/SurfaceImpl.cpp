@@ -1,11 +1,86 @@
 #include <set>
 
+#include "Common/CompatPtr.h"
+#include "D3dDdi/Device.h"
+#include "DDraw/Blitter.h"
 #include "DDraw/DirectDrawSurface.h"
 #include "DDraw/RealPrimarySurface.h"
 #include "DDraw/Surfaces/PrimarySurface.h"
 #include "DDraw/Surfaces/Surface.h"
 #include "DDraw/Surfaces/SurfaceImpl.h"
 
+namespace
+{
+	RECT getBltRect(LPRECT rect, const DDSURFACEDESC2& desc)
+	{
+		if (rect)
+		{
+			return *rect;
+		}
+		return { 0, 0, static_cast<LONG>(desc.dwWidth), static_cast<LONG>(desc.dwHeight) };
+	}
+
+	bool isSoftwareRop(DWORD rop)
+	{
+		return SRCAND == rop || SRCPAINT == rop || SRCINVERT == rop;
+	}
+
+	bool ropBlt(CompatRef<IDirectDrawSurface7> dst, LPRECT lpDestRect,
+		CompatRef<IDirectDrawSurface7> src, LPRECT lpSrcRect, DWORD rop)
+	{
+		if (&dst == &src)
+		{
+			return false;
+		}
+
+		CompatPtr<IDirectDrawClipper> clipper;
+		dst->GetClipper(&dst, &clipper.getRef());
+		if (clipper)
+		{
+			return false;
+		}
+
+		DDSURFACEDESC2 dstDesc = {};
+		dstDesc.dwSize = sizeof(dstDesc);
+		DDSURFACEDESC2 srcDesc = {};
+		srcDesc.dwSize = sizeof(srcDesc);
+		if (FAILED(dst->GetSurfaceDesc(&dst, &dstDesc)) || FAILED(src->GetSurfaceDesc(&src, &srcDesc)) ||
+			dstDesc.ddpfPixelFormat.dwRGBBitCount < 8 ||
+			0 != memcmp(&dstDesc.ddpfPixelFormat, &srcDesc.ddpfPixelFormat, sizeof(dstDesc.ddpfPixelFormat)))
+		{
+			return false;
+		}
+
+		RECT dstRect = getBltRect(lpDestRect, dstDesc);
+		RECT srcRect = getBltRect(lpSrcRect, srcDesc);
+		const LONG width = dstRect.right - dstRect.left;
+		const LONG height = dstRect.bottom - dstRect.top;
+		if (width <= 0 || height <= 0 ||
+			width != srcRect.right - srcRect.left || height != srcRect.bottom - srcRect.top)
+		{
+			return false;
+		}
+
+		if (FAILED(dst->Lock(&dst, &dstRect, &dstDesc, DDLOCK_WAIT | DDLOCK_NOSYSLOCK, nullptr)))
+		{
+			return false;
+		}
+
+		if (FAILED(src->Lock(&src, &srcRect, &srcDesc, DDLOCK_WAIT | DDLOCK_NOSYSLOCK | DDLOCK_READONLY, nullptr)))
+		{
+			dst->Unlock(&dst, &dstRect);
+			return false;
+		}
+
+		DDraw::Blitter::ropBlt(dstDesc.lpSurface, dstDesc.lPitch, width, height,
+			srcDesc.lpSurface, srcDesc.lPitch, dstDesc.ddpfPixelFormat.dwRGBBitCount / 8, rop, 0);
+
+		src->Unlock(&src, &srcRect);
+		dst->Unlock(&dst, &dstRect);
+		return true;
+	}
+}
+
 namespace DDraw
 {
 	template <typename TSurface>
@@ -28,7 +103,19 @@ namespace DDraw
 		{
 			return DDERR_WASSTILLDRAWING;
 		}
-		return s_origVtable.Blt(This, lpDestRect, lpDDSrcSurface, lpSrcRect, dwFlags, lpDDBltFx);
+
+		if (DDBLT_ROP == (dwFlags & ~(DDBLT_WAIT | DDBLT_DONOTWAIT)) &&
+			lpDDSrcSurface && lpDDBltFx && isSoftwareRop(lpDDBltFx->dwROP) &&
+			ropBlt(*CompatPtr<IDirectDrawSurface7>::from(This), lpDestRect,
+				*CompatPtr<IDirectDrawSurface7>::from(lpDDSrcSurface), lpSrcRect, lpDDBltFx->dwROP))
+		{
+			return DD_OK;
+		}
+
+		D3dDdi::Device::setAsyncBltResource((dwFlags & DDBLT_ASYNC) ? getDriverResourceHandle(*This) : nullptr);
+		HRESULT result = s_origVtable.Blt(This, lpDestRect, lpDDSrcSurface, lpSrcRect, dwFlags, lpDDBltFx);
+		D3dDdi::Device::setAsyncBltResource(nullptr);
+		return result;
 	}
 
 	template <typename TSurface>
@@ -0,0 +1,137 @@
+#include <algorithm>
+#include <cstring>
+
+#include "DDraw/Blitter.h"
+#include "DDraw/TiledPaletteConverter.h"
+
+namespace DDraw
+{
+	TiledPaletteConverter::TiledPaletteConverter()
+		: m_dst(nullptr)
+		, m_dstPitch(0)
+		, m_src(nullptr)
+		, m_srcPitch(0)
+		, m_width(0)
+		, m_height(0)
+		, m_tilesPerRow(0)
+		, m_currentPalette(nullptr)
+		, m_isValid(false)
+		, m_palette{}
+	{
+	}
+
+	void TiledPaletteConverter::convert(void* dst, DWORD dstPitch, const void* src, DWORD srcPitch,
+		DWORD width, DWORD height, const DWORD* palette)
+	{
+		if (dst != m_dst || dstPitch != m_dstPitch || width != m_width || height != m_height)
+		{
+			m_dst = static_cast<BYTE*>(dst);
+			m_dstPitch = dstPitch;
+			m_width = width;
+			m_height = height;
+			m_tilesPerRow = (width + TILE_SIZE - 1) / TILE_SIZE;
+			m_shadow.resize(width * height);
+			m_tileUsage.resize(m_tilesPerRow * ((height + TILE_SIZE - 1) / TILE_SIZE));
+			m_isValid = false;
+		}
+
+		m_src = static_cast<const BYTE*>(src);
+		m_srcPitch = srcPitch;
+		m_currentPalette = palette;
+
+		if (!m_isValid)
+		{
+			Blitter::paletteBlt(dst, dstPitch, width, height, src, srcPitch, palette);
+			for (DWORD tileY = 0; tileY * TILE_SIZE < height; ++tileY)
+			{
+				for (DWORD tileX = 0; tileX < m_tilesPerRow; ++tileX)
+				{
+					updateShadow(tileX, tileY,
+						std::min<DWORD>(TILE_SIZE, width - tileX * TILE_SIZE),
+						std::min<DWORD>(TILE_SIZE, height - tileY * TILE_SIZE));
+				}
+			}
+			std::memcpy(m_palette.data(), palette, sizeof(m_palette));
+			m_isValid = true;
+			return;
+		}
+
+		PaletteUsage changedEntries = {};
+		for (DWORD i = 0; i < 256; ++i)
+		{
+			if (palette[i] != m_palette[i])
+			{
+				changedEntries[i / 64] |= 1ULL << (i % 64);
+			}
+		}
+
+		for (DWORD tileY = 0; tileY * TILE_SIZE < height; ++tileY)
+		{
+			for (DWORD tileX = 0; tileX < m_tilesPerRow; ++tileX)
+			{
+				convertTile(tileX, tileY, changedEntries);
+			}
+		}
+
+		std::memcpy(m_palette.data(), palette, sizeof(m_palette));
+	}
+
+	void TiledPaletteConverter::convertTile(DWORD tileX, DWORD tileY, const PaletteUsage& changedEntries)
+	{
+		const DWORD left = tileX * TILE_SIZE;
+		const DWORD top = tileY * TILE_SIZE;
+		const DWORD tileWidth = std::min<DWORD>(TILE_SIZE, m_width - left);
+		const DWORD tileHeight = std::min<DWORD>(TILE_SIZE, m_height - top);
+		const BYTE* src = m_src + top * m_srcPitch + left;
+		const BYTE* shadow = m_shadow.data() + top * m_width + left;
+
+		bool isDirty = false;
+		for (DWORD y = 0; y < tileHeight && !isDirty; ++y)
+		{
+			isDirty = 0 != std::memcmp(src + y * m_srcPitch, shadow + y * m_width, tileWidth);
+		}
+
+		if (isDirty)
+		{
+			updateShadow(tileX, tileY, tileWidth, tileHeight);
+		}
+		else
+		{
+			const PaletteUsage& usage = m_tileUsage[tileY * m_tilesPerRow + tileX];
+			if (0 == ((usage[0] & changedEntries[0]) | (usage[1] & changedEntries[1]) |
+				(usage[2] & changedEntries[2]) | (usage[3] & changedEntries[3])))
+			{
+				return;
+			}
+		}
+
+		Blitter::paletteBlt(m_dst + top * m_dstPitch + left * 4, m_dstPitch, tileWidth, tileHeight,
+			src, m_srcPitch, m_currentPalette);
+	}
+
+	void TiledPaletteConverter::invalidate()
+	{
+		m_isValid = false;
+	}
+
+	void TiledPaletteConverter::updateShadow(DWORD tileX, DWORD tileY, DWORD tileWidth, DWORD tileHeight)
+	{
+		const DWORD left = tileX * TILE_SIZE;
+		const DWORD top = tileY * TILE_SIZE;
+		const BYTE* src = m_src + top * m_srcPitch + left;
+		BYTE* shadow = m_shadow.data() + top * m_width + left;
+
+		PaletteUsage& usage = m_tileUsage[tileY * m_tilesPerRow + tileX];
+		usage = {};
+		for (DWORD y = 0; y < tileHeight; ++y)
+		{
+			std::memcpy(shadow, src, tileWidth);
+			for (DWORD x = 0; x < tileWidth; ++x)
+			{
+				usage[src[x] / 64] |= 1ULL << (src[x] % 64);
+			}
+			src += m_srcPitch;
+			shadow += m_width;
+		}
+	}
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <array>
+#include <vector>
+
+#include <Windows.h>
+
+namespace DDraw
+{
+	class TiledPaletteConverter
+	{
+	public:
+		TiledPaletteConverter();
+
+		void convert(void* dst, DWORD dstPitch, const void* src, DWORD srcPitch,
+			DWORD width, DWORD height, const DWORD* palette);
+		void invalidate();
+
+	private:
+		typedef std::array<unsigned long long, 4> PaletteUsage;
+
+		static const DWORD TILE_SIZE = 64;
+
+		void convertTile(DWORD tileX, DWORD tileY, const PaletteUsage& changedEntries);
+		void updateShadow(DWORD tileX, DWORD tileY, DWORD tileWidth, DWORD tileHeight);
+
+		BYTE* m_dst;
+		DWORD m_dstPitch;
+		const BYTE* m_src;
+		DWORD m_srcPitch;
+		DWORD m_width;
+		DWORD m_height;
+		DWORD m_tilesPerRow;
+		const DWORD* m_currentPalette;
+		bool m_isValid;
+		std::array<DWORD, 256> m_palette;
+		std::vector<BYTE> m_shadow;
+		std::vector<PaletteUsage> m_tileUsage;
+	};
+}
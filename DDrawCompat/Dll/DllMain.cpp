@@ -21,6 +21,7 @@
 #include <Win32/MemoryManagement.h>
 #include <Win32/MsgHooks.h>
 #include <Win32/Registry.h>
+#include <Win32/Thread.h>
 #include <Win32/WaitFunctions.h>
 
 HRESULT WINAPI SetAppCompatData(DWORD, DWORD);
@@ -269,7 +270,7 @@ BOOL WINAPI DllMain(HINSTANCE hinstDLL, DWORD fdwReason, LPVOID lpvReserved)
 
 		const BOOL disablePriorityBoost = TRUE;
 		SetProcessPriorityBoost(GetCurrentProcess(), disablePriorityBoost);
-		SetProcessAffinityMask(GetCurrentProcess(), 1);
+		Win32::Thread::applyConfig();
 		timeBeginPeriod(1);
 		setDpiAwareness();
 		SetThemeAppProperties(0);
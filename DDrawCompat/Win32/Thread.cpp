@@ -0,0 +1,49 @@
+#include <Common/Log.h>
+#include <Config/Config.h>
+#include <Win32/Thread.h>
+
+namespace Win32
+{
+	namespace Thread
+	{
+		void applyConfig()
+		{
+			// Many older games assume a single CPU and race or stutter on multi-core systems,
+			// so by default all threads, including the blitter worker threads, share CPU 0.
+			if (0 == Config::cpuAffinityMask)
+			{
+				return;
+			}
+
+			DWORD_PTR processAffinityMask = 0;
+			DWORD_PTR systemAffinityMask = 0;
+			if (!GetProcessAffinityMask(GetCurrentProcess(), &processAffinityMask, &systemAffinityMask))
+			{
+				return;
+			}
+
+			const DWORD_PTR affinityMask = Config::cpuAffinityMask & systemAffinityMask;
+			if (0 == affinityMask || !SetProcessAffinityMask(GetCurrentProcess(), affinityMask))
+			{
+				Compat::Log() << "Failed to set the CPU affinity mask: " << Config::cpuAffinityMask;
+			}
+		}
+
+		DWORD getAvailableProcessorCount()
+		{
+			DWORD_PTR processAffinityMask = 0;
+			DWORD_PTR systemAffinityMask = 0;
+			if (!GetProcessAffinityMask(GetCurrentProcess(), &processAffinityMask, &systemAffinityMask))
+			{
+				return 1;
+			}
+
+			DWORD count = 0;
+			for (; 0 != processAffinityMask; processAffinityMask &= processAffinityMask - 1)
+			{
+				++count;
+			}
+			return count;
+		}
+	}
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <Windows.h>
+
+namespace Win32
+{
+	namespace Thread
+	{
+		void applyConfig();
+		DWORD getAvailableProcessorCount();
+	}
+}
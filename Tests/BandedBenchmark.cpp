@@ -0,0 +1,55 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <vector>
+
+#include <DDraw/Blitter.h>
+#include <Win32/Thread.h>
+
+// Throughput of large blits that the blitter splits into bands on its worker pool.
+// Run it with DDRAWCOMPAT_CPU_COUNT set to 1, 2, 4, ... to see how the bands scale.
+
+namespace
+{
+	double measureMpixPerSecond(DWORD pixelCount, const std::function<void()>& func)
+	{
+		func();
+		int iterations = 0;
+		const auto start = std::chrono::steady_clock::now();
+		std::chrono::duration<double> elapsed(0);
+		do
+		{
+			func();
+			++iterations;
+			elapsed = std::chrono::steady_clock::now() - start;
+		} while (elapsed.count() < 0.2);
+		return pixelCount * static_cast<double>(iterations) / elapsed.count() / 1e6;
+	}
+}
+
+int main()
+{
+	const DWORD width = 2048;
+	const DWORD height = 1536;
+	const DWORD pitch = width * 4;
+	std::vector<BYTE> src(pitch * height, 1);
+	std::vector<BYTE> dst(pitch * height);
+	const DWORD srcColorKey = 0x02020202;
+
+	printf("cpus=%u\n", Win32::Thread::getAvailableProcessorCount());
+	printf("fill          %7.0f Mpix/s\n", measureMpixPerSecond(width * height, [&]() {
+		DDraw::Blitter::colorFill(dst.data(), pitch, width, height, 4, 0x12345678); }));
+	printf("copy          %7.0f Mpix/s\n", measureMpixPerSecond(width * height, [&]() {
+		DDraw::Blitter::blt(dst.data(), pitch, width, height, src.data(), pitch, width, height, 4, nullptr, nullptr); }));
+	printf("keyed copy    %7.0f Mpix/s\n", measureMpixPerSecond(width * height, [&]() {
+		DDraw::Blitter::blt(dst.data(), pitch, width, height, src.data(), pitch, width, height, 4, nullptr, &srcColorKey); }));
+	printf("stretch 2x    %7.0f Mpix/s\n", measureMpixPerSecond(width * height, [&]() {
+		DDraw::Blitter::blt(dst.data(), pitch, width, height, src.data(), pitch, width / 2, height / 2, 4, nullptr, nullptr); }));
+	printf("stretch 1.6x  %7.0f Mpix/s\n", measureMpixPerSecond(width * height, [&]() {
+		DDraw::Blitter::blt(dst.data(), pitch, width, height, src.data(), pitch, 1280, 960, 4, nullptr, nullptr); }));
+
+	// The blitter worker threads are never joined, so skip static destruction
+	fflush(stdout);
+	std::_Exit(EXIT_SUCCESS);
+}
@@ -0,0 +1,780 @@
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <D3dDdi/FormatInfo.h>
+#include <DDraw/Blitter.h>
+
+// Differential tests of the runtime dispatched blitter kernels against straightforward scalar references.
+// The seed and iteration count can be passed on the command line to reproduce or extend a run.
+
+namespace
+{
+	std::mt19937 g_rng;
+
+	DWORD random(DWORD count)
+	{
+		return g_rng() % count;
+	}
+
+	DWORD readPixel(const BYTE* p, DWORD bytesPerPixel)
+	{
+		DWORD value = 0;
+		memcpy(&value, p, bytesPerPixel);
+		return value;
+	}
+
+	bool isColorKeyMatch(DWORD color, const DDCOLORKEY& colorKey, DWORD bytesPerPixel)
+	{
+		if (2 == bytesPerPixel)
+		{
+			return static_cast<WORD>(color) == static_cast<WORD>(colorKey.dwColorSpaceLowValue);
+		}
+
+		// Each 8-bit channel must be in range, alpha is ignored
+		for (DWORD i = 0; i < std::min<DWORD>(bytesPerPixel, 3); ++i)
+		{
+			const BYTE channel = static_cast<BYTE>(color >> (8 * i));
+			if (channel < static_cast<BYTE>(colorKey.dwColorSpaceLowValue >> (8 * i)) ||
+				channel > static_cast<BYTE>(colorKey.dwColorSpaceHighValue >> (8 * i)))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	void referenceBlt(BYTE* dst, DWORD dstPitch, DWORD dstWidth, DWORD dstHeight,
+		const BYTE* src, DWORD srcPitch, LONG srcWidth, LONG srcHeight,
+		DWORD bytesPerPixel, const DDCOLORKEY* dstColorKey, const DDCOLORKEY* srcColorKey)
+	{
+		const bool mirrorLeftRight = srcWidth < 0;
+		const bool mirrorUpDown = srcHeight < 0;
+		LONG deltaX = (std::abs(srcWidth) << 16) / static_cast<LONG>(dstWidth);
+		LONG deltaY = (std::abs(srcHeight) << 16) / static_cast<LONG>(dstHeight);
+		LONG offsetX = deltaX / 2;
+		LONG offsetY = deltaY / 2;
+		if (mirrorLeftRight)
+		{
+			offsetX += (dstWidth - 1) * deltaX;
+			deltaX = -deltaX;
+		}
+		if (mirrorUpDown)
+		{
+			offsetY += (dstHeight - 1) * deltaY;
+			deltaY = -deltaY;
+		}
+
+		for (DWORD y = 0; y < dstHeight; ++y)
+		{
+			const LONG srcY = (offsetY + static_cast<LONG>(y) * deltaY) >> 16;
+			for (DWORD x = 0; x < dstWidth; ++x)
+			{
+				const LONG srcX = (offsetX + static_cast<LONG>(x) * deltaX) >> 16;
+				const BYTE* srcPixel = src + srcY * static_cast<LONG>(srcPitch) + srcX * bytesPerPixel;
+				BYTE* dstPixel = dst + y * dstPitch + x * bytesPerPixel;
+				if ((!dstColorKey || isColorKeyMatch(readPixel(dstPixel, bytesPerPixel), *dstColorKey, bytesPerPixel)) &&
+					(!srcColorKey || !isColorKeyMatch(readPixel(srcPixel, bytesPerPixel), *srcColorKey, bytesPerPixel)))
+				{
+					memcpy(dstPixel, srcPixel, bytesPerPixel);
+				}
+			}
+		}
+	}
+
+	void referenceBlt(BYTE* dst, DWORD dstPitch, DWORD dstWidth, DWORD dstHeight,
+		const BYTE* src, DWORD srcPitch, LONG srcWidth, LONG srcHeight,
+		DWORD bytesPerPixel, const DWORD* dstColorKey, const DWORD* srcColorKey)
+	{
+		const DDCOLORKEY dstColorKeyRange = { dstColorKey ? *dstColorKey : 0, dstColorKey ? *dstColorKey : 0 };
+		const DDCOLORKEY srcColorKeyRange = { srcColorKey ? *srcColorKey : 0, srcColorKey ? *srcColorKey : 0 };
+		referenceBlt(dst, dstPitch, dstWidth, dstHeight, src, srcPitch, srcWidth, srcHeight, bytesPerPixel,
+			dstColorKey ? &dstColorKeyRange : nullptr, srcColorKey ? &srcColorKeyRange : nullptr);
+	}
+
+	DWORD randomColorKey()
+	{
+		// Pixels are filled with values 0-3 per byte to make key hits frequent
+		DWORD color = 0;
+		for (DWORD i = 0; i < 4; ++i)
+		{
+			color |= random(4) << (8 * i);
+		}
+		return color;
+	}
+
+	DDCOLORKEY randomColorKeyRange()
+	{
+		DDCOLORKEY colorKey = {};
+		for (DWORD i = 0; i < 4; ++i)
+		{
+			const DWORD low = random(4);
+			colorKey.dwColorSpaceLowValue |= low << (8 * i);
+			colorKey.dwColorSpaceHighValue |= (low + random(4 - low)) << (8 * i);
+		}
+		return colorKey;
+	}
+
+	DWORD randomExtent(bool isLarge, DWORD smallMax, DWORD largeMin, DWORD largeMax)
+	{
+		if (isLarge)
+		{
+			return largeMin + random(largeMax - largeMin);
+		}
+		return 1 + random(0 == random(4) ? 300 : smallMax);
+	}
+
+	int testBlt(int iterations)
+	{
+		int failures = 0;
+		for (int i = 0; i < iterations; ++i)
+		{
+			const bool isLarge = 0 == i % 50;
+			const DWORD bytesPerPixel = 1 + random(4);
+			const DWORD srcWidth = randomExtent(isLarge, 40, 300, 900);
+			const DWORD srcHeight = isLarge ? 200 + random(300) : 1 + random(12);
+			DWORD dstWidth = srcWidth;
+			DWORD dstHeight = srcHeight;
+			switch (random(4))
+			{
+			case 1:
+				dstWidth = randomExtent(isLarge, 40, 300, 1200);
+				dstHeight = isLarge ? 200 + random(700) : 1 + random(12);
+				break;
+			case 2:
+				dstWidth = srcWidth * (2 + random(3));
+				dstHeight = srcHeight * (2 + random(3));
+				break;
+			}
+
+			const bool mirrorLeftRight = 0 == random(3);
+			const bool mirrorUpDown = 0 == random(3);
+			const DWORD dstColorKey = randomColorKey();
+			const DWORD srcColorKey = randomColorKey();
+			const DWORD* dstColorKeyPtr = 0 == random(3) ? &dstColorKey : nullptr;
+			const DWORD* srcColorKeyPtr = 0 == random(3) ? &srcColorKey : nullptr;
+
+			const DWORD guard = 32;
+			const DWORD srcPitch = srcWidth * bytesPerPixel + random(20);
+			const DWORD dstPitch = dstWidth * bytesPerPixel + random(20);
+			std::vector<BYTE> src(srcPitch * srcHeight + 2 * guard);
+			std::vector<BYTE> dst(dstPitch * dstHeight + 2 * guard);
+			for (auto& b : src)
+			{
+				b = static_cast<BYTE>(random(4));
+			}
+			for (auto& b : dst)
+			{
+				b = static_cast<BYTE>(random(4));
+			}
+			std::vector<BYTE> ref(dst);
+
+			const LONG signedSrcWidth = mirrorLeftRight ? -static_cast<LONG>(srcWidth) : srcWidth;
+			const LONG signedSrcHeight = mirrorUpDown ? -static_cast<LONG>(srcHeight) : srcHeight;
+			DDraw::Blitter::blt(dst.data() + guard, dstPitch, dstWidth, dstHeight,
+				src.data() + guard, srcPitch, signedSrcWidth, signedSrcHeight,
+				bytesPerPixel, dstColorKeyPtr, srcColorKeyPtr);
+			referenceBlt(ref.data() + guard, dstPitch, dstWidth, dstHeight,
+				src.data() + guard, srcPitch, signedSrcWidth, signedSrcHeight,
+				bytesPerPixel, dstColorKeyPtr, srcColorKeyPtr);
+
+			if (dst != ref && failures++ < 10)
+			{
+				printf("blt: bpp=%u %ux%u -> %ux%u mirror=%d%d dstKey=%d srcKey=%d\n",
+					bytesPerPixel, srcWidth, srcHeight, dstWidth, dstHeight,
+					mirrorLeftRight, mirrorUpDown, nullptr != dstColorKeyPtr, nullptr != srcColorKeyPtr);
+			}
+		}
+		return failures;
+	}
+
+	int testIntegerUpscaleBlt(int iterations)
+	{
+		// Unkeyed integer upscales take the pixel duplication kernels, including the common 32bpp 2x case
+		int failures = 0;
+		for (int i = 0; i < iterations; ++i)
+		{
+			const DWORD bytesPerPixel = 3 + random(2);
+			const DWORD factor = 2 + random(4);
+			const bool isLarge = 0 == i % 20;
+			const DWORD srcWidth = isLarge ? 640 : 1 + random(0 == random(4) ? 200 : 40);
+			const DWORD srcHeight = isLarge ? 480 : 1 + random(8);
+			const DWORD dstWidth = srcWidth * factor;
+			const DWORD dstHeight = srcHeight * (1 + random(factor));
+
+			const DWORD srcPitch = srcWidth * bytesPerPixel + random(8);
+			const DWORD dstPitch = dstWidth * bytesPerPixel + random(8);
+			std::vector<BYTE> src(srcPitch * srcHeight);
+			std::vector<BYTE> dst(dstPitch * dstHeight);
+			for (auto& b : src)
+			{
+				b = static_cast<BYTE>(g_rng());
+			}
+			for (auto& b : dst)
+			{
+				b = static_cast<BYTE>(g_rng());
+			}
+			std::vector<BYTE> ref(dst);
+
+			const DWORD* noColorKey = nullptr;
+			DDraw::Blitter::blt(dst.data(), dstPitch, dstWidth, dstHeight,
+				src.data(), srcPitch, srcWidth, srcHeight, bytesPerPixel, noColorKey, noColorKey);
+			referenceBlt(ref.data(), dstPitch, dstWidth, dstHeight,
+				src.data(), srcPitch, srcWidth, srcHeight, bytesPerPixel, noColorKey, noColorKey);
+
+			if (dst != ref && failures++ < 10)
+			{
+				printf("integer upscale blt: bpp=%u %ux%u -> %ux%u\n",
+					bytesPerPixel, srcWidth, srcHeight, dstWidth, dstHeight);
+			}
+		}
+		return failures;
+	}
+
+	int testClippedBlt(int iterations)
+	{
+		int failures = 0;
+		for (int i = 0; i < iterations; ++i)
+		{
+			const DWORD bytesPerPixel = 1 + random(4);
+			const DWORD srcWidth = 1 + random(70);
+			const DWORD srcHeight = 1 + random(30);
+			const DWORD dstWidth = random(3) ? srcWidth : 1 + random(90);
+			const DWORD dstHeight = random(3) ? srcHeight : 1 + random(40);
+			const LONG signedSrcWidth = random(4) ? static_cast<LONG>(srcWidth) : -static_cast<LONG>(srcWidth);
+			const LONG signedSrcHeight = random(4) ? static_cast<LONG>(srcHeight) : -static_cast<LONG>(srcHeight);
+			const DWORD srcColorKey = randomColorKey();
+			const DWORD* srcColorKeyPtr = 0 == random(3) ? &srcColorKey : nullptr;
+
+			const DWORD srcPitch = srcWidth * bytesPerPixel + random(5);
+			const DWORD dstPitch = dstWidth * bytesPerPixel + random(5);
+			std::vector<BYTE> src(srcPitch * srcHeight);
+			std::vector<BYTE> dst(dstPitch * dstHeight);
+			for (auto& b : src)
+			{
+				b = static_cast<BYTE>(random(4));
+			}
+			for (auto& b : dst)
+			{
+				b = static_cast<BYTE>(random(4));
+			}
+
+			std::vector<BYTE> unclipped(dst);
+			DDraw::Blitter::blt(unclipped.data(), dstPitch, dstWidth, dstHeight,
+				src.data(), srcPitch, signedSrcWidth, signedSrcHeight, bytesPerPixel, nullptr, srcColorKeyPtr);
+
+			std::vector<RECT> clipRects(random(6));
+			for (auto& rect : clipRects)
+			{
+				rect.left = static_cast<LONG>(random(dstWidth + 4)) - 2;
+				rect.top = static_cast<LONG>(random(dstHeight + 4)) - 2;
+				rect.right = rect.left + static_cast<LONG>(random(dstWidth)) + 1;
+				rect.bottom = rect.top + static_cast<LONG>(random(dstHeight)) + 1;
+			}
+
+			std::vector<BYTE> ref(dst);
+			for (DWORD y = 0; y < dstHeight; ++y)
+			{
+				for (DWORD x = 0; x < dstWidth; ++x)
+				{
+					for (const auto& rect : clipRects)
+					{
+						if (static_cast<LONG>(x) >= rect.left && static_cast<LONG>(x) < rect.right &&
+							static_cast<LONG>(y) >= rect.top && static_cast<LONG>(y) < rect.bottom)
+						{
+							memcpy(&ref[y * dstPitch + x * bytesPerPixel], &unclipped[y * dstPitch + x * bytesPerPixel],
+								bytesPerPixel);
+						}
+					}
+				}
+			}
+
+			DDraw::Blitter::blt(dst.data(), dstPitch, dstWidth, dstHeight,
+				src.data(), srcPitch, signedSrcWidth, signedSrcHeight, bytesPerPixel, nullptr, srcColorKeyPtr,
+				clipRects.data(), static_cast<DWORD>(clipRects.size()));
+
+			if (dst != ref && failures++ < 10)
+			{
+				printf("clipped blt: bpp=%u %ux%u -> %ux%u rects=%zu\n",
+					bytesPerPixel, srcWidth, srcHeight, dstWidth, dstHeight, clipRects.size());
+			}
+		}
+		return failures;
+	}
+
+	int testOverlappingBlt(int iterations)
+	{
+		int failures = 0;
+		for (int i = 0; i < iterations; ++i)
+		{
+			const DWORD bytesPerPixel = 1 + random(4);
+			const DWORD width = 1 + random(64);
+			const DWORD height = 1 + random(48);
+			const DWORD pitch = width * bytesPerPixel + (random(2) ? 0 : random(16));
+			std::vector<BYTE> surface(pitch * height);
+			for (auto& b : surface)
+			{
+				b = static_cast<BYTE>(random(4));
+			}
+
+			const DWORD dstWidth = 1 + random(width);
+			const DWORD dstHeight = 1 + random(height);
+			const DWORD dstX = random(width - dstWidth + 1);
+			const DWORD dstY = random(height - dstHeight + 1);
+			const DWORD srcWidth = random(3) ? dstWidth : 1 + random(width);
+			const DWORD srcHeight = random(3) ? dstHeight : 1 + random(height);
+			DWORD srcX = random(width - srcWidth + 1);
+			DWORD srcY = random(height - srcHeight + 1);
+			if (random(2))
+			{
+				srcX = std::min<DWORD>(width - srcWidth, dstX + random(3));
+				srcY = std::min<DWORD>(height - srcHeight, dstY + random(3));
+			}
+			const LONG signedSrcWidth = random(4) ? static_cast<LONG>(srcWidth) : -static_cast<LONG>(srcWidth);
+			const LONG signedSrcHeight = random(4) ? static_cast<LONG>(srcHeight) : -static_cast<LONG>(srcHeight);
+			const DWORD srcColorKey = randomColorKey();
+			const DWORD* srcColorKeyPtr = 0 == random(4) ? &srcColorKey : nullptr;
+
+			std::vector<BYTE> ref(surface);
+			const std::vector<BYTE> srcCopy(surface);
+			DDraw::Blitter::blt(ref.data() + dstY * pitch + dstX * bytesPerPixel, pitch, dstWidth, dstHeight,
+				srcCopy.data() + srcY * pitch + srcX * bytesPerPixel, pitch, signedSrcWidth, signedSrcHeight,
+				bytesPerPixel, nullptr, srcColorKeyPtr);
+			DDraw::Blitter::blt(surface.data() + dstY * pitch + dstX * bytesPerPixel, pitch, dstWidth, dstHeight,
+				surface.data() + srcY * pitch + srcX * bytesPerPixel, pitch, signedSrcWidth, signedSrcHeight,
+				bytesPerPixel, nullptr, srcColorKeyPtr);
+
+			if (surface != ref && failures++ < 10)
+			{
+				printf("overlapping blt: bpp=%u dst=%u,%u %ux%u src=%u,%u %dx%d\n",
+					bytesPerPixel, dstX, dstY, dstWidth, dstHeight, srcX, srcY, signedSrcWidth, signedSrcHeight);
+			}
+		}
+		return failures;
+	}
+
+	int testConcurrentBlt(int iterations)
+	{
+		// Large enough to be split into bands; concurrent callers must not disturb each other's job
+		const DWORD width = 1024;
+		const DWORD height = 768;
+		const DWORD pitch = width * 4;
+		const int threadCount = 4;
+		std::vector<int> failures(threadCount);
+		std::vector<std::thread> threads;
+
+		for (int t = 0; t < threadCount; ++t)
+		{
+			threads.emplace_back([&, t]()
+			{
+				std::mt19937 rng(t);
+				std::vector<BYTE> src(pitch * height);
+				for (auto& b : src)
+				{
+					b = static_cast<BYTE>(rng() % 4);
+				}
+				std::vector<BYTE> dst(pitch * height);
+				std::vector<BYTE> ref(pitch * height);
+
+				for (int i = 0; i < iterations; ++i)
+				{
+					const DWORD srcColorKey = i % 4 * 0x01010101u;
+					const LONG srcWidth = i % 2 ? -static_cast<LONG>(width / 2) : width / 2;
+					std::fill(dst.begin(), dst.end(), static_cast<BYTE>(t));
+					std::fill(ref.begin(), ref.end(), static_cast<BYTE>(t));
+					DDraw::Blitter::blt(dst.data(), pitch, width, height, src.data(), pitch, srcWidth, height / 2,
+						4, nullptr, &srcColorKey);
+					referenceBlt(ref.data(), pitch, width, height, src.data(), pitch, srcWidth, height / 2,
+						4, nullptr, &srcColorKey);
+					if (dst != ref)
+					{
+						++failures[t];
+					}
+				}
+			});
+		}
+
+		for (auto& thread : threads)
+		{
+			thread.join();
+		}
+
+		int totalFailures = 0;
+		for (int f : failures)
+		{
+			totalFailures += f;
+		}
+		return totalFailures;
+	}
+
+	int testColorKeyRangeBlt(int iterations)
+	{
+		int failures = 0;
+		for (int i = 0; i < iterations; ++i)
+		{
+			const DWORD bytesPerPixel = 1 + random(4);
+			const DWORD srcWidth = 1 + random(0 == random(4) ? 300 : 70);
+			const DWORD srcHeight = 1 + random(8);
+			const DWORD dstWidth = random(3) ? srcWidth : 1 + random(70);
+			const DWORD dstHeight = srcHeight;
+			const LONG signedSrcWidth = random(3) ? static_cast<LONG>(srcWidth) : -static_cast<LONG>(srcWidth);
+			const DDCOLORKEY dstColorKey = randomColorKeyRange();
+			const DDCOLORKEY srcColorKey = randomColorKeyRange();
+			const DDCOLORKEY* dstColorKeyPtr = 0 == random(2) ? &dstColorKey : nullptr;
+			const DDCOLORKEY* srcColorKeyPtr = !dstColorKeyPtr || random(2) ? &srcColorKey : nullptr;
+			const RECT clipRect = { 0, 0, static_cast<LONG>(dstWidth), static_cast<LONG>(dstHeight) };
+
+			const DWORD srcPitch = srcWidth * bytesPerPixel + random(8);
+			const DWORD dstPitch = dstWidth * bytesPerPixel + random(8);
+			std::vector<BYTE> src(srcPitch * srcHeight);
+			std::vector<BYTE> dst(dstPitch * dstHeight);
+			for (auto& b : src)
+			{
+				b = static_cast<BYTE>(random(4));
+			}
+			for (auto& b : dst)
+			{
+				b = static_cast<BYTE>(random(4));
+			}
+			std::vector<BYTE> ref(dst);
+
+			const DWORD mask = 2 == bytesPerPixel ? 0xFFFF : 0xFFFFFF;
+			const bool isRange =
+				(dstColorKeyPtr && 0 != ((dstColorKey.dwColorSpaceLowValue ^ dstColorKey.dwColorSpaceHighValue) & mask)) ||
+				(srcColorKeyPtr && 0 != ((srcColorKey.dwColorSpaceLowValue ^ srcColorKey.dwColorSpaceHighValue) & mask));
+			const bool isSupported = DDraw::Blitter::colorKeyRangeBlt(dst.data(), dstPitch, dstWidth, dstHeight,
+				src.data(), srcPitch, signedSrcWidth, srcHeight, bytesPerPixel, dstColorKeyPtr, srcColorKeyPtr,
+				&clipRect, 1);
+			if (isSupported)
+			{
+				referenceBlt(ref.data(), dstPitch, dstWidth, dstHeight, src.data(), srcPitch, signedSrcWidth, srcHeight,
+					bytesPerPixel, dstColorKeyPtr, srcColorKeyPtr);
+			}
+
+			if ((isSupported != (2 != bytesPerPixel || !isRange) || dst != ref) && failures++ < 10)
+			{
+				printf("colorKeyRangeBlt: bpp=%u %ux%u -> %ux%u dstKey=%d srcKey=%d supported=%d\n",
+					bytesPerPixel, srcWidth, srcHeight, dstWidth, dstHeight,
+					nullptr != dstColorKeyPtr, nullptr != srcColorKeyPtr, isSupported);
+			}
+		}
+		return failures;
+	}
+
+	const D3DDDIFORMAT g_convertibleFormats[] = {
+		D3DDDIFMT_R5G6B5, D3DDDIFMT_X1R5G5B5, D3DDDIFMT_A1R5G5B5, D3DDDIFMT_A4R4G4B4, D3DDDIFMT_X4R4G4B4,
+		D3DDDIFMT_A8R3G3B2, D3DDDIFMT_R8G8B8, D3DDDIFMT_A8R8G8B8, D3DDDIFMT_X8R8G8B8, D3DDDIFMT_A8B8G8R8,
+		D3DDDIFMT_X8B8G8R8
+	};
+
+	DWORD expandReferenceChannel(DWORD pixel, BYTE bitCount, BYTE pos)
+	{
+		// Replicates the channel bits down to the lowest bit, so that the maximum value maps to 0xFF
+		DWORD value = ((pixel >> pos) & ((1 << bitCount) - 1)) << (8 - bitCount);
+		for (BYTE shift = bitCount; shift < 8; shift += bitCount)
+		{
+			value |= value >> shift;
+		}
+		return value;
+	}
+
+	DWORD getChannelMask(const D3dDdi::FormatInfo& fi)
+	{
+		return (((1 << fi.alphaBitCount) - 1) << fi.alphaPos) | (((1 << fi.redBitCount) - 1) << fi.redPos) |
+			(((1 << fi.greenBitCount) - 1) << fi.greenPos) | (((1 << fi.blueBitCount) - 1) << fi.bluePos);
+	}
+
+	DWORD getColorKeyMask(DWORD bytesPerPixel)
+	{
+		return 4 == bytesPerPixel ? 0x00FFFFFF : (1 << (8 * bytesPerPixel)) - 1;
+	}
+
+	DWORD referenceConvertPixel(DWORD pixel, const D3dDdi::FormatInfo& dstFormatInfo,
+		const D3dDdi::FormatInfo& srcFormatInfo)
+	{
+		const DWORD alpha = 0 == srcFormatInfo.alphaBitCount
+			? 0xFF : expandReferenceChannel(pixel, srcFormatInfo.alphaBitCount, srcFormatInfo.alphaPos);
+		const D3DCOLOR argb = (alpha << 24) |
+			(expandReferenceChannel(pixel, srcFormatInfo.redBitCount, srcFormatInfo.redPos) << 16) |
+			(expandReferenceChannel(pixel, srcFormatInfo.greenBitCount, srcFormatInfo.greenPos) << 8) |
+			expandReferenceChannel(pixel, srcFormatInfo.blueBitCount, srcFormatInfo.bluePos);
+		return D3dDdi::colorConvert(dstFormatInfo, argb);
+	}
+
+	int testConvertBlt(int iterations)
+	{
+		int failures = 0;
+		for (int i = 0; i < iterations; ++i)
+		{
+			const auto dstFormat = g_convertibleFormats[random(sizeof(g_convertibleFormats) / sizeof(D3DDDIFORMAT))];
+			const auto srcFormat = g_convertibleFormats[random(sizeof(g_convertibleFormats) / sizeof(D3DDDIFORMAT))];
+			const auto dstFormatInfo = D3dDdi::getFormatInfo(dstFormat);
+			const auto srcFormatInfo = D3dDdi::getFormatInfo(srcFormat);
+			const DWORD dstBpp = dstFormatInfo.bytesPerPixel;
+			const DWORD srcBpp = srcFormatInfo.bytesPerPixel;
+
+			const bool isLarge = 0 == i % 50;
+			const DWORD srcWidth = randomExtent(isLarge, 40, 300, 900);
+			const DWORD srcHeight = isLarge ? 200 + random(300) : 1 + random(8);
+			const DWORD dstWidth = random(3) ? srcWidth : randomExtent(isLarge, 40, 300, 900);
+			const DWORD dstHeight = random(3) ? srcHeight : (isLarge ? 200 + random(300) : 1 + random(8));
+			const LONG signedSrcWidth = random(4) ? static_cast<LONG>(srcWidth) : -static_cast<LONG>(srcWidth);
+			const LONG signedSrcHeight = random(4) ? static_cast<LONG>(srcHeight) : -static_cast<LONG>(srcHeight);
+
+			// Keyed runs use few distinct byte values to make key hits frequent
+			const bool isKeyed = 0 == random(2);
+			const DWORD dstColorKey = randomColorKey();
+			const DWORD srcColorKey = randomColorKey();
+			const DWORD* dstColorKeyPtr = isKeyed && random(2) ? &dstColorKey : nullptr;
+			const DWORD* srcColorKeyPtr = isKeyed && (!dstColorKeyPtr || random(2)) ? &srcColorKey : nullptr;
+
+			const DWORD srcPitch = srcWidth * srcBpp + random(8);
+			const DWORD dstPitch = dstWidth * dstBpp + random(8);
+			std::vector<BYTE> src(srcPitch * srcHeight);
+			std::vector<BYTE> dst(dstPitch * dstHeight);
+			for (auto& b : src)
+			{
+				b = static_cast<BYTE>(isKeyed ? random(4) : g_rng());
+			}
+			for (auto& b : dst)
+			{
+				b = static_cast<BYTE>(isKeyed ? random(4) : g_rng());
+			}
+
+			// Sample the source the same way as referenceBlt, then convert and key each pixel
+			std::vector<BYTE> sampled(dstWidth * dstHeight * srcBpp);
+			referenceBlt(sampled.data(), dstWidth * srcBpp, dstWidth, dstHeight, src.data(), srcPitch,
+				signedSrcWidth, signedSrcHeight, srcBpp, static_cast<const DWORD*>(nullptr), nullptr);
+
+			std::vector<BYTE> ref(dst);
+			for (DWORD y = 0; y < dstHeight; ++y)
+			{
+				for (DWORD x = 0; x < dstWidth; ++x)
+				{
+					const DWORD srcPixel = readPixel(&sampled[(y * dstWidth + x) * srcBpp], srcBpp);
+					BYTE* dstPixel = &ref[y * dstPitch + x * dstBpp];
+					if ((srcColorKeyPtr && ((srcPixel ^ srcColorKey) & getColorKeyMask(srcBpp)) == 0) ||
+						(dstColorKeyPtr && ((readPixel(dstPixel, dstBpp) ^ dstColorKey) & getColorKeyMask(dstBpp)) != 0))
+					{
+						continue;
+					}
+					const DWORD converted = referenceConvertPixel(srcPixel, dstFormatInfo, srcFormatInfo);
+					memcpy(dstPixel, &converted, dstBpp);
+				}
+			}
+
+			DDraw::Blitter::convertBlt(dst.data(), dstPitch, dstWidth, dstHeight, dstFormatInfo,
+				src.data(), srcPitch, signedSrcWidth, signedSrcHeight, srcFormatInfo, dstColorKeyPtr, srcColorKeyPtr);
+
+			// Unused X bits of converted pixels are unspecified
+			const DWORD mask = getChannelMask(dstFormatInfo);
+			bool isMatch = true;
+			for (DWORD y = 0; y < dstHeight && isMatch; ++y)
+			{
+				for (DWORD x = 0; x < dstWidth && isMatch; ++x)
+				{
+					const DWORD offset = y * dstPitch + x * dstBpp;
+					isMatch = 0 == ((readPixel(&dst[offset], dstBpp) ^ readPixel(&ref[offset], dstBpp)) & mask);
+				}
+			}
+
+			if (!isMatch && failures++ < 10)
+			{
+				printf("convertBlt: format=%d -> %d %ux%u -> %ux%u mirror=%d%d dstKey=%d srcKey=%d\n",
+					srcFormat, dstFormat, srcWidth, srcHeight, dstWidth, dstHeight,
+					signedSrcWidth < 0, signedSrcHeight < 0, nullptr != dstColorKeyPtr, nullptr != srcColorKeyPtr);
+			}
+		}
+
+		const D3DDDIFORMAT unsupportedFormats[] = { D3DDDIFMT_P8, D3DDDIFMT_A8, D3DDDIFMT_R3G3B2, D3DDDIFMT_G8R8 };
+		for (auto format : unsupportedFormats)
+		{
+			if (DDraw::Blitter::isConvertBltSupported(D3dDdi::getFormatInfo(D3DDDIFMT_X8R8G8B8),
+				D3dDdi::getFormatInfo(format)) && failures++ < 10)
+			{
+				printf("isConvertBltSupported: format=%d is not convertible\n", format);
+			}
+		}
+		return failures;
+	}
+
+	int testPaletteBlt(int iterations)
+	{
+		int failures = 0;
+		DWORD palette[256] = {};
+		for (int i = 0; i < iterations; ++i)
+		{
+			for (auto& entry : palette)
+			{
+				entry = g_rng();
+			}
+
+			const bool isLarge = 0 == i % 20;
+			const DWORD width = isLarge ? 640 + random(400) : 1 + random(0 == random(4) ? 300 : 40);
+			const DWORD height = isLarge ? 480 + random(300) : 1 + random(8);
+			const DWORD srcPitch = width + random(8);
+			const DWORD dstPitch = width * 4 + random(8);
+			std::vector<BYTE> src(srcPitch * height);
+			for (auto& b : src)
+			{
+				b = static_cast<BYTE>(g_rng());
+			}
+			std::vector<BYTE> dst(dstPitch * height);
+			for (auto& b : dst)
+			{
+				b = static_cast<BYTE>(g_rng());
+			}
+			std::vector<BYTE> ref(dst);
+
+			for (DWORD y = 0; y < height; ++y)
+			{
+				for (DWORD x = 0; x < width; ++x)
+				{
+					memcpy(&ref[y * dstPitch + x * 4], &palette[src[y * srcPitch + x]], 4);
+				}
+			}
+			DDraw::Blitter::paletteBlt(dst.data(), dstPitch, width, height, src.data(), srcPitch, palette);
+
+			if (dst != ref && failures++ < 10)
+			{
+				printf("paletteBlt: %ux%u\n", width, height);
+			}
+		}
+		return failures;
+	}
+
+	int testColorFill(int iterations)
+	{
+		int failures = 0;
+		for (int i = 0; i < iterations; ++i)
+		{
+			const bool isLarge = 0 == i % 20;
+			const DWORD bytesPerPixel = 1 + random(4);
+			const DWORD width = isLarge ? 500 + random(1000) : 1 + random(300);
+			const DWORD height = isLarge ? 300 + random(600) : 1 + random(10);
+			const DWORD pitch = width * bytesPerPixel + random(20);
+			std::vector<BYTE> dst(pitch * height + 64);
+			for (auto& b : dst)
+			{
+				b = static_cast<BYTE>(g_rng());
+			}
+			std::vector<BYTE> ref(dst);
+
+			DWORD color = g_rng();
+			if (bytesPerPixel < 4)
+			{
+				color &= (1u << (8 * bytesPerPixel)) - 1;
+			}
+			for (DWORD y = 0; y < height; ++y)
+			{
+				for (DWORD x = 0; x < width; ++x)
+				{
+					memcpy(&ref[32 + y * pitch + x * bytesPerPixel], &color, bytesPerPixel);
+				}
+			}
+			DDraw::Blitter::colorFill(dst.data() + 32, pitch, width, height, bytesPerPixel, color);
+
+			if (dst != ref && failures++ < 10)
+			{
+				printf("colorFill: bpp=%u %ux%u\n", bytesPerPixel, width, height);
+			}
+		}
+		return failures;
+	}
+
+	int testRotateBlt(int iterations)
+	{
+		int failures = 0;
+		for (int i = 0; i < iterations; ++i)
+		{
+			const DWORD bytesPerPixel = 1 + random(4);
+			const auto rotation = static_cast<DDraw::Blitter::Rotation>(random(3));
+			const DWORD dstWidth = 1 + random(70);
+			const DWORD dstHeight = 1 + random(70);
+			const DWORD srcWidth = DDraw::Blitter::ROTATE_180 == rotation ? dstWidth : dstHeight;
+			const DWORD srcHeight = DDraw::Blitter::ROTATE_180 == rotation ? dstHeight : dstWidth;
+			const DWORD srcPitch = srcWidth * bytesPerPixel + random(9);
+			const DWORD dstPitch = dstWidth * bytesPerPixel + random(9);
+			std::vector<BYTE> src(srcPitch * srcHeight);
+			for (auto& b : src)
+			{
+				b = static_cast<BYTE>(g_rng());
+			}
+			std::vector<BYTE> dst(dstPitch * dstHeight, 0xCD);
+			std::vector<BYTE> ref(dst);
+
+			for (DWORD y = 0; y < dstHeight; ++y)
+			{
+				for (DWORD x = 0; x < dstWidth; ++x)
+				{
+					DWORD srcX = 0;
+					DWORD srcY = 0;
+					switch (rotation)
+					{
+					case DDraw::Blitter::ROTATE_90:
+						srcX = y;
+						srcY = srcHeight - 1 - x;
+						break;
+					case DDraw::Blitter::ROTATE_180:
+						srcX = srcWidth - 1 - x;
+						srcY = srcHeight - 1 - y;
+						break;
+					case DDraw::Blitter::ROTATE_270:
+						srcX = srcWidth - 1 - y;
+						srcY = x;
+						break;
+					}
+					memcpy(&ref[y * dstPitch + x * bytesPerPixel], &src[srcY * srcPitch + srcX * bytesPerPixel],
+						bytesPerPixel);
+				}
+			}
+			DDraw::Blitter::rotateBlt(dst.data(), dstPitch, dstWidth, dstHeight,
+				src.data(), srcPitch, bytesPerPixel, rotation);
+
+			if (dst != ref && failures++ < 10)
+			{
+				printf("rotateBlt: bpp=%u rotation=%d %ux%u\n", bytesPerPixel, rotation, dstWidth, dstHeight);
+			}
+		}
+		return failures;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	const unsigned seed = argc > 1 ? std::strtoul(argv[1], nullptr, 0) : 1;
+	const int iterations = argc > 2 ? std::atoi(argv[2]) : 20000;
+	g_rng.seed(seed);
+
+	int failures = 0;
+	const struct
+	{
+		const char* name;
+		int(*func)(int);
+		int iterations;
+	} tests[] = {
+		{ "blt", &testBlt, iterations },
+		{ "integer upscale blt", &testIntegerUpscaleBlt, iterations / 10 },
+		{ "clipped blt", &testClippedBlt, iterations },
+		{ "overlapping blt", &testOverlappingBlt, iterations },
+		{ "concurrent blt", &testConcurrentBlt, iterations / 1000 },
+		{ "colorKeyRangeBlt", &testColorKeyRangeBlt, iterations },
+		{ "convertBlt", &testConvertBlt, iterations / 10 },
+		{ "paletteBlt", &testPaletteBlt, iterations / 10 },
+		{ "colorFill", &testColorFill, iterations / 10 },
+		{ "rotateBlt", &testRotateBlt, iterations / 10 }
+	};
+
+	for (const auto& test : tests)
+	{
+		const int testFailures = test.func(test.iterations);
+		printf("%s: %d/%d failed\n", test.name, testFailures, test.iterations);
+		failures += testFailures;
+	}
+
+	// The blitter worker threads are never joined, so skip static destruction
+	fflush(stdout);
+	std::_Exit(0 == failures ? EXIT_SUCCESS : EXIT_FAILURE);
+}
@@ -0,0 +1,315 @@
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <random>
+#include <vector>
+
+#include <Config/Config.h>
+#include <D3dDdi/Device.h>
+#include <D3dDdi/DynamicBuffer.h>
+
+// Drives the dynamic buffers through a mock D3DDDI_DEVICEFUNCS table that models GPU reads as
+// "every range written before an event query is issued stays in use until the query signals".
+
+namespace
+{
+	struct MockResource
+	{
+		D3DDDIFORMAT format;
+		std::vector<BYTE> data;
+		std::vector<D3DDDI_RANGE> pendingRanges;
+		std::vector<D3DDDI_RANGE> submittedRanges;
+		HANDLE query;
+	};
+
+	struct MockDriver
+	{
+		std::map<HANDLE, MockResource> resources;
+		std::map<HANDLE, HANDLE> queryResources;
+		UINT_PTR nextHandle = 1;
+		HANDLE lastResource = nullptr;
+		HANDLE boundResource = nullptr;
+		bool isGpuIdle = true;
+		bool isIndex32Supported = true;
+		UINT discardCount = 0;
+		UINT noOverwriteCount = 0;
+		UINT bindCount = 0;
+		UINT errorCount = 0;
+	};
+
+	MockDriver g_driver;
+
+	void error(const char* msg)
+	{
+		if (g_driver.errorCount++ < 10)
+		{
+			printf("error: %s\n", msg);
+		}
+	}
+
+	bool isOverlapping(const D3DDDI_RANGE& a, const D3DDDI_RANGE& b)
+	{
+		return a.Offset < b.Offset + b.Size && b.Offset < a.Offset + a.Size;
+	}
+
+	HRESULT createResource(HANDLE, D3DDDIARG_CREATERESOURCE* data)
+	{
+		if (D3DDDIFMT_INDEX32 == data->Format && !g_driver.isIndex32Supported)
+		{
+			return -1;
+		}
+		if (!data->Flags.Dynamic || !data->Flags.WriteOnly || 1 != data->SurfCount)
+		{
+			error("dynamic buffer created without Dynamic/WriteOnly");
+		}
+
+		HANDLE resource = reinterpret_cast<HANDLE>(g_driver.nextHandle++);
+		g_driver.resources[resource] = { data->Format, std::vector<BYTE>(data->pSurfList[0].Width), {}, {}, nullptr };
+		g_driver.lastResource = resource;
+		data->hResource = resource;
+		return S_OK;
+	}
+
+	HRESULT destroyResource(HANDLE, HANDLE resource)
+	{
+		if (0 == g_driver.resources.erase(resource))
+		{
+			error("destroying unknown resource");
+		}
+		return S_OK;
+	}
+
+	HRESULT createQuery(HANDLE, D3DDDIARG_CREATEQUERY* data)
+	{
+		if (D3DDDIQUERYTYPE_EVENT != data->QueryType)
+		{
+			error("unexpected query type");
+		}
+		HANDLE query = reinterpret_cast<HANDLE>(g_driver.nextHandle++);
+		g_driver.queryResources[query] = g_driver.lastResource;
+		g_driver.resources[g_driver.lastResource].query = query;
+		data->hQuery = query;
+		return S_OK;
+	}
+
+	HRESULT destroyQuery(HANDLE, HANDLE query)
+	{
+		if (0 == g_driver.queryResources.erase(query))
+		{
+			error("destroying unknown query");
+		}
+		return S_OK;
+	}
+
+	HRESULT issueQuery(HANDLE, const D3DDDIARG_ISSUEQUERY* data)
+	{
+		auto& resource = g_driver.resources[g_driver.queryResources[data->hQuery]];
+		resource.submittedRanges.insert(resource.submittedRanges.end(),
+			resource.pendingRanges.begin(), resource.pendingRanges.end());
+		resource.pendingRanges.clear();
+		return S_OK;
+	}
+
+	HRESULT getQueryData(HANDLE, const D3DDDIARG_GETQUERYDATA* data)
+	{
+		*static_cast<BOOL*>(data->pData) = g_driver.isGpuIdle;
+		if (g_driver.isGpuIdle)
+		{
+			g_driver.resources[g_driver.queryResources[data->hQuery]].submittedRanges.clear();
+			return S_OK;
+		}
+		return 1;
+	}
+
+	HRESULT lock(HANDLE, D3DDDIARG_LOCK* data)
+	{
+		auto it = g_driver.resources.find(data->hResource);
+		if (it == g_driver.resources.end())
+		{
+			error("locking unknown resource");
+			return -1;
+		}
+
+		auto& resource = it->second;
+		if (!data->Flags.RangeValid || data->Range.Offset + data->Range.Size > resource.data.size())
+		{
+			error("lock range out of bounds");
+			return -1;
+		}
+
+		if (data->Flags.Discard)
+		{
+			++g_driver.discardCount;
+			resource.submittedRanges.clear();
+		}
+		else
+		{
+			if (!data->Flags.NoOverwrite || !data->Flags.WriteOnly)
+			{
+				error("lock is neither Discard nor WriteOnly/NoOverwrite");
+			}
+			++g_driver.noOverwriteCount;
+			for (const auto& range : resource.submittedRanges)
+			{
+				if (isOverlapping(range, data->Range))
+				{
+					error("NoOverwrite lock overlaps a range still in use by the GPU");
+				}
+			}
+		}
+
+		resource.pendingRanges.push_back(data->Range);
+		data->pSurfData = resource.data.data() + data->Range.Offset;
+		return S_OK;
+	}
+
+	HRESULT unlock(HANDLE, const D3DDDIARG_UNLOCK*)
+	{
+		return S_OK;
+	}
+
+	HRESULT setIndices(HANDLE, const D3DDDIARG_SETINDICES* data)
+	{
+		++g_driver.bindCount;
+		g_driver.boundResource = data->hIndexBuffer;
+		return S_OK;
+	}
+
+	HRESULT setStreamSource(HANDLE, const D3DDDIARG_SETSTREAMSOURCE* data)
+	{
+		++g_driver.bindCount;
+		g_driver.boundResource = data->hVertexBuffer;
+		return S_OK;
+	}
+
+	const D3DDDI_DEVICEFUNCS g_deviceFuncs = {
+		&createResource, nullptr, &destroyResource, &createQuery, &destroyQuery, &issueQuery, &getQueryData,
+		&lock, &unlock, &setIndices, &setStreamSource
+	};
+
+	D3dDdi::Device g_device(reinterpret_cast<HANDLE>(0xDE71CE), g_deviceFuncs);
+
+	void check(bool condition, const char* msg)
+	{
+		if (!condition)
+		{
+			error(msg);
+		}
+	}
+
+	template <typename Index>
+	void checkIndices(const D3dDdi::DynamicIndexBuffer& ib, INT pos, const std::vector<UINT>& indices)
+	{
+		const auto& data = g_driver.resources[ib].data;
+		auto stored = reinterpret_cast<const Index*>(data.data()) + pos;
+		for (UINT i = 0; i < indices.size(); ++i)
+		{
+			if (stored[i] != static_cast<Index>(indices[i]))
+			{
+				error("index data mismatch");
+				return;
+			}
+		}
+	}
+
+	void testIndexBuffer(bool is32Bit, bool isGpuIdle)
+	{
+		g_driver.isIndex32Supported = is32Bit;
+		g_driver.isGpuIdle = isGpuIdle;
+		g_driver.discardCount = 0;
+		g_driver.bindCount = 0;
+
+		std::mt19937 rng(is32Bit * 2 + isGpuIdle);
+		{
+			D3dDdi::DynamicIndexBuffer ib(g_device, 1000, true);
+			check(Config::dynamicBufferSegments == g_driver.resources.size(), "unexpected segment count");
+			check((is32Bit ? 4u : 2u) == ib.getStride(), "32-bit index fallback stride");
+
+			for (UINT i = 0; i < 200; ++i)
+			{
+				std::vector<UINT> indices(1 + rng() % (1000 / ib.getStride() / 4));
+				for (auto& index : indices)
+				{
+					index = is32Bit ? rng() : rng() % 0x10000;
+				}
+
+				HANDLE resource = ib;
+				const INT pos = ib.load(indices.data(), static_cast<UINT>(indices.size()));
+				check(pos >= 0, "load failed");
+				if (resource != static_cast<HANDLE>(ib))
+				{
+					check(0 == pos, "new segment not filled from the start");
+					check(g_driver.boundResource == static_cast<HANDLE>(ib), "new segment not bound");
+				}
+
+				if (is32Bit)
+				{
+					checkIndices<UINT>(ib, pos, indices);
+				}
+				else
+				{
+					checkIndices<UINT16>(ib, pos, indices);
+				}
+			}
+
+			check(isGpuIdle == (0 == g_driver.discardCount), isGpuIdle
+				? "discarded a retired segment" : "reused a busy segment without discarding it");
+			check(0 != g_driver.bindCount, "segments never rotated");
+
+			ib.resize(0);
+			check(g_driver.resources.empty() && g_driver.queryResources.empty(), "resize(0) leaked resources");
+			check(nullptr == static_cast<HANDLE>(ib), "empty buffer has a handle");
+		}
+		check(g_driver.resources.empty() && g_driver.queryResources.empty(), "destructor leaked resources");
+	}
+
+	void testVertexBufferMap()
+	{
+		g_driver.isGpuIdle = false;
+		const UINT stride = 24;
+		{
+			D3dDdi::DynamicVertexBuffer vb(g_device, 64 * 1024);
+			vb.setStride(stride);
+
+			UINT expectedPos = 0;
+			for (UINT i = 0; i < 100; ++i)
+			{
+				HANDLE resource = vb;
+				UINT mappedSize = 0;
+				auto vertices = static_cast<BYTE*>(vb.map(stride * 100, mappedSize));
+				check(nullptr != vertices, "map failed");
+				if (resource != static_cast<HANDLE>(vb))
+				{
+					expectedPos = 0;
+				}
+				check(mappedSize >= stride * 100, "mapped range smaller than requested");
+
+				const UINT usedSize = stride * (1 + i % 100);
+				memset(vertices, static_cast<int>(i), usedSize);
+				const INT pos = vb.unmap(usedSize);
+				check(static_cast<UINT>(pos) == expectedPos / stride, "unexpected vertex position");
+				check(g_driver.resources[vb].data[pos * stride] == static_cast<BYTE>(i), "vertex data mismatch");
+				expectedPos += usedSize;
+			}
+		}
+		check(g_driver.resources.empty() && g_driver.queryResources.empty(), "destructor leaked resources");
+	}
+}
+
+int main()
+{
+	for (bool is32Bit : { true, false })
+	{
+		for (bool isGpuIdle : { true, false })
+		{
+			testIndexBuffer(is32Bit, isGpuIdle);
+			printf("index buffer: 32-bit=%d gpuIdle=%d errors=%u\n", is32Bit, isGpuIdle, g_driver.errorCount);
+		}
+	}
+
+	testVertexBufferMap();
+	printf("vertex buffer map: errors=%u\n", g_driver.errorCount);
+
+	printf("locks: %u NoOverwrite, %u Discard\n", g_driver.noOverwriteCount, g_driver.discardCount);
+	return 0 == g_driver.errorCount ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <d3dumddi.h>
+
+// Stand-in for the real D3dDdi::Device exposing only what the dynamic buffers use
+
+namespace D3dDdi
+{
+	class Device
+	{
+	public:
+		Device(HANDLE device, const D3DDDI_DEVICEFUNCS& origVtable)
+			: m_device(device)
+			, m_origVtable(origVtable)
+		{
+		}
+
+		operator HANDLE() const { return m_device; }
+
+		const D3DDDI_DEVICEFUNCS& getOrigVtable() const { return m_origVtable; }
+
+	private:
+		HANDLE m_device;
+		const D3DDDI_DEVICEFUNCS& m_origVtable;
+	};
+}
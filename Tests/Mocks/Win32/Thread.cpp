@@ -0,0 +1,25 @@
+#include <cstdlib>
+
+#include <Win32/Thread.h>
+
+// Lets the benchmarks choose the number of CPUs the blitter may use via DDRAWCOMPAT_CPU_COUNT
+
+namespace Win32
+{
+	namespace Thread
+	{
+		void applyConfig()
+		{
+		}
+
+		DWORD getAvailableProcessorCount()
+		{
+			const char* cpuCount = std::getenv("DDRAWCOMPAT_CPU_COUNT");
+			if (cpuCount)
+			{
+				return std::max<DWORD>(1, std::strtoul(cpuCount, nullptr, 10));
+			}
+			return std::max<DWORD>(1, std::thread::hardware_concurrency());
+		}
+	}
+}
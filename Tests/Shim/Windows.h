@@ -0,0 +1,264 @@
+#pragma once
+
+// Minimal subset of the Win32 API needed to build the portable parts of DDrawCompat
+// (blitter kernels, dynamic buffers, vertex cache optimizer) with GCC or Clang.
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <set>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include <x86intrin.h>
+
+typedef int BOOL;
+typedef uint8_t BYTE;
+typedef uint16_t WORD;
+typedef uint32_t DWORD;
+typedef int32_t INT;
+typedef uint32_t UINT;
+typedef uint16_t UINT16;
+typedef uint64_t UINT64;
+typedef int32_t LONG;
+typedef uint64_t ULONG64;
+typedef uintptr_t UINT_PTR;
+typedef uintptr_t ULONG_PTR;
+typedef uintptr_t DWORD_PTR;
+typedef int32_t HRESULT;
+typedef void* HANDLE;
+typedef void* LPVOID;
+typedef uint32_t COLORREF;
+
+#define VOID void
+#define WINAPI
+#define __forceinline inline __attribute__((always_inline))
+
+#define FALSE 0
+#define TRUE 1
+#define INFINITE 0xFFFFFFFF
+#define WAIT_OBJECT_0 0
+
+#define S_OK 0
+#define SUCCEEDED(hr) ((hr) >= 0)
+#define FAILED(hr) ((hr) < 0)
+
+#define SRCCOPY 0x00CC0020
+#define SRCPAINT 0x00EE0086
+#define SRCAND 0x008800C6
+#define SRCINVERT 0x00660046
+#define PATCOPY 0x00F00021
+
+struct RECT
+{
+	LONG left, top, right, bottom;
+};
+
+struct POINT
+{
+	LONG x, y;
+};
+
+inline BOOL IntersectRect(RECT* dst, const RECT* src1, const RECT* src2)
+{
+	dst->left = std::max(src1->left, src2->left);
+	dst->top = std::max(src1->top, src2->top);
+	dst->right = std::min(src1->right, src2->right);
+	dst->bottom = std::min(src1->bottom, src2->bottom);
+	if (dst->left >= dst->right || dst->top >= dst->bottom)
+	{
+		*dst = {};
+		return FALSE;
+	}
+	return TRUE;
+}
+
+inline BOOL EqualRect(const RECT* rect1, const RECT* rect2)
+{
+	return 0 == memcmp(rect1, rect2, sizeof(RECT));
+}
+
+// Critical sections are recursive on Windows
+struct CRITICAL_SECTION
+{
+	std::recursive_mutex mutex;
+};
+
+inline void InitializeCriticalSection(CRITICAL_SECTION*) {}
+inline void DeleteCriticalSection(CRITICAL_SECTION*) {}
+inline void EnterCriticalSection(CRITICAL_SECTION* cs) { cs->mutex.lock(); }
+inline void LeaveCriticalSection(CRITICAL_SECTION* cs) { cs->mutex.unlock(); }
+inline BOOL TryEnterCriticalSection(CRITICAL_SECTION* cs) { return cs->mutex.try_lock(); }
+
+struct CONDITION_VARIABLE
+{
+	std::condition_variable_any cv;
+};
+
+#define CONDITION_VARIABLE_INIT {}
+
+inline BOOL SleepConditionVariableCS(CONDITION_VARIABLE* cv, CRITICAL_SECTION* cs, DWORD)
+{
+	cv->cv.wait(cs->mutex);
+	return TRUE;
+}
+
+inline void WakeAllConditionVariable(CONDITION_VARIABLE* cv) { cv->cv.notify_all(); }
+
+inline LONG InterlockedIncrement(volatile LONG* value) { return __sync_add_and_fetch(value, 1); }
+inline LONG InterlockedDecrement(volatile LONG* value) { return __sync_sub_and_fetch(value, 1); }
+inline LONG InterlockedExchange(volatile LONG* target, LONG value) { return __sync_lock_test_and_set(target, value); }
+
+inline LONG InterlockedCompareExchange(volatile LONG* destination, LONG exchange, LONG comparand)
+{
+	return __sync_val_compare_and_swap(destination, comparand, exchange);
+}
+
+struct ShimWaitable
+{
+	std::mutex mutex;
+	std::condition_variable cv;
+	LONG count;
+	bool isEvent;
+};
+
+inline HANDLE CreateSemaphore(void*, LONG initialCount, LONG, const char*)
+{
+	return new ShimWaitable{ {}, {}, initialCount, false };
+}
+
+inline HANDLE CreateEvent(void*, BOOL, BOOL initialState, const char*)
+{
+	return new ShimWaitable{ {}, {}, initialState ? 1 : 0, true };
+}
+
+inline BOOL ReleaseSemaphore(HANDLE semaphore, LONG releaseCount, LONG*)
+{
+	auto waitable = static_cast<ShimWaitable*>(semaphore);
+	{
+		std::lock_guard<std::mutex> lock(waitable->mutex);
+		waitable->count += releaseCount;
+	}
+	waitable->cv.notify_all();
+	return TRUE;
+}
+
+inline BOOL SetEvent(HANDLE event)
+{
+	auto waitable = static_cast<ShimWaitable*>(event);
+	{
+		std::lock_guard<std::mutex> lock(waitable->mutex);
+		waitable->count = 1;
+	}
+	waitable->cv.notify_all();
+	return TRUE;
+}
+
+inline DWORD WaitForSingleObject(HANDLE handle, DWORD)
+{
+	auto waitable = static_cast<ShimWaitable*>(handle);
+	std::unique_lock<std::mutex> lock(waitable->mutex);
+	waitable->cv.wait(lock, [&]() { return waitable->count > 0; });
+	waitable->count = waitable->isEvent ? 0 : waitable->count - 1;
+	return WAIT_OBJECT_0;
+}
+
+typedef DWORD(*LPTHREAD_START_ROUTINE)(LPVOID);
+
+inline HANDLE CreateThread(void*, size_t, LPTHREAD_START_ROUTINE startAddress, LPVOID parameter, DWORD, DWORD*)
+{
+	std::thread([=]() { startAddress(parameter); }).detach();
+	return reinterpret_cast<HANDLE>(1);
+}
+
+inline BOOL CloseHandle(HANDLE) { return TRUE; }
+inline HANDLE GetCurrentProcess() { return reinterpret_cast<HANDLE>(-1); }
+
+enum LOGICAL_PROCESSOR_RELATIONSHIP
+{
+	RelationProcessorCore,
+	RelationNumaNode,
+	RelationCache
+};
+
+struct CACHE_DESCRIPTOR
+{
+	BYTE Level;
+	BYTE Associativity;
+	WORD LineSize;
+	DWORD Size;
+	int Type;
+};
+
+struct SYSTEM_LOGICAL_PROCESSOR_INFORMATION
+{
+	ULONG_PTR ProcessorMask;
+	LOGICAL_PROCESSOR_RELATIONSHIP Relationship;
+	union
+	{
+		CACHE_DESCRIPTOR Cache;
+		uint64_t Reserved[2];
+	};
+};
+
+// Reports a fixed L1/L2/L3 hierarchy so that cache size dependent thresholds are reproducible
+inline BOOL GetLogicalProcessorInformation(SYSTEM_LOGICAL_PROCESSOR_INFORMATION* buffer, DWORD* returnedLength)
+{
+	const DWORD cacheSizes[] = { 48 << 10, 2 << 20, 32 << 20 };
+	const DWORD count = sizeof(cacheSizes) / sizeof(cacheSizes[0]);
+	if (!buffer || *returnedLength < count * sizeof(*buffer))
+	{
+		*returnedLength = count * sizeof(*buffer);
+		return FALSE;
+	}
+
+	for (DWORD i = 0; i < count; ++i)
+	{
+		buffer[i] = {};
+		buffer[i].Relationship = RelationCache;
+		buffer[i].Cache.Level = static_cast<BYTE>(i + 1);
+		buffer[i].Cache.Size = cacheSizes[i];
+	}
+	return TRUE;
+}
+
+inline void __cpuidex(int cpuInfo[4], int function, int subFunction)
+{
+	__asm__ volatile("cpuid"
+		: "=a"(cpuInfo[0]), "=b"(cpuInfo[1]), "=c"(cpuInfo[2]), "=d"(cpuInfo[3])
+		: "a"(function), "c"(subFunction));
+}
+
+inline void __cpuid(int cpuInfo[4], int function)
+{
+	__cpuidex(cpuInfo, function, 0);
+}
+
+inline unsigned long long shimXgetbv(unsigned int xcr)
+{
+	unsigned int eax = 0;
+	unsigned int edx = 0;
+	__asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(xcr));
+	return (static_cast<unsigned long long>(edx) << 32) | eax;
+}
+
+#define _xgetbv shimXgetbv
+
+// Windows.h defines these too, and the tree relies on std::min<T>/std::max<T> to avoid them.
+// libstdc++ headers don't guard against the macros, so they are all included above.
+#define min(a, b) (((a) < (b)) ? (a) : (b))
+#define max(a, b) (((a) > (b)) ? (a) : (b))
@@ -0,0 +1,5 @@
+#pragma once
+
+#include <Windows.h>
+
+typedef DWORD D3DCOLOR;
@@ -0,0 +1,167 @@
+#pragma once
+
+#include <Windows.h>
+
+enum D3DDDIFORMAT
+{
+	D3DDDIFMT_UNKNOWN = 0,
+	D3DDDIFMT_R8G8B8 = 20,
+	D3DDDIFMT_A8R8G8B8 = 21,
+	D3DDDIFMT_X8R8G8B8 = 22,
+	D3DDDIFMT_R5G6B5 = 23,
+	D3DDDIFMT_X1R5G5B5 = 24,
+	D3DDDIFMT_A1R5G5B5 = 25,
+	D3DDDIFMT_A4R4G4B4 = 26,
+	D3DDDIFMT_R3G3B2 = 27,
+	D3DDDIFMT_A8 = 28,
+	D3DDDIFMT_A8R3G3B2 = 29,
+	D3DDDIFMT_X4R4G4B4 = 30,
+	D3DDDIFMT_A8B8G8R8 = 32,
+	D3DDDIFMT_X8B8G8R8 = 33,
+	D3DDDIFMT_A8P8 = 40,
+	D3DDDIFMT_P8 = 41,
+	D3DDDIFMT_G8R8 = 91,
+	D3DDDIFMT_R8 = 92,
+	D3DDDIFMT_VERTEXDATA = 100,
+	D3DDDIFMT_INDEX16 = 101,
+	D3DDDIFMT_INDEX32 = 102
+};
+
+enum D3DDDI_POOL
+{
+	D3DDDIPOOL_SYSTEMMEM = 1,
+	D3DDDIPOOL_VIDEOMEMORY = 2
+};
+
+enum D3DDDI_ROTATION
+{
+	D3DDDI_ROTATION_IDENTITY = 1
+};
+
+enum D3DDDIQUERYTYPE
+{
+	D3DDDIQUERYTYPE_EVENT = 8
+};
+
+struct D3DDDI_RESOURCEFLAGS
+{
+	UINT VertexBuffer : 1;
+	UINT IndexBuffer : 1;
+	UINT Dynamic : 1;
+	UINT WriteOnly : 1;
+};
+
+struct D3DDDI_SURFACEINFO
+{
+	UINT Width;
+	UINT Height;
+	UINT Depth;
+	const VOID* pSysMem;
+	UINT SysMemPitch;
+	UINT SysMemSlicePitch;
+};
+
+struct D3DDDIARG_CREATERESOURCE
+{
+	D3DDDIFORMAT Format;
+	D3DDDI_POOL Pool;
+	UINT MultisampleType;
+	UINT MultisampleQuality;
+	const D3DDDI_SURFACEINFO* pSurfList;
+	UINT SurfCount;
+	UINT MipLevels;
+	UINT Fvf;
+	UINT VidPnSourceId;
+	UINT RefreshRate;
+	HANDLE hResource;
+	D3DDDI_RESOURCEFLAGS Flags;
+	D3DDDI_ROTATION Rotation;
+};
+
+typedef D3DDDIARG_CREATERESOURCE D3DDDIARG_CREATERESOURCE2;
+
+struct D3DDDIARG_CREATEQUERY
+{
+	D3DDDIQUERYTYPE QueryType;
+	HANDLE hQuery;
+};
+
+struct D3DDDI_ISSUEQUERYFLAGS
+{
+	UINT Begin : 1;
+	UINT End : 1;
+};
+
+struct D3DDDIARG_ISSUEQUERY
+{
+	HANDLE hQuery;
+	D3DDDI_ISSUEQUERYFLAGS Flags;
+};
+
+struct D3DDDIARG_GETQUERYDATA
+{
+	HANDLE hQuery;
+	VOID* pData;
+};
+
+struct D3DDDI_RANGE
+{
+	UINT Offset;
+	UINT Size;
+};
+
+struct D3DDDI_LOCKFLAGS
+{
+	UINT ReadOnly : 1;
+	UINT WriteOnly : 1;
+	UINT NoOverwrite : 1;
+	UINT Discard : 1;
+	UINT RangeValid : 1;
+};
+
+struct D3DDDIARG_LOCK
+{
+	HANDLE hResource;
+	UINT SubResourceIndex;
+	D3DDDI_RANGE Range;
+	D3DDDI_LOCKFLAGS Flags;
+	VOID* pSurfData;
+	UINT Pitch;
+	UINT SlicePitch;
+};
+
+struct D3DDDIARG_UNLOCK
+{
+	HANDLE hResource;
+	UINT SubResourceIndex;
+};
+
+struct D3DDDIARG_SETINDICES
+{
+	HANDLE hIndexBuffer;
+	UINT Stride;
+};
+
+struct D3DDDIARG_SETSTREAMSOURCE
+{
+	UINT Stream;
+	HANDLE hVertexBuffer;
+	UINT Offset;
+	UINT Stride;
+};
+
+// Only the entry points used by the code under test, in no particular order
+struct D3DDDI_DEVICEFUNCS
+{
+	HRESULT(*pfnCreateResource)(HANDLE, D3DDDIARG_CREATERESOURCE*);
+	HRESULT(*pfnCreateResource2)(HANDLE, D3DDDIARG_CREATERESOURCE2*);
+	HRESULT(*pfnDestroyResource)(HANDLE, HANDLE);
+	HRESULT(*pfnCreateQuery)(HANDLE, D3DDDIARG_CREATEQUERY*);
+	HRESULT(*pfnDestroyQuery)(HANDLE, HANDLE);
+	HRESULT(*pfnIssueQuery)(HANDLE, const D3DDDIARG_ISSUEQUERY*);
+	HRESULT(*pfnGetQueryData)(HANDLE, const D3DDDIARG_GETQUERYDATA*);
+	HRESULT(*pfnLock)(HANDLE, D3DDDIARG_LOCK*);
+	HRESULT(*pfnUnlock)(HANDLE, const D3DDDIARG_UNLOCK*);
+	HRESULT(*pfnSetIndices)(HANDLE, const D3DDDIARG_SETINDICES*);
+	HRESULT(*pfnSetStreamSource)(HANDLE, const D3DDDIARG_SETSTREAMSOURCE*);
+};
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <Windows.h>
+
+#define DDPF_RGB 0x40
+
+struct DDPIXELFORMAT
+{
+	DWORD dwSize;
+	DWORD dwFlags;
+	DWORD dwFourCC;
+	DWORD dwRGBBitCount;
+	DWORD dwRBitMask;
+	DWORD dwGBitMask;
+	DWORD dwBBitMask;
+	DWORD dwRGBAlphaBitMask;
+};
+
+struct DDCOLORKEY
+{
+	DWORD dwColorSpaceLowValue;
+	DWORD dwColorSpaceHighValue;
+};
+
+struct DDGAMMARAMP
+{
+	WORD red[256];
+	WORD green[256];
+	WORD blue[256];
+};